@@ -140,27 +140,38 @@ void test() {
   UInt n_samples = 0;
   if(verbosity)
     cout << "Testing for " << dataset.test_labels.size() << " cycles ..." << endl;
-  for(UInt i = 0; i < dataset.test_labels.size(); i++) {
-    // Get the input & label
-    const auto image  = dataset.test_images.at(i);
-    const UInt label  = dataset.test_labels.at(i);
+  // The SP runs on a batch of images at a time, without learning, using all
+  // hardware threads.
+  sp.setNumThreads( 0u );
+  const UInt batchSize = 1000u;
+  vector<sdr::SDR> inputs;
+  vector<sdr::SDR> actives;
+  for(UInt batch = 0; batch < dataset.test_labels.size(); batch += batchSize) {
+    const UInt batchEnd = min<UInt>(batch + batchSize, (UInt)dataset.test_labels.size());
+    inputs.resize( batchEnd - batch, input );
+    for(UInt i = batch; i < batchEnd; i++)
+      inputs[i - batch].setDense( dataset.test_images.at(i) );
 
     // Compute
-    input.setDense( image );
-    sp.compute(input, false, columns);
-    ClassifierResult result;
-    clsr.compute(sp.getIterationNum(), columns.getSparse(),
-      /* bucketIdxList */   {},
-      /* actValueList */    {},
-      /* category */        true,
-      /* learn */           false,
-      /* infer */           true,
-                            result);
-    // Check results
-    const auto cls = result.getClass();
-    if(cls == label) score += 1;
-    n_samples += 1;
-    if( verbosity && i % 1000 == 0 ) cout << "." << flush;
+    const UInt iteration = sp.getIterationNum();
+    sp.computeBatch(inputs, actives);
+
+    for(UInt i = batch; i < batchEnd; i++) {
+      const UInt label  = dataset.test_labels.at(i);
+      ClassifierResult result;
+      clsr.compute(iteration + (i - batch) + 1u, actives[i - batch].getSparse(),
+        /* bucketIdxList */   {},
+        /* actValueList */    {},
+        /* category */        true,
+        /* learn */           false,
+        /* infer */           true,
+                              result);
+      // Check results
+      const auto cls = result.getClass();
+      if(cls == label) score += 1;
+      n_samples += 1;
+    }
+    if( verbosity ) cout << "." << flush;
   }
   if( verbosity ) cout << endl;
   cout << "Score: " << 100.0 * score / n_samples << "% " << endl;
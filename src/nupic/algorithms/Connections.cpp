@@ -26,10 +26,16 @@
 
 #include <algorithm> // nth_element
 #include <climits>
+#include <cmath> // abs
+#include <functional> // greater
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <numeric> // iota, partial_sum
 
 #include <nupic/algorithms/Connections.hpp>
+#include <nupic/algorithms/ConnectionsBinary.hpp>
+#include <nupic/algorithms/ConnectionsKernels.hpp>
 
 #include <nupic/math/Math.hpp> // nupic::Epsilon
 
@@ -40,6 +46,44 @@ using namespace nupic;
 using namespace nupic::algorithms::connections;
 using nupic::sdr::SDR;
 
+const Segment Connections::INVALID_SEGMENT;
+const Synapse Connections::INVALID_SYNAPSE;
+
+namespace {
+/**
+ * Whether addPermanences would change any of the permanences.  Stops at the
+ * first permanence which changes, which usually is the first one.
+ */
+bool permanencesChange(const Permanence *permanences, const UInt32 count,
+                       const Permanence *deltas, const Permanence delta) {
+  for(UInt32 i = 0; i < count; i++) {
+    Permanence after = permanences[i] + (deltas != nullptr ? deltas[i] : delta);
+    after = std::min(after, maxPermanence);
+    after = std::max(after, minPermanence);
+    if( after != permanences[i] )
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Whether addQuantizedPermanences would change any of the permanences.
+ */
+bool quantizedPermanencesChange(const UInt16 *permanences, const UInt32 count,
+                                const UInt16 *increments, const UInt16 increment,
+                                const UInt16 *decrements, const UInt16 decrement) {
+  for(UInt32 i = 0; i < count; i++) {
+    const UInt32 up   = increments != nullptr ? increments[i] : increment;
+    const UInt32 down = decrements != nullptr ? decrements[i] : decrement;
+    UInt32 after = std::min((UInt32)permanences[i] + up, (UInt32)quantizedPermanenceMax);
+    after = after > down ? after - down : 0u;
+    if( after != permanences[i] )
+      return true;
+  }
+  return false;
+}
+} // end anonymous namespace
+
 Connections::Connections(CellIdx numCells, Permanence connectedThreshold) {
   initialize(numCells, connectedThreshold);
 }
@@ -54,12 +98,18 @@ void Connections::initialize(CellIdx numCells, Permanence connectedThreshold) {
   connectedSynapsesForPresynapticCell_.clear();
   potentialSegmentsForPresynapticCell_.clear();
   connectedSegmentsForPresynapticCell_.clear();
+  presynapticMapsChanged_ = true;
+  presynapticIndexValid_  = false;
+  connectedBitmapValid_    = false;
+  connectedBitmapDisabled_ = false;
+  connectedBitmap_.masks.clear();
   segmentOrdinals_.clear();
   synapseOrdinals_.clear();
   eventHandlers_.clear();
   NTA_CHECK(connectedThreshold >= minPermanence);
   NTA_CHECK(connectedThreshold <= maxPermanence);
   connectedThreshold_ = connectedThreshold - nupic::Epsilon;
+  quantizedThreshold_ = quantizeThreshold(connectedThreshold_);
 
   // Every time a segment or synapse is created, we assign it an ordinal and
   // increment the nextOrdinal. Ordinals are never recycled, so they can be used
@@ -68,6 +118,7 @@ void Connections::initialize(CellIdx numCells, Permanence connectedThreshold) {
   nextSynapseOrdinal_ = 0;
 
   nextEventToken_ = 0;
+  segmentListGrowths_ = 0;
 }
 
 UInt32 Connections::subscribe(ConnectionsEventHandler *handler) {
@@ -90,11 +141,17 @@ Segment Connections::createSegment(CellIdx cell) {
     segment = (Segment)segments_.size();
     segments_.push_back(SegmentData());
     segmentOrdinals_.push_back(0);
+    if( connectedBitmapValid_ ) {
+      connectedBitmap_.masks.resize(
+        segments_.size() * connectedBitmap_.numWords, 0u );
+    }
   }
 
   SegmentData &segmentData = segments_[segment];
   segmentData.numConnected = 0;
   segmentData.cell = cell;
+  // A no-op for recycled segments, which keep their lists.
+  reserveSegmentLists_(segmentData, 0u);
 
   CellData &cellData = cells_[cell];
   segmentOrdinals_[segment] = nextSegmentOrdinal_++;
@@ -121,27 +178,48 @@ Synapse Connections::createSynapse(Segment segment,
     synapseOrdinals_.push_back(0);
   }
 
+  // Quantized permanences are rounded, and the synapse data holds the
+  // rounded value.
+  permanence = std::min(permanence, maxPermanence );
+  permanence = std::max(permanence, minPermanence );
+  const UInt16 quantized = quantizePermanence(permanence);
+  if( quantizedPermanences_ )
+    permanence = dequantizePermanence(quantized);
+
   // Fill in the new synapse's data
   SynapseData &synapseData    = synapses_[synapse];
   synapseData.presynapticCell = presynapticCell;
+  synapseData.permanence      = permanence;
   synapseData.segment         = segment;
   synapseOrdinals_[synapse]   = nextSynapseOrdinal_++;
-  // Start in disconnected state.
-  synapseData.permanence           = connectedThreshold_ - 1.0f;
+  // Start in the potential maps, and move over below if connected.
+  growPresynapticMaps_(presynapticCell);
   synapseData.presynapticMapIndex_ = 
     (Synapse)potentialSynapsesForPresynapticCell_[presynapticCell].size();
   potentialSynapsesForPresynapticCell_[presynapticCell].push_back(synapse);
   potentialSegmentsForPresynapticCell_[presynapticCell].push_back(segment);
+  presynapticMapsChanged_ = true;
 
   SegmentData &segmentData = segments_[segment];
+  if( segmentData.synapses.size() == segmentData.synapses.capacity() )
+    segmentListGrowths_++;
+  synapseData.segmentIndex_ = (Synapse)segmentData.synapses.size();
   segmentData.synapses.push_back(synapse);
-
+  if( packedSegments_ ) {
+    segmentData.presynapticCells.push_back(presynapticCell);
+    if( quantizedPermanences_ )
+      segmentData.quantizedPermanences.push_back(quantized);
+    else
+      segmentData.permanences.push_back(permanence);
+  }
 
   for (auto h : eventHandlers_) {
     h.second->onCreateSynapse(synapse);
   }
 
-  updateSynapsePermanence(synapse, permanence);
+  if( permanence >= connectedThreshold_ ) {
+    synapseCrossedThreshold_( synapse );
+  }
 
   return synapse;
 }
@@ -157,8 +235,8 @@ bool Connections::synapseExists_(Synapse synapse) const {
   const SynapseData &synapseData = synapses_[synapse];
   const vector<Synapse> &synapsesOnSegment =
       segments_[synapseData.segment].synapses;
-  return (std::find(synapsesOnSegment.begin(), synapsesOnSegment.end(),
-                    synapse) != synapsesOnSegment.end());
+  return synapseData.segmentIndex_ < synapsesOnSegment.size() &&
+         synapsesOnSegment[synapseData.segmentIndex_] == synapse;
 }
 
 /**
@@ -181,6 +259,17 @@ void Connections::removeSynapseFromPresynapticMap_(
 
   preSegments[index] = preSegments.back();
   preSegments.pop_back();
+  presynapticMapsChanged_ = true;
+}
+
+void Connections::growPresynapticMaps_(const CellIdx presynapticCell) {
+  if( presynapticCell < potentialSynapsesForPresynapticCell_.size() )
+    return;
+  const Size size = (Size)presynapticCell + 1u;
+  potentialSynapsesForPresynapticCell_.resize( size );
+  connectedSynapsesForPresynapticCell_.resize( size );
+  potentialSegmentsForPresynapticCell_.resize( size );
+  connectedSegmentsForPresynapticCell_.resize( size );
 }
 
 void Connections::destroySegment(Segment segment) {
@@ -224,88 +313,198 @@ void Connections::destroySynapse(Synapse synapse) {
 
   if( synapseData.permanence >= connectedThreshold_ ) {
     segmentData.numConnected--;
+    clearConnectedBit_( synapseData.segment, presynCell );
 
     removeSynapseFromPresynapticMap_(
       synapseData.presynapticMapIndex_,
-      connectedSynapsesForPresynapticCell_.at( presynCell ),
-      connectedSegmentsForPresynapticCell_.at( presynCell ));
-
-    if( connectedSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      connectedSynapsesForPresynapticCell_.erase( presynCell );
-      connectedSegmentsForPresynapticCell_.erase( presynCell );
-    }
+      connectedSynapsesForPresynapticCell_[ presynCell ],
+      connectedSegmentsForPresynapticCell_[ presynCell ]);
   }
   else {
     removeSynapseFromPresynapticMap_(
       synapseData.presynapticMapIndex_,
-      potentialSynapsesForPresynapticCell_.at( presynCell ),
-      potentialSegmentsForPresynapticCell_.at( presynCell ));
-
-    if( potentialSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      potentialSynapsesForPresynapticCell_.erase( presynCell );
-      potentialSegmentsForPresynapticCell_.erase( presynCell );
-    }
+      potentialSynapsesForPresynapticCell_[ presynCell ],
+      potentialSegmentsForPresynapticCell_[ presynCell ]);
   }
 
-  const auto synapseOnSegment =
-      std::lower_bound(segmentData.synapses.begin(), segmentData.synapses.end(),
-                       synapse, [&](Synapse a, Synapse b) {
-                         return synapseOrdinals_[a] < synapseOrdinals_[b];
-                       });
-
-  NTA_ASSERT(synapseOnSegment != segmentData.synapses.end());
-  NTA_ASSERT(*synapseOnSegment == synapse);
-
-  segmentData.synapses.erase(synapseOnSegment);
+  // Remove the synapse from the segment's lists, and shift the index of the
+  // synapses after it.
+  const Synapse index = synapseData.segmentIndex_;
+  NTA_ASSERT(segmentData.synapses[index] == synapse);
+  segmentData.synapses.erase(segmentData.synapses.begin() + index);
+  if( packedSegments_ ) {
+    segmentData.presynapticCells.erase(segmentData.presynapticCells.begin() + index);
+    if( quantizedPermanences_ )
+      segmentData.quantizedPermanences.erase(segmentData.quantizedPermanences.begin() + index);
+    else
+      segmentData.permanences.erase(segmentData.permanences.begin() + index);
+  }
+  for(Synapse i = index; i < segmentData.synapses.size(); i++) {
+    synapses_[segmentData.synapses[i]].segmentIndex_ = i;
+  }
 
   destroyedSynapses_.push_back(synapse);
 }
 
 void Connections::updateSynapsePermanence(Synapse synapse,
                                           Permanence permanence) {
+  const auto   &synData = synapses_[synapse];
+  const Segment segment  = synData.segment;
+  if( updateSynapsePermanence_(segment, synData.segmentIndex_, permanence) ) {
+    for (auto h : eventHandlers_) {
+      h.second->onUpdateSegmentPermanences(segment);
+    }
+  }
+}
+
+bool Connections::updateSynapsePermanence_(const Segment segment,
+                                           const Synapse index,
+                                           Permanence permanence) {
   permanence = std::min(permanence, maxPermanence );
   permanence = std::max(permanence, minPermanence );
 
-  auto &synData = synapses_[synapse];
-  bool before = synData.permanence >= connectedThreshold_;
-  bool after  = permanence         >= connectedThreshold_;
-  synData.permanence = permanence;
-
-  if( before != after ) {
-    const auto &presyn    = synData.presynapticCell;
-    auto &potentialPresyn = potentialSynapsesForPresynapticCell_[presyn];
-    auto &potentialPreseg = potentialSegmentsForPresynapticCell_[presyn];
-    auto &connectedPresyn = connectedSynapsesForPresynapticCell_[presyn];
-    auto &connectedPreseg = connectedSegmentsForPresynapticCell_[presyn];
-    const auto &segment   = synData.segment;
-    auto &segmentData     = segments_[segment];
-    if( after ) {
-      segmentData.numConnected++;
-
-      // Remove this synapse from presynaptic potential synapses.
-      removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
-                                        potentialPresyn, potentialPreseg );
-
-      // Add this synapse to the presynaptic connected synapses.
-      synData.presynapticMapIndex_ = (Synapse)connectedPresyn.size();
-      connectedPresyn.push_back( synapse );
-      connectedPreseg.push_back( segment );
+  auto &segmentData = segments_[segment];
+  const Synapse synapse = segmentData.synapses[index];
+  if( quantizedPermanences_ ) {
+    const UInt16 quantized = quantizePermanence( permanence );
+    segmentData.quantizedPermanences[index] = quantized;
+    permanence = dequantizePermanence( quantized );
+  }
+  else if( packedSegments_ ) {
+    segmentData.permanences[index] = permanence;
+  }
+  const Permanence before = synapses_[synapse].permanence;
+  synapses_[synapse].permanence = permanence;
+
+  if( (before >= connectedThreshold_) != (permanence >= connectedThreshold_) ) {
+    synapseCrossedThreshold_( synapse );
+  }
+  return before != permanence;
+}
+
+void Connections::synapseCrossedThreshold_(const Synapse synapse) {
+  auto &synData         = synapses_[synapse];
+  const auto &presyn    = synData.presynapticCell;
+  auto &potentialPresyn = potentialSynapsesForPresynapticCell_[presyn];
+  auto &potentialPreseg = potentialSegmentsForPresynapticCell_[presyn];
+  auto &connectedPresyn = connectedSynapsesForPresynapticCell_[presyn];
+  auto &connectedPreseg = connectedSegmentsForPresynapticCell_[presyn];
+  const auto &segment   = synData.segment;
+  auto &segmentData     = segments_[segment];
+  const Permanence permanence = synData.permanence;
+  if( permanence >= connectedThreshold_ ) {
+    segmentData.numConnected++;
+    setConnectedBit_( segment, presyn );
+
+    // Remove this synapse from presynaptic potential synapses.
+    removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
+                                      potentialPresyn, potentialPreseg );
+
+    // Add this synapse to the presynaptic connected synapses.
+    synData.presynapticMapIndex_ = (Synapse)connectedPresyn.size();
+    connectedPresyn.push_back( synapse );
+    connectedPreseg.push_back( segment );
+  }
+  else {
+    segmentData.numConnected--;
+    clearConnectedBit_( segment, presyn );
+
+    // Remove this synapse from presynaptic connected synapses.
+    removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
+                                      connectedPresyn, connectedPreseg );
+
+    // Add this synapse to the presynaptic connected synapses.
+    synData.presynapticMapIndex_ = (Synapse)potentialPresyn.size();
+    potentialPresyn.push_back( synapse );
+    potentialPreseg.push_back( segment );
+  }
+
+  for (auto h : eventHandlers_) {
+    h.second->onUpdateSynapsePermanence(synapse, permanence);
+  }
+}
+
+void Connections::addSegmentPermanences_(const Segment segment,
+                                         const Permanence *deltas,
+                                         const Permanence delta) {
+  if( quantizedPermanences_ ) {
+    // Split the deltas into the increments and decrements of the saturating
+    // kernel.
+    if( deltas == nullptr ) {
+      addSegmentQuantizedPermanences_( segment, nullptr, quantizePermanence( delta ),
+                                       nullptr, quantizePermanence( -delta ));
+      return;
     }
-    else {
-      segmentData.numConnected--;
+    const Size numSynapses = segments_[segment].synapses.size();
+    quantizedIncrements_.resize( numSynapses );
+    quantizedDecrements_.resize( numSynapses );
+    for(Size i = 0; i < numSynapses; i++) {
+      quantizedIncrements_[i] = quantizePermanence(  deltas[i] );
+      quantizedDecrements_[i] = quantizePermanence( -deltas[i] );
+    }
+    addSegmentQuantizedPermanences_( segment, quantizedIncrements_.data(), 0u,
+                                     quantizedDecrements_.data(), 0u );
+    return;
+  }
 
-      // Remove this synapse from presynaptic connected synapses.
-      removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
-                                        connectedPresyn, connectedPreseg );
+  SegmentData &segmentData = segments_[segment];
+  const Synapse *synapses  = segmentData.synapses.data();
+  const auto numSynapses   = (UInt32)segmentData.synapses.size();
+  Permanence *permanences  = segmentData.permanences.data();
+  if( !packedSegments_ ) {
+    permanenceScratch_.resize( numSynapses );
+    for(UInt32 i = 0; i < numSynapses; i++)
+      permanenceScratch_[i] = synapses_[synapses[i]].permanence;
+    permanences = permanenceScratch_.data();
+  }
 
-      // Add this synapse to the presynaptic connected synapses.
-      synData.presynapticMapIndex_ = (Synapse)potentialPresyn.size();
-      potentialPresyn.push_back( synapse );
-      potentialPreseg.push_back( segment );
+  // Update all of the permanences in one vectorized pass, then do the
+  // bookkeeping for the few synapses which crossed the connected threshold.
+  // Only the event handlers need to know whether anything changed.
+  const bool changed = !eventHandlers_.empty() &&
+                       permanencesChange( permanences, numSynapses, deltas, delta );
+  thresholdCrossings_.clear();
+  addPermanences( permanences, numSynapses, deltas, delta,
+                  connectedThreshold_, thresholdCrossings_ );
+  for(UInt32 i = 0; i < numSynapses; i++)
+    synapses_[synapses[i]].permanence = permanences[i];
+
+  for(const auto i : thresholdCrossings_) {
+    synapseCrossedThreshold_( synapses[i] );
+  }
+  if( changed ) {
+    for (auto h : eventHandlers_) {
+      h.second->onUpdateSegmentPermanences(segment);
     }
+  }
+}
 
+void Connections::addSegmentQuantizedPermanences_(const Segment segment,
+                                                  const UInt16 *increments,
+                                                  const UInt16 increment,
+                                                  const UInt16 *decrements,
+                                                  const UInt16 decrement) {
+  SegmentData &segmentData = segments_[segment];
+  UInt16 *permanences      = segmentData.quantizedPermanences.data();
+  const auto numSynapses   = (UInt32)segmentData.quantizedPermanences.size();
+
+  const bool changed = !eventHandlers_.empty() &&
+                       quantizedPermanencesChange( permanences, numSynapses,
+                          increments, increment, decrements, decrement );
+  thresholdCrossings_.clear();
+  addQuantizedPermanences( permanences, numSynapses, increments, increment,
+                           decrements, decrement, quantizedThreshold_,
+                           thresholdCrossings_ );
+  const Synapse *synapses = segmentData.synapses.data();
+  for(UInt32 i = 0; i < numSynapses; i++)
+    synapses_[synapses[i]].permanence = dequantizePermanence( permanences[i] );
+
+  for(const auto i : thresholdCrossings_) {
+    synapseCrossedThreshold_( synapses[i] );
+  }
+  if( changed ) {
     for (auto h : eventHandlers_) {
-      h.second->onUpdateSynapsePermanence(synapse, permanence);
+      h.second->onUpdateSegmentPermanences(segment);
     }
   }
 }
@@ -374,15 +573,194 @@ bool Connections::compareSegments(Segment a, Segment b) const {
 
 vector<Synapse>
 Connections::synapsesForPresynapticCell(CellIdx presynapticCell) const {
+  if( presynapticCell >= potentialSynapsesForPresynapticCell_.size() )
+    return vector<Synapse>();
+
   vector<Synapse> all(
-      potentialSynapsesForPresynapticCell_.at(presynapticCell).begin(),
-      potentialSynapsesForPresynapticCell_.at(presynapticCell).end());
+      potentialSynapsesForPresynapticCell_[presynapticCell].begin(),
+      potentialSynapsesForPresynapticCell_[presynapticCell].end());
   all.insert( all.end(),
-      connectedSynapsesForPresynapticCell_.at(presynapticCell).begin(),
-      connectedSynapsesForPresynapticCell_.at(presynapticCell).end());
+      connectedSynapsesForPresynapticCell_[presynapticCell].begin(),
+      connectedSynapsesForPresynapticCell_[presynapticCell].end());
   return all;
 }
 
+
+void Connections::PresynapticIndex::build(
+    const vector<vector<Segment>> &segmentsForPresynapticCell)
+{
+  offsets.resize( segmentsForPresynapticCell.size() + 1u );
+  UInt32 total = 0u;
+  for(Size cell = 0; cell < segmentsForPresynapticCell.size(); cell++) {
+    offsets[cell] = total;
+    total += (UInt32)segmentsForPresynapticCell[cell].size();
+  }
+  offsets.back() = total;
+
+  segments.resize( total );
+  auto out = segments.begin();
+  for(const auto &presynapticSegments : segmentsForPresynapticCell)
+    out = std::copy( presynapticSegments.begin(), presynapticSegments.end(), out );
+}
+
+
+bool Connections::usePresynapticIndex_() const {
+  if( presynapticMapsChanged_ ) {
+    presynapticMapsChanged_ = false;
+    presynapticIndexValid_  = false;
+    return false;
+  }
+  if( !presynapticIndexValid_ ) {
+    connectedPresynapticIndex_.build( connectedSegmentsForPresynapticCell_ );
+    potentialPresynapticIndex_.build( potentialSegmentsForPresynapticCell_ );
+    presynapticIndexValid_ = true;
+  }
+  return true;
+}
+
+
+void Connections::computeActivity_(
+    UInt32 *numActiveSynapsesForSegment,
+    const CellIdx *activePresynapticCellsBegin,
+    const CellIdx *activePresynapticCellsEnd,
+    const bool connected, const bool useIndex) const
+{
+  const CellIdx *activeCell = activePresynapticCellsBegin;
+  if( useIndex ) {
+    const auto &index = connected ? connectedPresynapticIndex_
+                                  : potentialPresynapticIndex_;
+    const CellIdx numPresynapticCells = (CellIdx)index.offsets.size() - 1u;
+    const Segment *segments = index.segments.data();
+    for (; activeCell != activePresynapticCellsEnd; ++activeCell) {
+      const CellIdx cell = *activeCell;
+      if( cell >= numPresynapticCells )
+        continue;
+      const UInt32 end = index.offsets[cell + 1u];
+      for(UInt32 i = index.offsets[cell]; i < end; i++) {
+        ++numActiveSynapsesForSegment[segments[i]];
+      }
+    }
+  }
+  else {
+    const auto &segmentsForPresynapticCell = connected ?
+        connectedSegmentsForPresynapticCell_ : potentialSegmentsForPresynapticCell_;
+    for (; activeCell != activePresynapticCellsEnd; ++activeCell) {
+      const CellIdx cell = *activeCell;
+      if( cell >= segmentsForPresynapticCell.size() )
+        continue;
+      for( Segment segment : segmentsForPresynapticCell[cell] ) {
+        ++numActiveSynapsesForSegment[segment];
+      }
+    }
+  }
+}
+
+void Connections::setActivityEngine(const ActivityEngine engine) {
+  activityEngine_ = engine;
+}
+
+Connections::ActivityEngine Connections::getActivityEngine() const {
+  return activityEngine_;
+}
+
+
+bool Connections::buildConnectedBitmap_() const {
+  const Size numPresynapticCells = connectedSegmentsForPresynapticCell_.size();
+  const UInt32 numWords = (UInt32)((numPresynapticCells + 63u) / 64u);
+  connectedBitmap_.numWords = numWords;
+  connectedBitmap_.masks.assign( segments_.size() * numWords, 0u );
+  for(CellIdx cell = 0; cell < numPresynapticCells; cell++) {
+    const UInt64 bit = 1ull << (cell % 64u);
+    for(const Segment segment : connectedSegmentsForPresynapticCell_[cell]) {
+      UInt64 &word = connectedBitmap_.masks[(Size)segment * numWords + cell / 64u];
+      if( word & bit ) {
+        // Duplicate connected synapses, which the sparse engine counts twice.
+        connectedBitmap_.masks.clear();
+        connectedBitmapDisabled_ = true;
+        return false;
+      }
+      word |= bit;
+    }
+  }
+  connectedBitmapValid_ = true;
+  return true;
+}
+
+
+void Connections::setConnectedBit_(const Segment segment,
+                                   const CellIdx presynapticCell) {
+  if( !connectedBitmapValid_ )
+    return;
+  const UInt32 numWords = connectedBitmap_.numWords;
+  if( presynapticCell >= numWords * 64u ) {
+    // Out of range of the bitmasks, rebuild them when they are next needed.
+    connectedBitmapValid_ = false;
+    return;
+  }
+  UInt64 &word = connectedBitmap_.masks[(Size)segment * numWords + presynapticCell / 64u];
+  const UInt64 bit = 1ull << (presynapticCell % 64u);
+  if( word & bit ) {
+    connectedBitmapValid_    = false;
+    connectedBitmapDisabled_ = true;
+    connectedBitmap_.masks.clear();
+    return;
+  }
+  word |= bit;
+}
+
+
+void Connections::clearConnectedBit_(const Segment segment,
+                                     const CellIdx presynapticCell) {
+  if( !connectedBitmapValid_ )
+    return;
+  const UInt32 numWords = connectedBitmap_.numWords;
+  connectedBitmap_.masks[(Size)segment * numWords + presynapticCell / 64u] &=
+      ~(1ull << (presynapticCell % 64u));
+}
+
+
+bool Connections::useBitmapEngine_(const vector<CellIdx> *const *inputs,
+                                   const Size numInputs) const
+{
+  if( activityEngine_ == ActivityEngine::Sparse || connectedBitmapDisabled_ ||
+      segments_.empty() )
+    return false;
+
+  const Size numPresynapticCells = connectedSegmentsForPresynapticCell_.size();
+  if( activityEngine_ == ActivityEngine::Auto ) {
+    // The sparse engine increments a counter for every active connected
+    // synapse, the bitmap engine reads every word of every segment's mask.
+    // Both cost about the same per item.
+    const UInt64 bitmapWork = (UInt64)numInputs * segments_.size() *
+                              ((numPresynapticCells + 63u) / 64u);
+    UInt64 sparseWork = 0u;
+    for(Size i = 0u; i < numInputs; i++) {
+      for(const CellIdx cell : *inputs[i]) {
+        if( cell < numPresynapticCells )
+          sparseWork += connectedSegmentsForPresynapticCell_[cell].size();
+      }
+    }
+    if( sparseWork <= bitmapWork )
+      return false;
+  }
+
+  if( !connectedBitmapValid_ && !buildConnectedBitmap_() )
+    return false;
+
+  const UInt32 numWords = connectedBitmap_.numWords;
+  inputBitmap_.assign( numInputs * numWords, 0u );
+  for(Size i = 0u; i < numInputs; i++) {
+    UInt64 *bitmap = inputBitmap_.data() + i * numWords;
+    for(const CellIdx cell : *inputs[i]) {
+      // Cells out of range have no connected synapses.
+      if( cell < numWords * 64u )
+        bitmap[cell / 64u] |= 1ull << (cell % 64u);
+    }
+  }
+  return true;
+}
+
+
 void Connections::computeActivity(
     vector<UInt32> &numActiveConnectedSynapsesForSegment,
     vector<UInt32> &numActivePotentialSynapsesForSegment,
@@ -399,16 +777,158 @@ void Connections::computeActivity(
     vector<UInt32> &numActiveConnectedSynapsesForSegment,
     const vector<CellIdx> &activePresynapticCells) const
 {
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
   NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
 
+  const vector<CellIdx> *input = &activePresynapticCells;
+  if( useBitmapEngine_( &input, 1u )) {
+    addBitmapOverlaps( connectedBitmap_.masks.data(), connectedBitmap_.numWords,
+                       inputBitmap_.data(), 0u, (UInt32)segments_.size(),
+                       numActiveConnectedSynapsesForSegment.data() );
+    return;
+  }
+
   // Iterate through all connected synapses.
-  for (CellIdx cell : activePresynapticCells) {
-    if (connectedSegmentsForPresynapticCell_.count(cell)) {
-      for( Segment segment : connectedSegmentsForPresynapticCell_.at(cell)) {
-        ++numActiveConnectedSynapsesForSegment[segment];
+  computeActivity_( numActiveConnectedSynapsesForSegment.data(),
+                    activePresynapticCells.data(),
+                    activePresynapticCells.data() + activePresynapticCells.size(),
+                    true, usePresynapticIndex_() );
+}
+
+void Connections::computeActivity(
+    vector<UInt32> &numActiveConnectedSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells,
+    ThreadPool &pool) const
+{
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
+  NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
+
+  const vector<CellIdx> *input = &activePresynapticCells;
+  if( useBitmapEngine_( &input, 1u )) {
+    pool.parallelFor(0u, (UInt)segments_.size(),
+      [&](UInt begin, UInt end, UInt) {
+        addBitmapOverlaps( connectedBitmap_.masks.data(), connectedBitmap_.numWords,
+                           inputBitmap_.data(), begin, end,
+                           numActiveConnectedSynapsesForSegment.data() );
+    });
+    return;
+  }
+
+  computeActivityParallel_( numActiveConnectedSynapsesForSegment,
+                            activePresynapticCells, true,
+                            usePresynapticIndex_(), pool );
+}
+
+void Connections::computeActivity(
+    vector<UInt32> &numActiveConnectedSynapsesForSegment,
+    vector<UInt32> &numActivePotentialSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells,
+    Permanence connectedPermanence,
+    ThreadPool &pool) const
+{
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
+  NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
+  NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
+  NTA_CHECK( std::abs(connectedPermanence - nupic::Epsilon - connectedThreshold_) <= nupic::Epsilon );
+
+  const bool useIndex = usePresynapticIndex_();
+
+  // Iterate through all connected synapses.
+  computeActivityParallel_( numActiveConnectedSynapsesForSegment,
+                            activePresynapticCells, true, useIndex, pool );
+
+  // Iterate through all potential synapses.
+  pool.parallelFor(0u, (UInt)segments_.size(),
+    [&](UInt begin, UInt end, UInt) {
+      std::copy( numActiveConnectedSynapsesForSegment.begin() + begin,
+                 numActiveConnectedSynapsesForSegment.begin() + end,
+                 numActivePotentialSynapsesForSegment.begin() + begin );
+  });
+  computeActivityParallel_( numActivePotentialSynapsesForSegment,
+                            activePresynapticCells, false, useIndex, pool );
+}
+
+void Connections::computeActivityParallel_(
+    vector<UInt32> &numActiveSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells,
+    const bool connected, const bool useIndex, ThreadPool &pool) const
+{
+  const UInt numThreads = pool.numThreads();
+  if( numThreads == 1u || activePresynapticCells.size() < numThreads ) {
+    computeActivity_( numActiveSynapsesForSegment.data(),
+                      activePresynapticCells.data(),
+                      activePresynapticCells.data() + activePresynapticCells.size(),
+                      connected, useIndex );
+    return;
+  }
+
+  // The first thread counts directly into the output vector, the others
+  // count into scratch buffers which are kept zeroed between calls.
+  threadActivity_.resize( numThreads );
+  for(auto &counts : threadActivity_)
+    counts.resize( segments_.size(), 0u );
+
+  pool.parallelFor(0u, (UInt)activePresynapticCells.size(),
+    [&](UInt begin, UInt end, UInt thread) {
+      auto &counts = thread == 0u ? numActiveSynapsesForSegment
+                                  : threadActivity_[thread];
+      computeActivity_( counts.data(),
+                        activePresynapticCells.data() + begin,
+                        activePresynapticCells.data() + end,
+                        connected, useIndex );
+  });
+
+  // Sum the scratch buffers, each thread owning a range of segments.
+  pool.parallelFor(0u, (UInt)segments_.size(),
+    [&](UInt begin, UInt end, UInt) {
+      for(UInt thread = 1u; thread < numThreads; thread++) {
+        auto &counts = threadActivity_[thread];
+        for(UInt segment = begin; segment < end; segment++) {
+          numActiveSynapsesForSegment[segment] += counts[segment];
+          counts[segment] = 0u;
+        }
       }
-    }
+  });
+}
+
+void Connections::computeActivityBatch(
+    vector<UInt32> &numActiveConnectedSynapses,
+    const vector<const vector<CellIdx> *> &activePresynapticCells,
+    ThreadPool *pool) const
+{
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
+  const UInt32 numInputs   = (UInt32)activePresynapticCells.size();
+  const UInt32 numSegments = (UInt32)segments_.size();
+  numActiveConnectedSynapses.assign( (Size)numInputs * numSegments, 0u );
+  if( numInputs == 0u )
+    return;
+
+  const auto parallelFor = [&](UInt begin, UInt end, const ThreadPool::Task &task) {
+    if( pool != nullptr )
+      pool->parallelFor( begin, end, task );
+    else if( begin < end )
+      task( begin, end, 0u );
+  };
+
+  if( useBitmapEngine_( activePresynapticCells.data(), numInputs )) {
+    // Every thread streams the masks of its segments once for all inputs.
+    parallelFor(0u, numSegments, [&](UInt begin, UInt end, UInt) {
+      addBitmapOverlapsBatch( connectedBitmap_.masks.data(), connectedBitmap_.numWords,
+                              inputBitmap_.data(), numInputs, begin, end,
+                              numActiveConnectedSynapses.data(), numSegments );
+    });
+    return;
   }
+
+  const bool useIndex = usePresynapticIndex_();
+  parallelFor(0u, numInputs, [&](UInt begin, UInt end, UInt) {
+    for(UInt i = begin; i < end; i++) {
+      const vector<CellIdx> &cells = *activePresynapticCells[i];
+      computeActivity_( numActiveConnectedSynapses.data() + (Size)i * numSegments,
+                        cells.data(), cells.data() + cells.size(),
+                        true, useIndex );
+    }
+  });
 }
 
 void Connections::computeActivity(
@@ -416,26 +936,26 @@ void Connections::computeActivity(
     vector<UInt32> &numActivePotentialSynapsesForSegment,
     const vector<CellIdx> &activePresynapticCells,
     Permanence connectedPermanence) const {
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
   NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
   NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
-  NTA_CHECK( abs(connectedPermanence - nupic::Epsilon - connectedThreshold_) <= nupic::Epsilon );
+  NTA_CHECK( std::abs(connectedPermanence - nupic::Epsilon - connectedThreshold_) <= nupic::Epsilon );
+
+  const bool useIndex = usePresynapticIndex_();
+
+  const CellIdx *activeBegin = activePresynapticCells.data();
+  const CellIdx *activeEnd   = activeBegin + activePresynapticCells.size();
 
   // Iterate through all connected synapses.
-  computeActivity(
-      numActiveConnectedSynapsesForSegment,
-      activePresynapticCells );
+  computeActivity_( numActiveConnectedSynapsesForSegment.data(),
+                    activeBegin, activeEnd, true, useIndex );
 
   // Iterate through all potential synapses.
   std::copy( numActiveConnectedSynapsesForSegment.begin(),
              numActiveConnectedSynapsesForSegment.end(),
              numActivePotentialSynapsesForSegment.begin());
-  for (CellIdx cell : activePresynapticCells) {
-    if (potentialSegmentsForPresynapticCell_.count(cell)) {
-      for( Segment segment : potentialSegmentsForPresynapticCell_.at(cell)) {
-        ++numActivePotentialSynapsesForSegment[segment];
-      }
-    }
-  }
+  computeActivity_( numActivePotentialSynapsesForSegment.data(),
+                    activeBegin, activeEnd, false, useIndex );
 }
 
 
@@ -444,22 +964,40 @@ void Connections::adaptSegment(const Segment segment,
                                const Permanence increment,
                                const Permanence decrement)
 {
-  const vector<Synapse> &synapses = synapsesForSegment(segment);
-
   const auto &inputArray = inputs.getDense();
+  const SegmentData &segmentData = segments_[segment];
+  const CellIdx *presynapticCells = segmentData.presynapticCells.data();
+  const auto     numSynapses      = segmentData.synapses.size();
+  if( !packedSegments_ ) {
+    presynapticCellScratch_.resize( numSynapses );
+    for (Size i = 0; i < numSynapses; i++)
+      presynapticCellScratch_[i] = synapses_[segmentData.synapses[i]].presynapticCell;
+    presynapticCells = presynapticCellScratch_.data();
+  }
 
-  for (SynapseIdx i = 0; i < synapses.size(); i++) {
-    const SynapseData &synapseData = dataForSynapse(synapses[i]);
-
-    Permanence permanence = synapseData.permanence;
-    if( inputArray[synapseData.presynapticCell] ) {
-      permanence += increment;
-    } else {
-      permanence -= decrement;
+  if( quantizedPermanences_ ) {
+    const UInt16 activeUp     = quantizePermanence(  increment );
+    const UInt16 activeDown   = quantizePermanence( -increment );
+    const UInt16 inactiveUp   = quantizePermanence( -decrement );
+    const UInt16 inactiveDown = quantizePermanence(  decrement );
+    quantizedIncrements_.resize( numSynapses );
+    quantizedDecrements_.resize( numSynapses );
+    for (Size i = 0; i < numSynapses; i++) {
+      const bool active = inputArray[presynapticCells[i]] != 0u;
+      quantizedIncrements_[i] = active ? activeUp   : inactiveUp;
+      quantizedDecrements_[i] = active ? activeDown : inactiveDown;
     }
+    addSegmentQuantizedPermanences_( segment, quantizedIncrements_.data(), 0u,
+                                     quantizedDecrements_.data(), 0u );
+    return;
+  }
 
-    updateSynapsePermanence(synapses[i], permanence);
+  permanenceDeltas_.resize( numSynapses );
+  for (Size i = 0; i < numSynapses; i++) {
+    permanenceDeltas_[i] = inputArray[presynapticCells[i]] ? increment : -decrement;
   }
+
+  addSegmentPermanences_( segment, permanenceDeltas_.data(), 0.0f );
 }
 
 /** called for under-performing Segments. (can have synapses pruned, etc.)
@@ -480,8 +1018,7 @@ void Connections::raisePermanencesToThreshold(
   if( segData.numConnected >= segmentThreshold ) //the segment already satisfies the requirement, done.
     return;
 
-  vector<Synapse> &synapses = segData.synapses;
-  if( synapses.empty()) return; //no synapses to raise permanences to, no work
+  if( segData.synapses.empty()) return; //no synapses to raise permanences to, no work
   // Prune empty segment? No. 
   // The SP calls this method, but the SP does not do any pruning. 
   // The TM already has code to do pruning, but it doesn't ever call this method.
@@ -491,7 +1028,7 @@ void Connections::raisePermanencesToThreshold(
   // In this case the method should do the next best thing and connect as many synapses as it can.
   //
   //keep segmentThreshold within synapses range
-  const auto threshold = std::min((size_t)segmentThreshold, synapses.size());
+  const auto threshold = std::min((size_t)segmentThreshold, segData.synapses.size());
 
 
   // Sort the potential pool by permanence values, and look for the synapse with
@@ -500,30 +1037,285 @@ void Connections::raisePermanencesToThreshold(
   // permance by such that it becomes a connected synapse.
   // After that there will be at least N synapses connected.
 
-  auto minPermSynPtr = synapses.begin() + threshold - 1; //threshold is ensured to be >=1 by condition at very beginning if(thresh == 0)... 
-  // Do a partial sort, it's faster than a full sort. Only minPermSynPtr is in
+  if( quantizedPermanences_ ) {
+    // Raise the N'th quantized permanence to exactly the smallest quantized
+    // permanence which is connected, so that rounding the increment can not
+    // leave it short.
+    vector<UInt16> sorted( segData.quantizedPermanences );
+    auto minPermPtr = sorted.begin() + threshold - 1;
+    std::nth_element(sorted.begin(), minPermPtr, sorted.end(), std::greater<UInt16>());
+
+    const UInt16 target = quantizeThreshold( permanenceThreshold );
+    if( *minPermPtr >= target )
+      return;
+    addSegmentQuantizedPermanences_( segment, nullptr, (UInt16)(target - *minPermPtr),
+                                     nullptr, 0u );
+    return;
+  }
+
+  // Partially sort a copy of the permanences, so that the segment's synapses
+  // stay in creation order.
+  vector<Permanence> sorted;
+  sorted.reserve( segData.synapses.size() );
+  for( const Synapse synapse : segData.synapses )
+    sorted.push_back( synapses_[synapse].permanence );
+  auto minPermPtr = sorted.begin() + threshold - 1; //threshold is ensured to be >=1 by condition at very beginning if(thresh == 0)... 
+  // Do a partial sort, it's faster than a full sort. Only minPermPtr is in
   // its final sorted position.
-  const auto permanencesGreater = [&](const Synapse &A, const Synapse &B)
-    { return synapses_[A].permanence > synapses_[B].permanence; };
-  std::nth_element(synapses.begin(), minPermSynPtr, synapses.end(), permanencesGreater);
+  std::nth_element(sorted.begin(), minPermPtr, sorted.end(), std::greater<Permanence>());
 
-  const Real increment = permanenceThreshold - synapses_[ *minPermSynPtr ].permanence;
-  if( increment <= 0 ) // if( minPermSynPtr is already connected ) then ...
+  const Real increment = permanenceThreshold - *minPermPtr;
+  if( increment <= 0 ) // if( minPermPtr is already connected ) then ...
     return;            // Enough synapses are already connected.
 
   // Raise the permance of all synapses in the potential pool uniformly.
-  for( const auto &syn : synapses ) //TODO vectorize: vector + const to all members
-    updateSynapsePermanence(syn, synapses_[syn].permanence + increment);
+  addSegmentPermanences_( segment, nullptr, increment );
 }
 
 
 void Connections::bumpSegment(const Segment segment, const Permanence delta) {
-  const vector<Synapse> &synapses = synapsesForSegment(segment);
-  for( const auto &syn : synapses ) {
-    updateSynapsePermanence(syn, synapses_[syn].permanence + delta);
+  addSegmentPermanences_( segment, nullptr, delta );
+}
+
+
+vector<Segment> Connections::compact() {
+  vector<Segment> segmentRemap( segments_.size(), INVALID_SEGMENT );
+  vector<Synapse> synapseRemap( synapses_.size(), INVALID_SYNAPSE );
+  vector<SegmentData> segments;
+  vector<SynapseData> synapses;
+  vector<UInt64> segmentOrdinals, synapseOrdinals;
+  segments.reserve( numSegments() );
+  synapses.reserve( numSynapses() );
+  segmentOrdinals.reserve( numSegments() );
+  synapseOrdinals.reserve( numSynapses() );
+
+  // Number the segments in the order of their cells, and the synapses in the
+  // order of their segments.
+  for( CellData &cellData : cells_ ) {
+    for( Segment &segment : cellData.segments ) {
+      const Segment newSegment = (Segment)segments.size();
+      segmentRemap[segment] = newSegment;
+      segmentOrdinals.push_back( segmentOrdinals_[segment] );
+      segments.push_back( std::move( segments_[segment] ));
+      for( Synapse &synapse : segments.back().synapses ) {
+        synapseRemap[synapse] = (Synapse)synapses.size();
+        synapseOrdinals.push_back( synapseOrdinals_[synapse] );
+        synapses.push_back( synapses_[synapse] );
+        synapses.back().segment = newSegment;
+        synapse = synapseRemap[synapse];
+      }
+      segment = newSegment;
+    }
   }
+
+  // The presynaptic maps keep their order, so the synapses keep their
+  // presynapticMapIndex_ and computeActivity counts in the same order.
+  for( auto *maps : { &potentialSynapsesForPresynapticCell_,
+                      &connectedSynapsesForPresynapticCell_ }) {
+    for( auto &map : *maps ) {
+      for( Synapse &synapse : map )
+        synapse = synapseRemap[synapse];
+    }
+  }
+  for( auto *maps : { &potentialSegmentsForPresynapticCell_,
+                      &connectedSegmentsForPresynapticCell_ }) {
+    for( auto &map : *maps ) {
+      for( Segment &segment : map )
+        segment = segmentRemap[segment];
+    }
+  }
+  presynapticMapsChanged_ = true;
+  presynapticIndexValid_  = false;
+
+  if( connectedBitmapValid_ ) {
+    const Size numWords = connectedBitmap_.numWords;
+    vector<UInt64> masks( segments.size() * numWords );
+    for( Segment segment = 0u; segment < segmentRemap.size(); segment++ ) {
+      if( segmentRemap[segment] == INVALID_SEGMENT )
+        continue;
+      std::copy_n( connectedBitmap_.masks.begin() + segment * numWords, numWords,
+                   masks.begin() + segmentRemap[segment] * numWords );
+    }
+    connectedBitmap_.masks.swap( masks );
+  }
+
+  segments_.swap( segments );
+  synapses_.swap( synapses );
+  segmentOrdinals_.swap( segmentOrdinals );
+  synapseOrdinals_.swap( synapseOrdinals );
+  destroyedSegments_.clear();
+  destroyedSynapses_.clear();
+
+  for (auto h : eventHandlers_) {
+    h.second->onCompact(segmentRemap, synapseRemap);
+  }
+  return segmentRemap;
+}
+
+Real Connections::fragmentation() const {
+  const Real segments = segments_.empty() ? 0.0f
+      : (Real)destroyedSegments_.size() / (Real)segments_.size();
+  const Real synapses = synapses_.empty() ? 0.0f
+      : (Real)destroyedSynapses_.size() / (Real)synapses_.size();
+  return std::max( segments, synapses );
+}
+
+void Connections::setCompactionThreshold(const Real threshold) {
+  NTA_CHECK( threshold >= 0.0f && threshold <= 1.0f );
+  compactionThreshold_ = threshold;
 }
 
+Real Connections::getCompactionThreshold() const {
+  return compactionThreshold_;
+}
+
+bool Connections::needsCompaction() const {
+  return compactionThreshold_ > 0.0f && fragmentation() >= compactionThreshold_;
+}
+
+void Connections::setPackedSegments(const bool packed) {
+  if( packed == packedSegments_ )
+    return;
+  NTA_CHECK( packed || !quantizedPermanences_ )
+    << "Connections: quantized permanences need the packed segments.";
+  packedSegments_ = packed;
+  if( packed ) {
+    for( const CellData &cellData : cells_ ) {
+      for( const Segment segment : cellData.segments ) {
+        SegmentData &segmentData = segments_[segment];
+        reserveSegmentLists_( segmentData, segmentData.synapses.size() );
+        for( const Synapse synapse : segmentData.synapses ) {
+          segmentData.presynapticCells.push_back( synapses_[synapse].presynapticCell );
+          segmentData.permanences.push_back( synapses_[synapse].permanence );
+        }
+      }
+    }
+  }
+  else {
+    // Also release the lists which destroyed segments keep for reuse.
+    for( SegmentData &segmentData : segments_ ) {
+      vector<CellIdx>().swap( segmentData.presynapticCells );
+      vector<Permanence>().swap( segmentData.permanences );
+    }
+  }
+}
+
+bool Connections::getPackedSegments() const {
+  return packedSegments_;
+}
+
+void Connections::setQuantizedPermanences(const bool quantized) {
+  if( quantized == quantizedPermanences_ )
+    return;
+  setPackedSegments( true );
+  quantizedPermanences_ = quantized;
+  for( const CellData &cellData : cells_ ) {
+    for( const Segment segment : cellData.segments ) {
+      SegmentData &segmentData = segments_[segment];
+      const Synapse numSynapses = (Synapse)segmentData.synapses.size();
+      reserveSegmentLists_( segmentData, numSynapses );
+      if( quantized ) {
+        // Rounding can move a permanence across the connected threshold.
+        segmentData.quantizedPermanences.resize( numSynapses );
+        for( Synapse i = 0u; i < numSynapses; i++ ) {
+          SynapseData &synapseData = synapses_[segmentData.synapses[i]];
+          const Permanence before  = synapseData.permanence;
+          const UInt16 quantized   = quantizePermanence( before );
+          segmentData.quantizedPermanences[i] = quantized;
+          synapseData.permanence = dequantizePermanence( quantized );
+          if( (before >= connectedThreshold_) !=
+              (synapseData.permanence >= connectedThreshold_) )
+            synapseCrossedThreshold_( segmentData.synapses[i] );
+        }
+        vector<Permanence>().swap( segmentData.permanences );
+      }
+      else {
+        // The dequantized permanences are exact as floats.
+        segmentData.permanences.resize( numSynapses );
+        for( Synapse i = 0u; i < numSynapses; i++ ) {
+          segmentData.permanences[i] = synapses_[segmentData.synapses[i]].permanence;
+        }
+        vector<UInt16>().swap( segmentData.quantizedPermanences );
+      }
+    }
+  }
+}
+
+bool Connections::getQuantizedPermanences() const {
+  return quantizedPermanences_;
+}
+
+void Connections::setSegmentCapacity(const SynapseIdx capacity) {
+  segmentCapacity_ = capacity;
+}
+
+SynapseIdx Connections::getSegmentCapacity() const {
+  return segmentCapacity_;
+}
+
+void Connections::reserveSegmentLists_(SegmentData &segmentData,
+                                       const Size numSynapses) {
+  if( numSynapses > segmentCapacity_ )
+    segmentListGrowths_++;
+  const Size capacity = std::max( numSynapses, (Size)segmentCapacity_ );
+  segmentData.synapses.reserve( capacity );
+  if( !packedSegments_ )
+    return;
+  segmentData.presynapticCells.reserve( capacity );
+  if( quantizedPermanences_ )
+    segmentData.quantizedPermanences.reserve( capacity );
+  else
+    segmentData.permanences.reserve( capacity );
+}
+
+namespace {
+template <typename T>
+Size capacityBytes(const vector<T> &list) {
+  return list.capacity() * sizeof(T);
+}
+
+template <typename T>
+Size capacityBytes(const vector<vector<T>> &lists) {
+  Size bytes = lists.capacity() * sizeof(vector<T>);
+  for( const auto &list : lists )
+    bytes += list.capacity() * sizeof(T);
+  return bytes;
+}
+} // end anonymous namespace
+
+Connections::HeapStatistics Connections::heapStatistics() const {
+  std::lock_guard<std::mutex> lock( activityMutex_.mutex );
+  HeapStatistics stats;
+  for( const SegmentData &segmentData : segments_ ) {
+    stats.segmentListBytes += capacityBytes( segmentData.synapses )
+                            + capacityBytes( segmentData.presynapticCells )
+                            + capacityBytes( segmentData.permanences )
+                            + capacityBytes( segmentData.quantizedPermanences );
+    stats.segmentListBytesInUse += segmentData.synapses.size() *
+        (sizeof(Synapse) + (!packedSegments_ ? 0u : sizeof(CellIdx) +
+         (quantizedPermanences_ ? sizeof(UInt16) : sizeof(Permanence))));
+  }
+  stats.cellListBytes = capacityBytes( cells_ );
+  for( const CellData &cellData : cells_ )
+    stats.cellListBytes += capacityBytes( cellData.segments );
+  stats.flatListBytes = capacityBytes( segments_ ) + capacityBytes( synapses_ )
+                      + capacityBytes( destroyedSegments_ )
+                      + capacityBytes( destroyedSynapses_ )
+                      + capacityBytes( segmentOrdinals_ )
+                      + capacityBytes( synapseOrdinals_ );
+  stats.presynapticBytes =
+      capacityBytes( potentialSynapsesForPresynapticCell_ ) +
+      capacityBytes( connectedSynapsesForPresynapticCell_ ) +
+      capacityBytes( potentialSegmentsForPresynapticCell_ ) +
+      capacityBytes( connectedSegmentsForPresynapticCell_ ) +
+      capacityBytes( connectedPresynapticIndex_.offsets ) +
+      capacityBytes( connectedPresynapticIndex_.segments ) +
+      capacityBytes( potentialPresynapticIndex_.offsets ) +
+      capacityBytes( potentialPresynapticIndex_.segments ) +
+      capacityBytes( connectedBitmap_.masks );
+  stats.segmentListGrowths = segmentListGrowths_;
+  return stats;
+}
 
 void Connections::save(std::ostream &outStream) const {
   outStream << std::setprecision(std::numeric_limits<Real32>::max_digits10);
@@ -564,6 +1356,13 @@ void Connections::save(std::ostream &outStream) const {
 
 
 void Connections::load(std::istream &inStream) {
+  // The binary format starts with a byte that is not text.
+  inStream >> std::ws;
+  if( inStream.peek() == (int)(unsigned char)binary::magic[0] ) {
+    loadBinary_( inStream );
+    return;
+  }
+
   // Check the marker
   string marker;
   inStream >> marker;
@@ -626,6 +1425,263 @@ void Connections::load(std::istream &inStream) {
 }
 
 
+void Connections::saveBinary(std::ostream &outStream,
+                             const bool presynapticIndex) const {
+  // Flatten the live segments and synapses, in the same order as save().
+  const UInt32 numCells = (UInt32)cells_.size();
+  vector<UInt32>     cellSegmentOffsets    = { 0u };
+  vector<UInt32>     segmentSynapseOffsets = { 0u };
+  vector<CellIdx>    presynapticCells;
+  vector<Permanence> permanences;
+  cellSegmentOffsets.reserve( numCells + 1u );
+  segmentSynapseOffsets.reserve( numSegments() + 1u );
+  presynapticCells.reserve( numSynapses() );
+  permanences.reserve( numSynapses() );
+  for( const CellData &cellData : cells_ ) {
+    for( const Segment segment : cellData.segments ) {
+      for( const Synapse synapse : segments_[segment].synapses ) {
+        presynapticCells.push_back( synapses_[synapse].presynapticCell );
+        permanences.push_back( synapses_[synapse].permanence );
+      }
+      segmentSynapseOffsets.push_back( (UInt32)presynapticCells.size() );
+    }
+    cellSegmentOffsets.push_back( (UInt32)segmentSynapseOffsets.size() - 1u );
+  }
+
+  // The presynaptic maps, in the new segment numbering.  Filling them in
+  // synapse order keeps each list sorted by segment.
+  UInt32 numPresynapticCells = 0u;
+  for( const CellIdx cell : presynapticCells )
+    numPresynapticCells = std::max( numPresynapticCells, cell + 1u );
+  vector<UInt32>  connectedOffsets, potentialOffsets;
+  vector<Segment> connectedSegments, potentialSegments;
+  if( presynapticIndex ) {
+    connectedOffsets.assign( numPresynapticCells + 1u, 0u );
+    potentialOffsets.assign( numPresynapticCells + 1u, 0u );
+    for( Size i = 0u; i < presynapticCells.size(); i++ ) {
+      auto &offsets = permanences[i] >= connectedThreshold_ ? connectedOffsets
+                                                            : potentialOffsets;
+      offsets[presynapticCells[i] + 1u]++;
+    }
+    std::partial_sum( connectedOffsets.begin(), connectedOffsets.end(), connectedOffsets.begin() );
+    std::partial_sum( potentialOffsets.begin(), potentialOffsets.end(), potentialOffsets.begin() );
+    connectedSegments.resize( connectedOffsets.back() );
+    potentialSegments.resize( potentialOffsets.back() );
+    vector<UInt32> connectedNext( connectedOffsets.begin(), connectedOffsets.end() - 1 );
+    vector<UInt32> potentialNext( potentialOffsets.begin(), potentialOffsets.end() - 1 );
+    for( Segment segment = 0u; segment + 1u < segmentSynapseOffsets.size(); segment++ ) {
+      for( UInt32 i = segmentSynapseOffsets[segment]; i < segmentSynapseOffsets[segment + 1u]; i++ ) {
+        if( permanences[i] >= connectedThreshold_ )
+          connectedSegments[connectedNext[presynapticCells[i]]++] = segment;
+        else
+          potentialSegments[potentialNext[presynapticCells[i]]++] = segment;
+      }
+    }
+  }
+
+  // Header.  Save the original permanence threshold, as save() does.
+  const UInt32     version            = BINARY_VERSION;
+  const Permanence connectedThreshold = connectedThreshold_ + nupic::Epsilon;
+  const UInt64     segmentCount       = segmentSynapseOffsets.size() - 1u;
+  const UInt64     synapseCount       = presynapticCells.size();
+  const UInt32     flags              = presynapticIndex ? binary::presynapticIndexFlag : 0u;
+  const UInt32     padding            = 0u;
+
+  binary::Checksum checksum;
+  binary::addHeader( checksum, version, numCells, connectedThreshold,
+                     numPresynapticCells, segmentCount, synapseCount, flags );
+  checksum.add( cellSegmentOffsets.data(),    cellSegmentOffsets.size() );
+  checksum.add( segmentSynapseOffsets.data(), segmentSynapseOffsets.size() );
+  checksum.add( presynapticCells.data(),      presynapticCells.size() );
+  checksum.add( permanences.data(),           permanences.size() );
+  if( presynapticIndex ) {
+    checksum.add( connectedOffsets.data(),    connectedOffsets.size() );
+    checksum.add( connectedSegments.data(),   connectedSegments.size() );
+    checksum.add( potentialOffsets.data(),    potentialOffsets.size() );
+    checksum.add( potentialSegments.data(),   potentialSegments.size() );
+  }
+  const UInt64 hash = checksum.value();
+  outStream.write( binary::magic, sizeof(binary::magic) );
+  binary::write( outStream, &version,             1u );
+  binary::write( outStream, &numCells,            1u );
+  binary::write( outStream, &connectedThreshold,  1u );
+  binary::write( outStream, &numPresynapticCells, 1u );
+  binary::write( outStream, &segmentCount,        1u );
+  binary::write( outStream, &synapseCount,        1u );
+  binary::write( outStream, &hash,                1u );
+  binary::write( outStream, &flags,               1u );
+  binary::write( outStream, &padding,             1u );
+
+  binary::writeArray( outStream, cellSegmentOffsets );
+  binary::writeArray( outStream, segmentSynapseOffsets );
+  binary::writeArray( outStream, presynapticCells );
+  binary::writeArray( outStream, permanences );
+  if( presynapticIndex ) {
+    binary::writeArray( outStream, connectedOffsets );
+    binary::writeArray( outStream, connectedSegments );
+    binary::writeArray( outStream, potentialOffsets );
+    binary::writeArray( outStream, potentialSegments );
+  }
+}
+
+
+void Connections::loadBinary_(std::istream &inStream) {
+  char magic[sizeof(binary::magic)];
+  inStream.read( magic, sizeof(magic) );
+  NTA_CHECK( inStream.good() &&
+             std::equal( magic, magic + sizeof(magic), binary::magic ))
+    << "Connections: not the binary format.";
+
+  UInt32     version;
+  UInt32     numCells;
+  Permanence connectedThreshold;
+  UInt32     numPresynapticCells;
+  UInt64     segmentCount;
+  UInt64     synapseCount;
+  UInt64     hash;
+  UInt32     flags;
+  binary::read( inStream, &version, 1u );
+  NTA_CHECK( version == BINARY_VERSION )
+    << "Connections: unsupported binary version " << version << ".";
+  binary::read( inStream, &numCells,            1u );
+  binary::read( inStream, &connectedThreshold,  1u );
+  binary::read( inStream, &numPresynapticCells, 1u );
+  binary::read( inStream, &segmentCount,        1u );
+  binary::read( inStream, &synapseCount,        1u );
+  binary::read( inStream, &hash,                1u );
+  binary::read( inStream, &flags,               1u );
+  inStream.ignore( sizeof(UInt32) ); // Padding.
+  NTA_CHECK( segmentCount < std::numeric_limits<Segment>::max() &&
+             synapseCount < std::numeric_limits<Synapse>::max() )
+    << "Connections: corrupt binary header.";
+
+  vector<UInt32>     cellSegmentOffsets;
+  vector<UInt32>     segmentSynapseOffsets;
+  vector<CellIdx>    presynapticCells;
+  vector<Permanence> permanences;
+  binary::Checksum   checksum;
+  binary::addHeader( checksum, version, numCells, connectedThreshold,
+                     numPresynapticCells, segmentCount, synapseCount, flags );
+  binary::readArray( inStream, cellSegmentOffsets,    (Size)numCells + 1u );
+  binary::readArray( inStream, segmentSynapseOffsets, (Size)segmentCount + 1u );
+  binary::readArray( inStream, presynapticCells,      (Size)synapseCount );
+  binary::readArray( inStream, permanences,           (Size)synapseCount );
+  checksum.add( cellSegmentOffsets.data(),    cellSegmentOffsets.size() );
+  checksum.add( segmentSynapseOffsets.data(), segmentSynapseOffsets.size() );
+  checksum.add( presynapticCells.data(),      presynapticCells.size() );
+  checksum.add( permanences.data(),           permanences.size() );
+  // The presynaptic maps are rebuilt below, with synapse indices, so these
+  // are only read for the checksum.
+  vector<UInt32> offsets, segments;
+  for( int map = 0; map < 2 && (flags & binary::presynapticIndexFlag); map++ ) {
+    binary::readArray( inStream, offsets, (Size)numPresynapticCells + 1u );
+    NTA_CHECK( offsets.back() <= synapseCount ) << "Connections: corrupt binary header.";
+    binary::readArray( inStream, segments, offsets.back() );
+    checksum.add( offsets.data(),  offsets.size() );
+    checksum.add( segments.data(), segments.size() );
+  }
+  NTA_CHECK( checksum.value() == hash ) << "Connections: binary checksum mismatch.";
+  NTA_CHECK( cellSegmentOffsets.front() == 0u &&
+             cellSegmentOffsets.back() == segmentCount &&
+             segmentSynapseOffsets.front() == 0u &&
+             segmentSynapseOffsets.back() == synapseCount &&
+             std::is_sorted( cellSegmentOffsets.begin(), cellSegmentOffsets.end() ) &&
+             std::is_sorted( segmentSynapseOffsets.begin(), segmentSynapseOffsets.end() ))
+    << "Connections: inconsistent binary counts.";
+
+  initialize( numCells, connectedThreshold );
+
+  // Segments and synapses get consecutive indices, and ordinals in the same
+  // order as if they had been created one by one.
+  segments_.resize( (Size)segmentCount );
+  synapses_.resize( (Size)synapseCount );
+  segmentOrdinals_.resize( (Size)segmentCount );
+  synapseOrdinals_.resize( (Size)synapseCount );
+  std::iota( segmentOrdinals_.begin(), segmentOrdinals_.end(), (UInt64)0u );
+  std::iota( synapseOrdinals_.begin(), synapseOrdinals_.end(), (UInt64)0u );
+  nextSegmentOrdinal_ = segmentCount;
+  nextSynapseOrdinal_ = synapseCount;
+
+  CellIdx maxPresynapticCell = 0u;
+  for( CellIdx cell = 0u; cell < numCells; cell++ ) {
+    auto &cellSegments = cells_[cell].segments;
+    cellSegments.resize( cellSegmentOffsets[cell + 1u] - cellSegmentOffsets[cell] );
+    std::iota( cellSegments.begin(), cellSegments.end(), cellSegmentOffsets[cell] );
+    for( const Segment segment : cellSegments ) {
+      SegmentData &segmentData = segments_[segment];
+      const Synapse begin = segmentSynapseOffsets[segment];
+      const Synapse count = segmentSynapseOffsets[segment + 1u] - begin;
+      segmentData.cell = cell;
+      segmentData.numConnected = 0u;
+      reserveSegmentLists_( segmentData, count );
+      segmentData.synapses.resize( count );
+      std::iota( segmentData.synapses.begin(), segmentData.synapses.end(), begin );
+      if( packedSegments_ ) {
+        segmentData.presynapticCells.assign( presynapticCells.begin() + begin,
+                                             presynapticCells.begin() + begin + count );
+        if( quantizedPermanences_ )
+          segmentData.quantizedPermanences.resize( count );
+        else
+          segmentData.permanences.resize( count );
+      }
+      for( Synapse i = 0u; i < count; i++ ) {
+        const Synapse synapse = begin + i;
+        Permanence permanence = std::max( minPermanence,
+                                std::min( maxPermanence, permanences[synapse] ));
+        if( quantizedPermanences_ ) {
+          const UInt16 quantized = quantizePermanence( permanence );
+          segmentData.quantizedPermanences[i] = quantized;
+          permanence = dequantizePermanence( quantized );
+        }
+        else if( packedSegments_ ) {
+          segmentData.permanences[i] = permanence;
+        }
+        SynapseData &synapseData    = synapses_[synapse];
+        synapseData.presynapticCell = presynapticCells[synapse];
+        synapseData.permanence      = permanence;
+        synapseData.segment         = segment;
+        synapseData.segmentIndex_   = i;
+        if( permanence >= connectedThreshold_ )
+          segmentData.numConnected++;
+        maxPresynapticCell = std::max( maxPresynapticCell, synapseData.presynapticCell );
+      }
+    }
+  }
+
+  // Build the presynaptic maps: count, reserve, then fill in synapse order.
+  if( synapseCount > 0u ) {
+    growPresynapticMaps_( maxPresynapticCell );
+    const Size numPresynaptic = (Size)maxPresynapticCell + 1u;
+    vector<UInt32> numConnected( numPresynaptic, 0u );
+    vector<UInt32> numPotential( numPresynaptic, 0u );
+    for( const SynapseData &synapseData : synapses_ ) {
+      if( synapseData.permanence >= connectedThreshold_ )
+        numConnected[synapseData.presynapticCell]++;
+      else
+        numPotential[synapseData.presynapticCell]++;
+    }
+    for( Size cell = 0u; cell < numPresynaptic; cell++ ) {
+      connectedSynapsesForPresynapticCell_[cell].reserve( numConnected[cell] );
+      connectedSegmentsForPresynapticCell_[cell].reserve( numConnected[cell] );
+      potentialSynapsesForPresynapticCell_[cell].reserve( numPotential[cell] );
+      potentialSegmentsForPresynapticCell_[cell].reserve( numPotential[cell] );
+    }
+    for( Synapse synapse = 0u; synapse < synapses_.size(); synapse++ ) {
+      SynapseData &synapseData = synapses_[synapse];
+      const bool connected = synapseData.permanence >= connectedThreshold_;
+      auto &preSynapses = (connected ? connectedSynapsesForPresynapticCell_
+                                     : potentialSynapsesForPresynapticCell_)[synapseData.presynapticCell];
+      auto &preSegments = (connected ? connectedSegmentsForPresynapticCell_
+                                     : potentialSegmentsForPresynapticCell_)[synapseData.presynapticCell];
+      synapseData.presynapticMapIndex_ = (Synapse)preSynapses.size();
+      preSynapses.push_back( synapse );
+      preSegments.push_back( synapseData.segment );
+    }
+  }
+  presynapticMapsChanged_ = true;
+}
+
+
 CellIdx Connections::numCells() const { return (CellIdx)cells_.size(); }
 
 UInt Connections::numSegments() const {
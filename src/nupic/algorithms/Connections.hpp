@@ -28,7 +28,9 @@
 #define NTA_CONNECTIONS_HPP
 
 #include <climits>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <set>
 #include <utility>
 #include <vector>
@@ -36,6 +38,7 @@
 #include <nupic/types/Types.hpp>
 #include <nupic/types/Serializable.hpp>
 #include <nupic/types/Sdr.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace nupic {
 namespace algorithms {
@@ -68,6 +71,7 @@ struct SynapseData {
   Permanence permanence;
   Segment segment;
   Synapse presynapticMapIndex_;
+  Synapse segmentIndex_;
 };
 
 /**
@@ -79,11 +83,30 @@ struct SynapseData {
  * @param synapses
  * Synapses on this segment.
  *
+ * @param presynapticCells
+ * Presynaptic cell of each synapse, parallel to `synapses`.
+ *
+ * @param permanences
+ * Permanence of each synapse, parallel to `synapses`.
+ *
+ * @param quantizedPermanences
+ * Permanence of each synapse as 16 bit fixed point, parallel to `synapses`.
+ *
  * @param cell
  * The cell that this segment is on.
+ *
+ * The packed lists are only filled in when the Connections use packed
+ * segments, see Connections::setPackedSegments, and only one of permanences
+ * and quantizedPermanences is used, depending on whether the Connections use
+ * quantized permanences.  They mirror the SynapseData of the segment's
+ * synapses, so that learning updates a whole segment with unit stride loops
+ * instead of an indirection per synapse.
  */
 struct SegmentData {
   std::vector<Synapse> synapses;
+  std::vector<CellIdx> presynapticCells;
+  std::vector<Permanence> permanences;
+  std::vector<UInt16> quantizedPermanences;
   CellIdx cell;
   SynapseIdx numConnected;
 };
@@ -137,6 +160,24 @@ public:
    */
   virtual void onUpdateSynapsePermanence(Synapse synapse,
                                          Permanence permanence) {}
+
+  /**
+   * Called once after adaptSegment, bumpSegment, raisePermanencesToThreshold
+   * or updateSynapsePermanence changed any permanences of a segment, whether
+   * or not they cross the connected threshold.  Not called when clipping
+   * leaves every permanence as it was, nor for the initial permanence of a
+   * new synapse, which onCreateSynapse covers.
+   */
+  virtual void onUpdateSegmentPermanences(Segment segment) {}
+
+  /**
+   * Called after Connections::compact() renumbered the segments and
+   * synapses.  The new number of segment `s` is segmentRemap[s], and that of
+   * synapse `s` is synapseRemap[s].  Destroyed segments and synapses map to
+   * Connections::INVALID_SEGMENT and Connections::INVALID_SYNAPSE.
+   */
+  virtual void onCompact(const std::vector<Segment> &segmentRemap,
+                         const std::vector<Synapse> &synapseRemap) {}
 };
 
 /**
@@ -166,11 +207,20 @@ public:
  * Create a vector of length `connections.segmentFlatListLength()`,
  * iterate over segments and update the vector at index `segment`.
  *
+ * The const methods may be called from several threads at once, as long as
+ * no thread calls a non-const method meanwhile.  The computeActivity methods
+ * rebuild their caches lazily and share scratch buffers, so they and
+ * heapStatistics() take an internal lock, and concurrent calls on the same
+ * instance run one after another.
+ *
  */
 class Connections : public Serializable
  {
 public:
   static const UInt16 VERSION = 2;
+  static const UInt32 BINARY_VERSION = 1;
+  static const Segment INVALID_SEGMENT = std::numeric_limits<Segment>::max();
+  static const Synapse INVALID_SYNAPSE = std::numeric_limits<Synapse>::max();
 
   /**
    * Connections empty constructor.
@@ -387,6 +437,91 @@ public:
   computeActivity(std::vector<UInt32> &numActiveConnectedSynapsesForSegment,
                   const std::vector<CellIdx> &activePresynapticCells) const;
 
+  /**
+   * Multithreaded variant of computeActivity for the connected synapses.
+   *
+   * The active presynaptic cells are split across the threads of the pool,
+   * each thread counts into its own buffer, and the buffers are then summed
+   * per segment.  The result is identical to the serial computeActivity.
+   *
+   * Concurrent calls on the same instance run one after another.
+   *
+   * @param numActiveConnectedSynapsesForSegment
+   * An output vector for active connected synapse counts per segment.
+   *
+   * @param activePresynapticCells
+   * Active cells in the input.
+   *
+   * @param pool
+   * Threads to use.
+   */
+  void
+  computeActivity(std::vector<UInt32> &numActiveConnectedSynapsesForSegment,
+                  const std::vector<CellIdx> &activePresynapticCells,
+                  ThreadPool &pool) const;
+
+  /**
+   * Multithreaded variant of computeActivity for both the connected and the
+   * potential synapses.  The counting is split across the threads as for
+   * the connected synapses alone.  The results are identical to the serial
+   * computeActivity.
+   *
+   * Concurrent calls on the same instance run one after another.
+   */
+  void
+  computeActivity(std::vector<UInt32> &numActiveConnectedSynapsesForSegment,
+                  std::vector<UInt32> &numActivePotentialSynapsesForSegment,
+                  const std::vector<CellIdx> &activePresynapticCells,
+                  Permanence connectedPermanence,
+                  ThreadPool &pool) const;
+
+  /**
+   * Compute the active connected synapse counts for a batch of inputs.
+   *
+   * The engine is chosen once for the whole batch.  The bitmap engine reads
+   * each segment's mask once for all of the inputs, rather than once per
+   * input.  The work is split across the threads of the pool, if any, and
+   * the result is the same as calling computeActivity for every input.
+   *
+   * Concurrent calls on the same instance run one after another.
+   *
+   * @param numActiveConnectedSynapses
+   * Output, resized and cleared.  The count of segment `s` for input `i` is
+   * numActiveConnectedSynapses[i * getSegmentFlatVectorLength() + s].
+   *
+   * @param activePresynapticCells
+   * Active cells of each input.
+   *
+   * @param pool
+   * Threads to use, or nullptr to run on the calling thread.
+   */
+  void computeActivityBatch(
+      std::vector<UInt32> &numActiveConnectedSynapses,
+      const std::vector<const std::vector<CellIdx> *> &activePresynapticCells,
+      ThreadPool *pool = nullptr) const;
+
+  /**
+   * Engines which computeActivity can use to count the active connected
+   * synapses of every segment.
+   *
+   * - Sparse: walk the presynaptic lists of the active cells.
+   * - Bitmap: pack the active cells into a bitmap, and popcount it against a
+   *   bitmask of the connected presynaptic cells of every segment.  This is
+   *   faster for dense inputs, but the bitmasks use one bit per segment and
+   *   presynaptic cell.
+   * - Auto: estimate the work of both engines on every call, and use the
+   *   cheaper one.  This is the default.
+   *
+   * The bitmap engine is only used for the connected synapse counts, and not
+   * when a segment has several connected synapses onto the same presynaptic
+   * cell; then the sparse engine is used instead.  Both engines give the same
+   * results.
+   */
+  enum class ActivityEngine { Auto, Sparse, Bitmap };
+
+  void setActivityEngine(ActivityEngine engine);
+  ActivityEngine getActivityEngine() const;
+
   /**
    * Compute the segment excitations for a single active presynaptic cell.
    *
@@ -451,6 +586,113 @@ public:
    */
   void bumpSegment(const Segment segment, const Permanence delta);
 
+  /**
+   * Renumber the segments and synapses densely, removing the holes which
+   * destroySegment and destroySynapse leave in the flat lists.  The segments
+   * are numbered in the order of their cells, and the synapses in the order
+   * of their segments, as in a Connections loaded from saveBinary().  The
+   * order of the segments on a cell, and the results of computeActivity, do
+   * not change.
+   *
+   * Anything indexed by segment or synapse must be renumbered, with the
+   * returned map or the onCompact event.  TemporalMemory does this itself,
+   * when the compaction threshold is set.
+   *
+   * @retval The new number of every old segment, or INVALID_SEGMENT.
+   */
+  std::vector<Segment> compact();
+
+  /**
+   * Fraction of the flat segment or synapse list, whichever is larger, which
+   * is taken by destroyed segments or synapses.
+   */
+  Real fragmentation() const;
+
+  /**
+   * Fragmentation at which the owner of these connections should call
+   * compact(), or 0 to never compact automatically, which is the default.
+   * TemporalMemory checks it before computing the segment activity.
+   */
+  void setCompactionThreshold(Real threshold);
+  Real getCompactionThreshold() const;
+
+  /**
+   * True if the compaction threshold is set and reached.
+   */
+  bool needsCompaction() const;
+
+  /**
+   * Keep a packed copy of the presynaptic cells and permanences of every
+   * segment's synapses, parallel to its synapse list, so that adaptSegment,
+   * bumpSegment and raisePermanencesToThreshold run as unit stride,
+   * vectorized passes over the segment.  The SynapseData is kept up to date
+   * as well, so this costs a presynaptic cell and a permanence per synapse.
+   *
+   * The packed lists of existing segments are built or released.  The
+   * setting is off by default and kept by initialize().  It can not be
+   * turned off while the permanences are quantized.
+   */
+  void setPackedSegments(bool packed);
+  bool getPackedSegments() const;
+
+  /**
+   * Store the packed permanences of the segments as 16 bit fixed point
+   * instead of floats, and learn with saturating integer kernels.  This
+   * turns on the packed segments.  Permanences are then rounded to multiples
+   * of 1/65535, and so are the permanence steps of adaptSegment and
+   * bumpSegment.  Whether a synapse is connected is still decided exactly,
+   * by comparing its rounded permanence with the connected threshold.  The
+   * SynapseData hold the rounded permanences as floats.
+   *
+   * The permanences of existing synapses are converted.  The setting is off
+   * by default and kept by initialize().
+   */
+  void setQuantizedPermanences(bool quantized);
+  bool getQuantizedPermanences() const;
+
+  /**
+   * Number of synapses to reserve room for in the packed lists of every new
+   * segment, usually the maxSynapsesPerSegment of the algorithm, or 0 to
+   * grow the lists as needed, which is the default.
+   *
+   * With a capacity, growing a segment up to it never reallocates, and a
+   * destroyed segment keeps its lists for the next segment which is created,
+   * so once the number of segments stops growing the heap use is flat.
+   * Without one, the lists grow in the usual doubling steps.  The setting is
+   * kept by initialize().
+   */
+  void setSegmentCapacity(SynapseIdx capacity);
+  SynapseIdx getSegmentCapacity() const;
+
+  /**
+   * Heap memory held by a Connections, in bytes.
+   */
+  struct HeapStatistics {
+    /** Allocated for the packed synapse lists of the segments. */
+    Size segmentListBytes = 0u;
+    /** Part of segmentListBytes holding live synapses. */
+    Size segmentListBytesInUse = 0u;
+    /** Segment lists of the cells. */
+    Size cellListBytes = 0u;
+    /** Flat segment and synapse lists, free lists and ordinals. */
+    Size flatListBytes = 0u;
+    /** Presynaptic maps, their compact index and the connected bitmap. */
+    Size presynapticBytes = 0u;
+    /** Times a segment's synapse lists had to grow, since initialize(). */
+    UInt64 segmentListGrowths = 0u;
+
+    Size totalBytes() const {
+      return segmentListBytes + cellListBytes + flatListBytes + presynapticBytes;
+    }
+  };
+
+  /**
+   * Measure the heap memory held by this Connections.  The sizes are the
+   * capacities of the containers, not counting allocator overhead.  This
+   * walks every segment, so it is meant for monitoring, not for every step.
+   */
+  HeapStatistics heapStatistics() const;
+
   // Serialization
 
   /**
@@ -460,7 +702,22 @@ public:
 
 
   /**
-   * Loads serialized data from input stream.
+   * Saves in the binary format.  This is little-endian: a header with the
+   * format version, the counts and a checksum, followed by the flat segment,
+   * synapse and presynaptic arrays (see ConnectionsBinary.hpp).  It is much
+   * faster to load than the text format written by save(), which is kept for
+   * compatibility.
+   *
+   * @param presynapticIndex Also write the presynaptic maps, so that a
+   * ConnectionsView can memory map the file.  They hold one more segment
+   * number per synapse, and load() does not need them.
+   */
+  void saveBinary(std::ostream &outStream, bool presynapticIndex = false) const;
+
+
+  /**
+   * Loads serialized data from input stream, in either the text format of
+   * save() or the binary format of saveBinary().
    */
   virtual void load(std::istream &inStream) override;
 
@@ -570,6 +827,127 @@ protected:
                               std::vector<Synapse> &synapsesForPresynapticCell,
                               std::vector<Synapse> &segmentsForPresynapticCell);
 
+  /**
+   * Set the permanence of the synapse at the given index on its segment.
+   * Clips the permanence and moves the synapse between the presynaptic maps
+   * when it crosses the connected threshold.
+   *
+   * @param segment Segment of the synapse.
+   * @param index   Index of the synapse in the segment's synapse list.
+   * @param permanence New permanence.
+   *
+   * @retval Whether the stored permanence changed.
+   */
+  bool updateSynapsePermanence_(Segment segment, Synapse index,
+                                Permanence permanence);
+
+  /**
+   * Move a synapse between the potential and connected presynaptic maps,
+   * update its segment's numConnected and notify the event handlers, after
+   * its permanence crossed the connected threshold.  The direction follows
+   * from the synapse's current permanence.
+   */
+  void synapseCrossedThreshold_(Synapse synapse);
+
+  /**
+   * Add deltas to the permanences of all synapses on a segment, using the
+   * vectorized permanence kernels, then do the threshold crossing
+   * bookkeeping.  Without packed segments the permanences are gathered into
+   * a scratch buffer for the kernels.  Either way the results are written
+   * back to the SynapseData.
+   *
+   * @param segment Segment to update.
+   * @param deltas  Delta per synapse, parallel to the segment's synapse list,
+   *                or nullptr to add `delta` to every synapse.
+   * @param delta   Delta for every synapse, when deltas is nullptr.
+   */
+  void addSegmentPermanences_(Segment segment, const Permanence *deltas,
+                              Permanence delta);
+
+  /**
+   * Quantized version of addSegmentPermanences_, for when the Connections
+   * use quantized permanences.  See addQuantizedPermanences.
+   */
+  void addSegmentQuantizedPermanences_(Segment segment,
+                                       const UInt16 *increments, UInt16 increment,
+                                       const UInt16 *decrements, UInt16 decrement);
+
+  /**
+   * Load the binary format of saveBinary(), building the segments, synapses
+   * and presynaptic maps directly from the flat arrays.
+   */
+  void loadBinary_(std::istream &inStream);
+
+  /**
+   * Reserve the synapse lists of a segment, and its permanences in the
+   * current mode, for the given number of synapses or the segment capacity,
+   * whichever is larger.  Needing more than the capacity counts as a growth.
+   */
+  void reserveSegmentLists_(SegmentData &segmentData, Size numSynapses);
+
+  /**
+   * Grow the presynaptic maps so that they can be indexed by the given cell.
+   */
+  void growPresynapticMaps_(CellIdx presynapticCell);
+
+  /**
+   * Decide whether computeActivity should scan the compact presynaptic index,
+   * rebuilding it first if it is stale.
+   *
+   * The compact index is only rebuilt once the presynaptic maps have not
+   * changed for an entire call to computeActivity.  While learning, the maps
+   * change between almost every call and rebuilding the index each time would
+   * cost more than it saves, so the maps are scanned directly instead.
+   *
+   * @retval True if the compact index is valid and should be used.
+   */
+  bool usePresynapticIndex_() const;
+
+  /**
+   * Increment the counter of every segment which has a synapse onto one of
+   * the active presynaptic cells.
+   */
+  void computeActivity_(UInt32 *numActiveSynapsesForSegment,
+                        const CellIdx *activePresynapticCellsBegin,
+                        const CellIdx *activePresynapticCellsEnd,
+                        bool connected, bool useIndex) const;
+
+  /**
+   * Split computeActivity_ across the threads of the pool.  Each thread
+   * counts a range of the active cells into its own buffer, then the buffers
+   * are summed, with each thread owning a range of segments.
+   */
+  void computeActivityParallel_(std::vector<UInt32> &numActiveSynapsesForSegment,
+                                const std::vector<CellIdx> &activePresynapticCells,
+                                bool connected, bool useIndex,
+                                ThreadPool &pool) const;
+
+  /**
+   * Decide whether computeActivity should use the bitmap engine for these
+   * inputs, building the connected bitmasks first if needed.  If so, also
+   * packs the active cells of each input into the input bitmaps, one after
+   * another.
+   *
+   * @retval True if the bitmap engine should be used.
+   */
+  bool useBitmapEngine_(const std::vector<CellIdx> *const *inputs,
+                        Size numInputs) const;
+
+  /**
+   * Build the connected bitmasks from the connected presynaptic maps.
+   *
+   * @retval False if a segment has several connected synapses onto the same
+   * presynaptic cell, which the bitmasks can not represent.
+   */
+  bool buildConnectedBitmap_() const;
+
+  /**
+   * Keep the connected bitmasks, if they are built, in sync with a synapse
+   * which became connected or disconnected.
+   */
+  void setConnectedBit_(Segment segment, CellIdx presynapticCell);
+  void clearConnectedBit_(Segment segment, CellIdx presynapticCell);
+
 private:
   std::vector<CellData>    cells_;
   std::vector<SegmentData> segments_;
@@ -579,16 +957,80 @@ private:
   Permanence               connectedThreshold_;
 
   // Extra bookkeeping for faster computing of segment activity.
-  std::map<CellIdx, std::vector<Synapse>> potentialSynapsesForPresynapticCell_;
-  std::map<CellIdx, std::vector<Synapse>> connectedSynapsesForPresynapticCell_;
-  std::map<CellIdx, std::vector<Segment>> potentialSegmentsForPresynapticCell_;
-  std::map<CellIdx, std::vector<Segment>> connectedSegmentsForPresynapticCell_;
+  // These are indexed by presynaptic cell.
+  std::vector<std::vector<Synapse>> potentialSynapsesForPresynapticCell_;
+  std::vector<std::vector<Synapse>> connectedSynapsesForPresynapticCell_;
+  std::vector<std::vector<Segment>> potentialSegmentsForPresynapticCell_;
+  std::vector<std::vector<Segment>> connectedSegmentsForPresynapticCell_;
+
+  /**
+   * Compressed sparse row copy of a presynaptic segments map.  The segments
+   * for presynaptic cell `c` are segments[offsets[c]] .. segments[offsets[c+1]].
+   */
+  struct PresynapticIndex {
+    std::vector<UInt32>  offsets;
+    std::vector<Segment> segments;
+
+    void build(const std::vector<std::vector<Segment>> &segmentsForPresynapticCell);
+  };
+  mutable PresynapticIndex connectedPresynapticIndex_;
+  mutable PresynapticIndex potentialPresynapticIndex_;
+  mutable bool presynapticMapsChanged_ = true;
+  mutable bool presynapticIndexValid_  = false;
+
+  // Per thread scratch counters for the multithreaded computeActivity.
+  mutable std::vector<std::vector<UInt32>> threadActivity_;
+
+  /**
+   * Bitmask of the connected presynaptic cells of every segment, for the
+   * bitmap activity engine.  The mask of segment `s` is the numWords words
+   * starting at masks[s * numWords].
+   */
+  struct ConnectedBitmap {
+    UInt32              numWords = 0u;
+    std::vector<UInt64> masks;
+  };
+  ActivityEngine              activityEngine_ = ActivityEngine::Auto;
+  mutable ConnectedBitmap     connectedBitmap_;
+  mutable bool                connectedBitmapValid_    = false;
+  mutable bool                connectedBitmapDisabled_ = false;
+  mutable std::vector<UInt64> inputBitmap_;
+
+  /**
+   * Serializes the computeActivity methods, which rebuild the caches above
+   * and share their scratch buffers.  A copy gets a mutex of its own, so
+   * that the Connections stay copyable.
+   */
+  struct ActivityMutex {
+    ActivityMutex() {}
+    ActivityMutex(const ActivityMutex &) {}
+    ActivityMutex &operator=(const ActivityMutex &) { return *this; }
+    std::mutex mutex;
+  };
+  mutable ActivityMutex activityMutex_;
+
+  // Scratch buffers for the batch permanence updates.
+  std::vector<CellIdx>    presynapticCellScratch_;
+  std::vector<Permanence> permanenceScratch_;
+  std::vector<Permanence> permanenceDeltas_;
+  std::vector<UInt16>     quantizedIncrements_;
+  std::vector<UInt16>     quantizedDecrements_;
+  std::vector<UInt32>     thresholdCrossings_;
 
   std::vector<UInt64> segmentOrdinals_;
   std::vector<UInt64> synapseOrdinals_;
   UInt64 nextSegmentOrdinal_;
   UInt64 nextSynapseOrdinal_;
 
+  Real compactionThreshold_ = 0.0f;
+
+  bool   packedSegments_       = false;
+  bool   quantizedPermanences_ = false;
+  UInt16 quantizedThreshold_;
+
+  SynapseIdx segmentCapacity_    = 0u;
+  UInt64     segmentListGrowths_ = 0u;
+
   UInt32 nextEventToken_;
   std::map<UInt32, ConnectionsEventHandler *> eventHandlers_;
 }; // end class Connections
@@ -0,0 +1,224 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions shared by the readers and the writer of the binary format of
+ * Connections.  SpatialPooler and TemporalMemory use the same helpers for
+ * their binary formats, which embed that of their Connections.
+ *
+ * The format is little-endian.  A fixed size header is followed by flat
+ * arrays, each one padded to a multiple of 8 bytes, so that the arrays of a
+ * memory mapped file are aligned:
+ *
+ *   cellSegmentOffsets     UInt32[numCells + 1]
+ *   segmentSynapseOffsets  UInt32[numSegments + 1]
+ *   presynapticCells       UInt32[numSynapses]
+ *   permanences            Real32[numSynapses]
+ *   connectedOffsets       UInt32[numPresynapticCells + 1]
+ *   connectedSegments      UInt32[connectedOffsets[numPresynapticCells]]
+ *   potentialOffsets       UInt32[numPresynapticCells + 1]
+ *   potentialSegments      UInt32[potentialOffsets[numPresynapticCells]]
+ *
+ * Segments are numbered in the order of their cells, and synapses in the
+ * order of their segments.  The connected and potential arrays are the
+ * presynaptic maps, as compressed sparse rows.  They are only present when
+ * the header has the presynapticIndexFlag, which ConnectionsView needs and
+ * Connections::load does not.  The checksum covers the header fields and the
+ * values of all of the arrays.
+ */
+
+#ifndef NTA_CONNECTIONS_BINARY_HPP
+#define NTA_CONNECTIONS_BINARY_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+#include <nupic/utils/Log.hpp>
+
+namespace nupic {
+namespace algorithms {
+namespace connections {
+namespace binary {
+
+/**
+ * Start of the binary format.  The first byte has the high bit set, so that
+ * it can not be confused with the text format.
+ */
+const char magic[8] = { '\x89', 'N', 'T', 'A', 'C', 'O', 'N', '\n' };
+
+/**
+ * Size of the header, which is a multiple of 8.
+ */
+const Size headerSize = 56u;
+
+/**
+ * Header flag: the presynaptic maps follow the synapse arrays.
+ */
+const UInt32 presynapticIndexFlag = 1u;
+
+inline bool isLittleEndian() {
+  const UInt32 one = 1u;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1u;
+}
+
+/**
+ * Reverse the bytes of every element, to convert between little-endian and
+ * the host byte order on big-endian hosts.
+ */
+template<typename T> void swapBytes(T *data, Size count) {
+  for(Size i = 0u; i < count; i++) {
+    auto bytes = reinterpret_cast<unsigned char *>(data + i);
+    std::reverse( bytes, bytes + sizeof(T) );
+  }
+}
+
+/**
+ * Number of padding bytes after an array of the given size.
+ */
+inline Size padding(Size bytes) {
+  return (8u - bytes % 8u) % 8u;
+}
+
+/**
+ * FNV-1a style hash of the arrays, one element at a time.  It hashes the
+ * values rather than the bytes, so it does not depend on the byte order.
+ */
+class Checksum {
+public:
+  template<typename T> void add(const T *data, Size count) {
+    static_assert( sizeof(T) == sizeof(UInt16) || sizeof(T) == sizeof(UInt32) ||
+                   sizeof(T) == sizeof(UInt64), "16, 32 or 64 bit elements only" );
+    typedef typename std::conditional<sizeof(T) == sizeof(UInt16), UInt16,
+            typename std::conditional<sizeof(T) == sizeof(UInt32), UInt32,
+                                      UInt64>::type>::type Bits;
+    for(Size i = 0u; i < count; i++) {
+      Bits bits;
+      std::memcpy( &bits, data + i, sizeof(bits) );
+      hash_ = (hash_ ^ (UInt64)bits) * 0x100000001b3ull;
+    }
+  }
+  UInt64 value() const { return hash_; }
+private:
+  UInt64 hash_ = 0xcbf29ce484222325ull;
+};
+
+/**
+ * Add the fields of the header, other than the checksum itself, to a
+ * checksum.  The writer and the readers call this before adding the arrays.
+ */
+inline void addHeader(Checksum &checksum, UInt32 version, UInt32 numCells,
+                      Real32 connectedThreshold, UInt32 numPresynapticCells,
+                      UInt64 segmentCount, UInt64 synapseCount, UInt32 flags) {
+  checksum.add( &version,             1u );
+  checksum.add( &numCells,            1u );
+  checksum.add( &connectedThreshold,  1u );
+  checksum.add( &numPresynapticCells, 1u );
+  checksum.add( &segmentCount,        1u );
+  checksum.add( &synapseCount,        1u );
+  checksum.add( &flags,               1u );
+}
+
+template<typename T> void write(std::ostream &out, const T *data, Size count) {
+  if( isLittleEndian() ) {
+    out.write( reinterpret_cast<const char *>(data), (std::streamsize)(count * sizeof(T)) );
+  }
+  else {
+    std::vector<T> copy( data, data + count );
+    swapBytes( copy.data(), count );
+    out.write( reinterpret_cast<const char *>(copy.data()), (std::streamsize)(count * sizeof(T)) );
+  }
+}
+
+/**
+ * Write an array followed by its padding.
+ */
+template<typename T> void writeArray(std::ostream &out, const std::vector<T> &array) {
+  static const char zeros[8] = {0};
+  write( out, array.data(), array.size() );
+  out.write( zeros, (std::streamsize)padding( array.size() * sizeof(T) ));
+}
+
+template<typename T> void read(std::istream &in, T *data, Size count) {
+  in.read( reinterpret_cast<char *>(data), (std::streamsize)(count * sizeof(T)) );
+  NTA_CHECK( in.good() ) << "The binary data is truncated.";
+  if( !isLittleEndian() )
+    swapBytes( data, count );
+}
+
+/**
+ * Read an array of the given size followed by its padding.  The size comes
+ * from the untrusted header, so the array grows in chunks as the data
+ * arrives, and a truncated stream fails before a large allocation.
+ */
+template<typename T> void readArray(std::istream &in, std::vector<T> &array, Size count) {
+  array.clear();
+  const Size chunk = (Size)1u << 20u;
+  for( Size done = 0u; done < count; ) {
+    const Size size = std::min( chunk, count - done );
+    array.resize( done + size );
+    read( in, array.data() + done, size );
+    done += size;
+  }
+  in.ignore( (std::streamsize)padding( count * sizeof(T) ));
+}
+
+template<typename T> void writeValue(std::ostream &out, const T &value) {
+  write( out, &value, 1u );
+}
+
+template<typename T> T readValue(std::istream &in) {
+  T value;
+  read( in, &value, 1u );
+  return value;
+}
+
+/**
+ * Write the size of a vector followed by its elements, in a single write.
+ */
+template<typename T> void writeVector(std::ostream &out, const std::vector<T> &vector) {
+  writeValue( out, (UInt64)vector.size() );
+  write( out, vector.data(), vector.size() );
+}
+
+template<typename T> void readVector(std::istream &in, std::vector<T> &vector) {
+  const UInt64 size = readValue<UInt64>( in );
+  // Don't trust the size before reading the data.
+  vector.clear();
+  const UInt64 chunk = 1u << 20u;
+  for( UInt64 done = 0u; done < size; ) {
+    const UInt64 count = std::min( chunk, size - done );
+    vector.resize( (Size)(done + count) );
+    read( in, vector.data() + done, (Size)count );
+    done += count;
+  }
+}
+
+} // end namespace binary
+} // end namespace connections
+} // end namespace algorithms
+} // end namespace nupic
+
+#endif // NTA_CONNECTIONS_BINARY_HPP
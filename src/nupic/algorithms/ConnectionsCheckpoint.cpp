@@ -0,0 +1,371 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the ConnectionsCheckpoint class
+ */
+
+#include <fstream>
+#include <sstream>
+
+#include <nupic/algorithms/ConnectionsBinary.hpp>
+#include <nupic/algorithms/ConnectionsCheckpoint.hpp>
+#include <nupic/os/Directory.hpp>
+#include <nupic/os/OS.hpp>
+#include <nupic/os/Path.hpp>
+
+#if defined(NTA_OS_WINDOWS)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+using std::string;
+using std::vector;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+
+namespace {
+
+/**
+ * Starts of the snapshot and delta files, with the high bit set like that of
+ * the binary format of Connections.
+ */
+const char snapshotMagic[8] = { '\x89', 'N', 'T', 'A', 'S', 'N', 'P', '\n' };
+const char deltaMagic[8]    = { '\x89', 'N', 'T', 'A', 'D', 'L', 'T', '\n' };
+const UInt32 DELTA_VERSION = 1u;
+
+#if defined(NTA_OS_WINDOWS)
+
+/**
+ * Flush a file to the disk.
+ */
+void syncFile(const string &path) {
+  const HANDLE file = CreateFileA( path.c_str(), GENERIC_WRITE, 0, nullptr,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+  NTA_CHECK( file != INVALID_HANDLE_VALUE )
+    << "ConnectionsCheckpoint: can not open '" << path << "': " << OS::getErrorMessage();
+  const bool synced = FlushFileBuffers( file ) != 0;
+  const string error = synced ? "" : OS::getErrorMessage();
+  CloseHandle( file );
+  NTA_CHECK( synced ) << "ConnectionsCheckpoint: can not flush '" << path << "': " << error;
+}
+
+/**
+ * Windows can not flush a directory, the rename is as durable as NTFS makes it.
+ */
+void syncDirectory(const string &) {}
+
+#else
+
+/**
+ * Open a path with the given flags and flush it to the disk.
+ */
+void syncPath(const string &path, const int flags) {
+  const int fd = ::open( path.c_str(), flags );
+  NTA_CHECK( fd >= 0 )
+    << "ConnectionsCheckpoint: can not open '" << path << "': " << OS::getErrorMessage();
+  const bool synced = ::fsync( fd ) == 0;
+  const string error = synced ? "" : OS::getErrorMessage();
+  ::close( fd );
+  NTA_CHECK( synced ) << "ConnectionsCheckpoint: can not flush '" << path << "': " << error;
+}
+
+/**
+ * Flush a file to the disk.
+ */
+void syncFile(const string &path) { syncPath( path, O_RDONLY ); }
+
+/**
+ * Flush a directory to the disk, so that a rename in it is durable.
+ */
+void syncDirectory(const string &path) { syncPath( path, O_RDONLY | O_DIRECTORY ); }
+
+#endif
+
+/**
+ * Write a file through a temporary file, so that it is replaced atomically.
+ * The temporary file is flushed before the rename and the directory after
+ * it, so that after a crash the path holds either the old or the new
+ * contents, and a completed save is never lost.
+ */
+void writeFile(const string &path, const std::ostringstream &contents) {
+  const string temporary = path + ".tmp";
+  {
+    std::ofstream out( temporary, std::ios_base::out | std::ios_base::binary );
+    out.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+    const string &data = contents.str();
+    out.write( data.data(), (std::streamsize)data.size() );
+    // Close here, as the destructor would hide a failure to flush.
+    out.close();
+  }
+  syncFile( temporary );
+  Path::rename( temporary, path );
+  syncDirectory( Path::getParent( Path::makeAbsolute( path )));
+}
+
+/**
+ * Open a checkpoint file and check its magic.
+ */
+void openFile(const string &path, const char (&magic)[8], std::ifstream &in) {
+  in.open( path, std::ios_base::in | std::ios_base::binary );
+  NTA_CHECK( in.good() ) << "ConnectionsCheckpoint: can not open '" << path << "'.";
+  char fileMagic[sizeof(magic)];
+  binary::read( in, fileMagic, sizeof(fileMagic) );
+  NTA_CHECK( std::equal( fileMagic, fileMagic + sizeof(fileMagic), magic ))
+    << "ConnectionsCheckpoint: '" << path << "' is not a checkpoint file.";
+}
+
+UInt64 readGeneration(const string &directory) {
+  const string path = ConnectionsCheckpoint::snapshotPath( directory );
+  if( !Path::exists( path ))
+    return 0u;
+  std::ifstream in;
+  openFile( path, snapshotMagic, in );
+  return binary::readValue<UInt64>( in );
+}
+
+} // end anonymous namespace
+
+
+/**
+ * Marks the cells whose segments or synapses change.
+ */
+class ConnectionsCheckpoint::Tracker : public ConnectionsEventHandler {
+public:
+  Tracker(ConnectionsCheckpoint &checkpoint, const Connections &connections)
+    : checkpoint_(checkpoint), connections_(connections) {}
+
+  void onCreateSegment(Segment segment) override
+    { segmentChanged_( segment ); }
+  void onDestroySegment(Segment segment) override
+    { segmentChanged_( segment ); }
+  void onCreateSynapse(Synapse synapse) override
+    { synapseChanged_( synapse ); }
+  void onDestroySynapse(Synapse synapse) override
+    { synapseChanged_( synapse ); }
+  void onUpdateSynapsePermanence(Synapse synapse, Permanence) override
+    { synapseChanged_( synapse ); }
+  void onUpdateSegmentPermanences(Segment segment) override
+    { segmentChanged_( segment ); }
+
+private:
+  void segmentChanged_(Segment segment) {
+    checkpoint_.cellChanged_( connections_.cellForSegment( segment ));
+  }
+  void synapseChanged_(Synapse synapse) {
+    segmentChanged_( connections_.dataForSynapse( synapse ).segment );
+  }
+
+  ConnectionsCheckpoint &checkpoint_;
+  const Connections &connections_;
+};
+
+
+ConnectionsCheckpoint::ConnectionsCheckpoint(Connections &connections,
+                                             const string &directory,
+                                             const UInt compactInterval)
+  : connections_(connections),
+    directory_(directory),
+    compactInterval_(compactInterval),
+    numDeltas_(0u),
+    haveSnapshot_(false),
+    generation_(0u),
+    changed_(connections.numCells(), false)
+{
+  Directory::create( directory_, false, true );
+  token_ = connections_.subscribe( new Tracker( *this, connections_ ));
+}
+
+
+ConnectionsCheckpoint::~ConnectionsCheckpoint() {
+  connections_.unsubscribe( token_ );
+}
+
+
+string ConnectionsCheckpoint::snapshotPath(const string &directory) {
+  return Path::join( directory, "snapshot.bin" );
+}
+
+
+string ConnectionsCheckpoint::deltaPath(const string &directory, const UInt sequence) {
+  return Path::join( directory, "delta-" + std::to_string( sequence ) + ".bin" );
+}
+
+
+void ConnectionsCheckpoint::cellChanged_(const CellIdx cell) {
+  if( !changed_[cell] ) {
+    changed_[cell] = true;
+    changedCells_.push_back( cell );
+  }
+}
+
+
+void ConnectionsCheckpoint::clearChanges_() {
+  for( const CellIdx cell : changedCells_ )
+    changed_[cell] = false;
+  changedCells_.clear();
+}
+
+
+void ConnectionsCheckpoint::save() {
+  if( !haveSnapshot_ || numDeltas_ >= compactInterval_ )
+    saveSnapshot_();
+  else
+    saveDelta_();
+  clearChanges_();
+}
+
+
+void ConnectionsCheckpoint::saveSnapshot_() {
+  // A new generation makes the deltas of the previous snapshot stale, so
+  // they are only removed once the new snapshot is in place.
+  if( !haveSnapshot_ )
+    generation_ = readGeneration( directory_ );
+  generation_++;
+  std::ostringstream out( std::ios_base::out | std::ios_base::binary );
+  out.write( snapshotMagic, sizeof(snapshotMagic) );
+  binary::writeValue( out, generation_ );
+  connections_.saveBinary( out );
+  writeFile( snapshotPath( directory_ ), out );
+
+  for( UInt sequence = 1u; Path::exists( deltaPath( directory_, sequence )); sequence++ )
+    Path::remove( deltaPath( directory_, sequence ));
+  numDeltas_    = 0u;
+  haveSnapshot_ = true;
+}
+
+
+void ConnectionsCheckpoint::saveDelta_() {
+  // The segments of each changed cell, flattened.
+  vector<UInt32>     segmentCounts;
+  vector<UInt32>     synapseCounts;
+  vector<CellIdx>    presynapticCells;
+  vector<Permanence> permanences;
+  segmentCounts.reserve( changedCells_.size() );
+  for( const CellIdx cell : changedCells_ ) {
+    const vector<Segment> &segments = connections_.segmentsForCell( cell );
+    segmentCounts.push_back( (UInt32)segments.size() );
+    for( const Segment segment : segments ) {
+      const vector<Synapse> &synapses = connections_.synapsesForSegment( segment );
+      synapseCounts.push_back( (UInt32)synapses.size() );
+      for( const Synapse synapse : synapses ) {
+        const SynapseData &data = connections_.dataForSynapse( synapse );
+        presynapticCells.push_back( data.presynapticCell );
+        permanences.push_back( data.permanence );
+      }
+    }
+  }
+
+  binary::Checksum checksum;
+  checksum.add( changedCells_.data(),    changedCells_.size() );
+  checksum.add( segmentCounts.data(),    segmentCounts.size() );
+  checksum.add( synapseCounts.data(),    synapseCounts.size() );
+  checksum.add( presynapticCells.data(), presynapticCells.size() );
+  checksum.add( permanences.data(),      permanences.size() );
+
+  const UInt32 sequence = numDeltas_ + 1u;
+  std::ostringstream out( std::ios_base::out | std::ios_base::binary );
+  out.write( deltaMagic, sizeof(deltaMagic) );
+  binary::writeValue( out, DELTA_VERSION );
+  binary::writeValue( out, generation_ );
+  binary::writeValue( out, sequence );
+  binary::writeValue( out, (UInt32)connections_.numCells() );
+  binary::writeValue( out, checksum.value() );
+  binary::writeVector( out, changedCells_ );
+  binary::writeVector( out, segmentCounts );
+  binary::writeVector( out, synapseCounts );
+  binary::writeVector( out, presynapticCells );
+  binary::writeVector( out, permanences );
+  writeFile( deltaPath( directory_, sequence ), out );
+  numDeltas_ = sequence;
+}
+
+
+void ConnectionsCheckpoint::restore(const string &directory, Connections &connections) {
+  std::ifstream snapshot;
+  openFile( snapshotPath( directory ), snapshotMagic, snapshot );
+  const UInt64 generation = binary::readValue<UInt64>( snapshot );
+  connections.load( snapshot );
+
+  for( UInt sequence = 1u; Path::exists( deltaPath( directory, sequence )); sequence++ ) {
+    const string path = deltaPath( directory, sequence );
+    std::ifstream in;
+    openFile( path, deltaMagic, in );
+    const UInt32 version = binary::readValue<UInt32>( in );
+    NTA_CHECK( version <= DELTA_VERSION )
+      << "ConnectionsCheckpoint: unsupported delta version " << version;
+    // Deltas of an older snapshot are left over from an interrupted
+    // compaction.
+    if( binary::readValue<UInt64>( in ) != generation ||
+        binary::readValue<UInt32>( in ) != sequence )
+      break;
+    NTA_CHECK( binary::readValue<UInt32>( in ) == connections.numCells() )
+      << "ConnectionsCheckpoint: '" << path << "' has another number of cells.";
+    const UInt64 hash = binary::readValue<UInt64>( in );
+    vector<CellIdx>    cells;
+    vector<UInt32>     segmentCounts;
+    vector<UInt32>     synapseCounts;
+    vector<CellIdx>    presynapticCells;
+    vector<Permanence> permanences;
+    binary::readVector( in, cells );
+    binary::readVector( in, segmentCounts );
+    binary::readVector( in, synapseCounts );
+    binary::readVector( in, presynapticCells );
+    binary::readVector( in, permanences );
+
+    binary::Checksum checksum;
+    checksum.add( cells.data(),            cells.size() );
+    checksum.add( segmentCounts.data(),    segmentCounts.size() );
+    checksum.add( synapseCounts.data(),    synapseCounts.size() );
+    checksum.add( presynapticCells.data(), presynapticCells.size() );
+    checksum.add( permanences.data(),      permanences.size() );
+    NTA_CHECK( checksum.value() == hash &&
+               cells.size() == segmentCounts.size() &&
+               presynapticCells.size() == permanences.size() )
+      << "ConnectionsCheckpoint: '" << path << "' is corrupt.";
+
+    // Replace the segments of each cell.  Destroying them in reverse order
+    // makes createSegment reuse their numbers in the original order.
+    Size segmentIndex = 0u, synapseIndex = 0u;
+    for( Size i = 0u; i < cells.size(); i++ ) {
+      const CellIdx cell = cells[i];
+      NTA_CHECK( cell < connections.numCells() )
+        << "ConnectionsCheckpoint: '" << path << "' is corrupt.";
+      const vector<Segment> old = connections.segmentsForCell( cell );
+      for( auto segment = old.rbegin(); segment != old.rend(); ++segment )
+        connections.destroySegment( *segment );
+
+      for( UInt32 s = 0u; s < segmentCounts[i]; s++, segmentIndex++ ) {
+        NTA_CHECK( segmentIndex < synapseCounts.size() &&
+                   synapseIndex + synapseCounts[segmentIndex] <= presynapticCells.size() )
+          << "ConnectionsCheckpoint: '" << path << "' is corrupt.";
+        const Segment segment = connections.createSegment( cell );
+        for( UInt32 n = 0u; n < synapseCounts[segmentIndex]; n++, synapseIndex++ ) {
+          connections.createSynapse( segment, presynapticCells[synapseIndex],
+                                     permanences[synapseIndex] );
+        }
+      }
+    }
+  }
+}
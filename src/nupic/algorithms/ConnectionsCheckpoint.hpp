@@ -0,0 +1,135 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the ConnectionsCheckpoint class
+ */
+
+#ifndef NTA_CONNECTIONS_CHECKPOINT_HPP
+#define NTA_CONNECTIONS_CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+
+#include <nupic/algorithms/Connections.hpp>
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+namespace algorithms {
+namespace connections {
+
+/**
+ * Incremental checkpoints of Connections.
+ *
+ * @b Description
+ * A ConnectionsCheckpoint subscribes to the events of a Connections and
+ * records which cells change.  save() writes a full snapshot the first time.
+ * After that it writes a delta with only the segments of the changed cells,
+ * so the checkpoint I/O scales with the churn rather than the model size.
+ * Every `compactInterval` deltas, save() writes a new snapshot instead, which
+ * replaces the old snapshot and its deltas.
+ *
+ * restore() loads the snapshot and replays the deltas over it.  The replayed
+ * cells keep their segment numbers, so a SpatialPooler's one segment per
+ * column stays at the column's index.
+ *
+ * The files are written to temporary files, flushed to the disk and then
+ * renamed, and the directory is flushed after the rename.  Every snapshot
+ * gets a new generation number and each delta records the generation of its
+ * snapshot.  restore() stops at the first delta of another generation, so a
+ * crash during save() leaves the checkpoint of the previous save(), or of
+ * this one if its rename reached the disk.
+ *
+ * The Connections must outlive the checkpoint.  They must not be initialized
+ * or loaded again while the checkpoint is subscribed to their events.
+ */
+class ConnectionsCheckpoint {
+public:
+  /**
+   * Start recording the changes to a Connections.
+   *
+   * @param connections     The Connections to checkpoint.
+   * @param directory       Where to write the snapshot and deltas.  It is
+   *                        created if it does not exist.
+   * @param compactInterval Number of deltas after which save() writes a new
+   *                        snapshot.
+   */
+  ConnectionsCheckpoint(Connections &connections, const std::string &directory,
+                        UInt compactInterval = 10u);
+
+  ~ConnectionsCheckpoint();
+
+  ConnectionsCheckpoint(const ConnectionsCheckpoint &) = delete;
+  ConnectionsCheckpoint &operator=(const ConnectionsCheckpoint &) = delete;
+
+  /**
+   * Write a snapshot or a delta of the cells which changed since the last
+   * save().
+   */
+  void save();
+
+  /**
+   * Load the latest checkpoint in a directory into a Connections.
+   */
+  static void restore(const std::string &directory, Connections &connections);
+
+  /**
+   * Number of deltas written since the last snapshot.
+   */
+  UInt numDeltas() const { return numDeltas_; }
+
+  /**
+   * Cells which changed since the last save(), in the order of their first
+   * change.
+   */
+  const std::vector<CellIdx> &changedCells() const { return changedCells_; }
+
+  /**
+   * File names within the directory.
+   */
+  static std::string snapshotPath(const std::string &directory);
+  static std::string deltaPath(const std::string &directory, UInt sequence);
+
+private:
+  class Tracker;
+
+  void cellChanged_(CellIdx cell);
+  void saveSnapshot_();
+  void saveDelta_();
+  void clearChanges_();
+
+  Connections &connections_;
+  UInt32 token_;
+  std::string directory_;
+  UInt compactInterval_;
+  UInt numDeltas_;
+  bool haveSnapshot_;
+  UInt64 generation_;
+  std::vector<bool> changed_;
+  std::vector<CellIdx> changedCells_;
+};
+
+} // end namespace connections
+} // end namespace algorithms
+} // end namespace nupic
+
+#endif // NTA_CONNECTIONS_CHECKPOINT_HPP
@@ -0,0 +1,390 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the vectorized kernels used by Connections
+ *
+ * The SIMD kernels are compiled with per-function target attributes (GCC and
+ * Clang) or need no flags at all (MSVC x64), so the library itself is still
+ * built for the baseline architecture and the instruction set is chosen at
+ * runtime.
+ */
+
+#include <algorithm>
+
+#include <nupic/algorithms/Connections.hpp>
+#include <nupic/algorithms/ConnectionsKernels.hpp>
+#include <nupic/utils/Log.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define NTA_PERMANENCE_SIMD
+  #define NTA_TARGET(isa) __attribute__((target(isa)))
+  #include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define NTA_PERMANENCE_SIMD
+  #define NTA_TARGET(isa)
+  #include <immintrin.h>
+  #include <intrin.h>
+#endif
+
+using std::vector;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+
+namespace {
+
+void addPermanencesScalar_(Real32 *permanences, UInt32 begin, UInt32 count,
+                           const Real32 *deltas, Real32 delta,
+                           Real32 threshold, vector<UInt32> &crossings) {
+  for(UInt32 i = begin; i < count; i++) {
+    const Real32 before = permanences[i];
+    Real32 after = before + (deltas != nullptr ? deltas[i] : delta);
+    after = std::min(after, maxPermanence);
+    after = std::max(after, minPermanence);
+    permanences[i] = after;
+    if( (before >= threshold) != (after >= threshold) )
+      crossings.push_back( i );
+  }
+}
+
+void addQuantizedPermanencesScalar_(UInt16 *permanences, UInt32 begin,
+                                    UInt32 count,
+                                    const UInt16 *increments, UInt16 increment,
+                                    const UInt16 *decrements, UInt16 decrement,
+                                    UInt16 threshold, vector<UInt32> &crossings) {
+  for(UInt32 i = begin; i < count; i++) {
+    const UInt32 before = permanences[i];
+    const UInt32 up     = increments != nullptr ? increments[i] : increment;
+    const UInt32 down   = decrements != nullptr ? decrements[i] : decrement;
+    UInt32 after = std::min(before + up, (UInt32)quantizedPermanenceMax);
+    after = after > down ? after - down : 0u;
+    permanences[i] = (UInt16)after;
+    if( (before >= threshold) != (after >= threshold) )
+      crossings.push_back( i );
+  }
+}
+
+// Portable population count, for CPUs without the POPCNT instruction.
+inline UInt32 popcount_(UInt64 x) {
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  return (UInt32)((x * 0x0101010101010101ull) >> 56);
+}
+
+void addBitmapOverlapsScalar_(const UInt64 *masks, UInt32 numWords,
+                              const UInt64 *inputs, UInt32 numInputs,
+                              UInt32 begin, UInt32 end,
+                              UInt32 *counts, Size countsStride) {
+  for(UInt32 segment = begin; segment < end; segment++) {
+    const UInt64 *mask = masks + (Size)segment * numWords;
+    for(UInt32 i = 0u; i < numInputs; i++) {
+      const UInt64 *input = inputs + (Size)i * numWords;
+      UInt32 overlap = 0u;
+      for(UInt32 w = 0u; w < numWords; w++) {
+        overlap += popcount_( mask[w] & input[w] );
+      }
+      counts[i * countsStride + segment] += overlap;
+    }
+  }
+}
+
+#ifdef NTA_PERMANENCE_SIMD
+
+// Append the indices of the set bits of a movemask result.
+inline void appendMask_(int mask, UInt32 offset, vector<UInt32> &crossings) {
+  for(UInt32 bit = 0u; mask != 0; bit++, mask >>= 1) {
+    if( mask & 1 )
+      crossings.push_back( offset + bit );
+  }
+}
+
+// Append the indices of the set 16 bit lanes of a byte movemask result,
+// which has two bits per lane.
+inline void appendMask16_(UInt32 mask, UInt32 offset, vector<UInt32> &crossings) {
+  for(UInt32 lane = 0u; mask != 0u; lane++, mask >>= 2) {
+    if( mask & 1u )
+      crossings.push_back( offset + lane );
+  }
+}
+
+NTA_TARGET("sse2")
+void addPermanencesSSE2_(Real32 *permanences, UInt32 count,
+                         const Real32 *deltas, Real32 delta,
+                         Real32 threshold, vector<UInt32> &crossings) {
+  const __m128 lo  = _mm_set1_ps( minPermanence );
+  const __m128 hi  = _mm_set1_ps( maxPermanence );
+  const __m128 thr = _mm_set1_ps( threshold );
+  const __m128 all = _mm_set1_ps( delta );
+  UInt32 i = 0u;
+  for(; i + 4u <= count; i += 4u) {
+    const __m128 before = _mm_loadu_ps( permanences + i );
+    const __m128 d      = deltas != nullptr ? _mm_loadu_ps( deltas + i ) : all;
+    const __m128 after  = _mm_max_ps( _mm_min_ps( _mm_add_ps( before, d ), hi ), lo );
+    _mm_storeu_ps( permanences + i, after );
+    const int mask = _mm_movemask_ps( _mm_cmpge_ps( before, thr )) ^
+                     _mm_movemask_ps( _mm_cmpge_ps( after,  thr ));
+    if( mask != 0 )
+      appendMask_( mask, i, crossings );
+  }
+  addPermanencesScalar_( permanences, i, count, deltas, delta, threshold, crossings );
+}
+
+NTA_TARGET("avx2")
+void addPermanencesAVX2_(Real32 *permanences, UInt32 count,
+                         const Real32 *deltas, Real32 delta,
+                         Real32 threshold, vector<UInt32> &crossings) {
+  const __m256 lo  = _mm256_set1_ps( minPermanence );
+  const __m256 hi  = _mm256_set1_ps( maxPermanence );
+  const __m256 thr = _mm256_set1_ps( threshold );
+  const __m256 all = _mm256_set1_ps( delta );
+  UInt32 i = 0u;
+  for(; i + 8u <= count; i += 8u) {
+    const __m256 before = _mm256_loadu_ps( permanences + i );
+    const __m256 d      = deltas != nullptr ? _mm256_loadu_ps( deltas + i ) : all;
+    const __m256 after  = _mm256_max_ps( _mm256_min_ps( _mm256_add_ps( before, d ), hi ), lo );
+    _mm256_storeu_ps( permanences + i, after );
+    const int mask = _mm256_movemask_ps( _mm256_cmp_ps( before, thr, _CMP_GE_OQ )) ^
+                     _mm256_movemask_ps( _mm256_cmp_ps( after,  thr, _CMP_GE_OQ ));
+    if( mask != 0 )
+      appendMask_( mask, i, crossings );
+  }
+  addPermanencesScalar_( permanences, i, count, deltas, delta, threshold, crossings );
+}
+
+// The saturating unsigned 16 bit arithmetic does the clipping.  Unsigned
+// p >= threshold holds exactly when the saturating threshold - p is 0.
+NTA_TARGET("sse2")
+void addQuantizedPermanencesSSE2_(UInt16 *permanences, UInt32 count,
+                                  const UInt16 *increments, UInt16 increment,
+                                  const UInt16 *decrements, UInt16 decrement,
+                                  UInt16 threshold, vector<UInt32> &crossings) {
+  const __m128i zero    = _mm_setzero_si128();
+  const __m128i thr     = _mm_set1_epi16( (short)threshold );
+  const __m128i allUp   = _mm_set1_epi16( (short)increment );
+  const __m128i allDown = _mm_set1_epi16( (short)decrement );
+  UInt32 i = 0u;
+  for(; i + 8u <= count; i += 8u) {
+    const __m128i before = _mm_loadu_si128( (const __m128i *)(permanences + i) );
+    const __m128i up     = increments != nullptr
+                         ? _mm_loadu_si128( (const __m128i *)(increments + i) ) : allUp;
+    const __m128i down   = decrements != nullptr
+                         ? _mm_loadu_si128( (const __m128i *)(decrements + i) ) : allDown;
+    const __m128i after  = _mm_subs_epu16( _mm_adds_epu16( before, up ), down );
+    _mm_storeu_si128( (__m128i *)(permanences + i), after );
+    const __m128i changed = _mm_xor_si128(
+        _mm_cmpeq_epi16( _mm_subs_epu16( thr, before ), zero ),
+        _mm_cmpeq_epi16( _mm_subs_epu16( thr, after ),  zero ));
+    const int mask = _mm_movemask_epi8( changed );
+    if( mask != 0 )
+      appendMask16_( (UInt32)mask, i, crossings );
+  }
+  addQuantizedPermanencesScalar_( permanences, i, count, increments, increment,
+                                  decrements, decrement, threshold, crossings );
+}
+
+NTA_TARGET("avx2")
+void addQuantizedPermanencesAVX2_(UInt16 *permanences, UInt32 count,
+                                  const UInt16 *increments, UInt16 increment,
+                                  const UInt16 *decrements, UInt16 decrement,
+                                  UInt16 threshold, vector<UInt32> &crossings) {
+  const __m256i zero    = _mm256_setzero_si256();
+  const __m256i thr     = _mm256_set1_epi16( (short)threshold );
+  const __m256i allUp   = _mm256_set1_epi16( (short)increment );
+  const __m256i allDown = _mm256_set1_epi16( (short)decrement );
+  UInt32 i = 0u;
+  for(; i + 16u <= count; i += 16u) {
+    const __m256i before = _mm256_loadu_si256( (const __m256i *)(permanences + i) );
+    const __m256i up     = increments != nullptr
+                         ? _mm256_loadu_si256( (const __m256i *)(increments + i) ) : allUp;
+    const __m256i down   = decrements != nullptr
+                         ? _mm256_loadu_si256( (const __m256i *)(decrements + i) ) : allDown;
+    const __m256i after  = _mm256_subs_epu16( _mm256_adds_epu16( before, up ), down );
+    _mm256_storeu_si256( (__m256i *)(permanences + i), after );
+    const __m256i changed = _mm256_xor_si256(
+        _mm256_cmpeq_epi16( _mm256_subs_epu16( thr, before ), zero ),
+        _mm256_cmpeq_epi16( _mm256_subs_epu16( thr, after ),  zero ));
+    const int mask = _mm256_movemask_epi8( changed );
+    if( mask != 0 )
+      appendMask16_( (UInt32)mask, i, crossings );
+  }
+  addQuantizedPermanencesScalar_( permanences, i, count, increments, increment,
+                                  decrements, decrement, threshold, crossings );
+}
+
+NTA_TARGET("avx2,popcnt")
+void addBitmapOverlapsAVX2_(const UInt64 *masks, UInt32 numWords,
+                            const UInt64 *inputs, UInt32 numInputs,
+                            UInt32 begin, UInt32 end,
+                            UInt32 *counts, Size countsStride) {
+  for(UInt32 segment = begin; segment < end; segment++) {
+    const UInt64 *mask = masks + (Size)segment * numWords;
+    for(UInt32 i = 0u; i < numInputs; i++) {
+      const UInt64 *input = inputs + (Size)i * numWords;
+      UInt64 overlap = 0u;
+      for(UInt32 w = 0u; w < numWords; w++) {
+        const UInt64 bits = mask[w] & input[w];
+#if defined(__x86_64__) || defined(_M_X64)
+        overlap += (UInt64)_mm_popcnt_u64( bits );
+#else
+        overlap += (UInt64)(_mm_popcnt_u32( (UInt32)bits ) +
+                            _mm_popcnt_u32( (UInt32)(bits >> 32) ));
+#endif
+      }
+      counts[i * countsStride + segment] += (UInt32)overlap;
+    }
+  }
+}
+
+SimdLevel detectSimdLevel_() {
+#if defined(__GNUC__)
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "popcnt" ))
+    return SimdLevel::AVX2;
+  if( __builtin_cpu_supports( "sse2" ))
+    return SimdLevel::SSE2;
+  return SimdLevel::Scalar;
+#else
+  int info[4];
+  __cpuid( info, 0 );
+  const int numIds = info[0];
+  __cpuid( info, 1 );
+  const bool popcnt  = (info[2] & (1 << 23)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx     = (info[2] & (1 << 28)) != 0;
+  bool avx2 = false;
+  if( numIds >= 7 ) {
+    __cpuidex( info, 7, 0 );
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+  // The OS must also save the YMM registers on context switches.
+  if( popcnt && osxsave && avx && avx2 && (_xgetbv( 0 ) & 6u) == 6u )
+    return SimdLevel::AVX2;
+  return SimdLevel::SSE2; // Always available on x64.
+#endif
+}
+
+#else
+
+SimdLevel detectSimdLevel_() {
+  return SimdLevel::Scalar;
+}
+
+#endif // NTA_PERMANENCE_SIMD
+
+} // end anonymous namespace
+
+namespace nupic {
+namespace algorithms {
+namespace connections {
+
+SimdLevel simdLevel() {
+  static const SimdLevel level = detectSimdLevel_();
+  return level;
+}
+
+
+void addPermanences(Real32 *permanences, UInt32 count,
+                    const Real32 *deltas, Real32 delta,
+                    Real32 threshold, vector<UInt32> &crossings,
+                    SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+  switch( level ) {
+#ifdef NTA_PERMANENCE_SIMD
+    case SimdLevel::AVX2:
+      addPermanencesAVX2_( permanences, count, deltas, delta, threshold, crossings );
+      return;
+    case SimdLevel::SSE2:
+      addPermanencesSSE2_( permanences, count, deltas, delta, threshold, crossings );
+      return;
+#endif
+    default:
+      addPermanencesScalar_( permanences, 0u, count, deltas, delta, threshold, crossings );
+      return;
+  }
+}
+
+
+
+UInt16 quantizeThreshold(Real32 threshold) {
+  // Start from the nearest quantized permanence and step to the exact one.
+  UInt32 quantized = quantizePermanence( threshold );
+  while( quantized > 0u && dequantizePermanence( (UInt16)(quantized - 1u) ) >= threshold )
+    quantized--;
+  while( quantized < quantizedPermanenceMax && dequantizePermanence( (UInt16)quantized ) < threshold )
+    quantized++;
+  return (UInt16)quantized;
+}
+
+
+void addQuantizedPermanences(UInt16 *permanences, UInt32 count,
+                             const UInt16 *increments, UInt16 increment,
+                             const UInt16 *decrements, UInt16 decrement,
+                             UInt16 threshold, vector<UInt32> &crossings,
+                             SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+  switch( level ) {
+#ifdef NTA_PERMANENCE_SIMD
+    case SimdLevel::AVX2:
+      addQuantizedPermanencesAVX2_( permanences, count, increments, increment,
+                                    decrements, decrement, threshold, crossings );
+      return;
+    case SimdLevel::SSE2:
+      addQuantizedPermanencesSSE2_( permanences, count, increments, increment,
+                                    decrements, decrement, threshold, crossings );
+      return;
+#endif
+    default:
+      addQuantizedPermanencesScalar_( permanences, 0u, count, increments, increment,
+                                      decrements, decrement, threshold, crossings );
+      return;
+  }
+}
+
+
+void addBitmapOverlaps(const UInt64 *masks, UInt32 numWords,
+                       const UInt64 *input, UInt32 begin, UInt32 end,
+                       UInt32 *counts, SimdLevel level) {
+  addBitmapOverlapsBatch( masks, numWords, input, 1u, begin, end, counts, 0u, level );
+}
+
+
+void addBitmapOverlapsBatch(const UInt64 *masks, UInt32 numWords,
+                            const UInt64 *inputs, UInt32 numInputs,
+                            UInt32 begin, UInt32 end,
+                            UInt32 *counts, Size countsStride,
+                            SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+#ifdef NTA_PERMANENCE_SIMD
+  if( level == SimdLevel::AVX2 ) {
+    addBitmapOverlapsAVX2_( masks, numWords, inputs, numInputs, begin, end,
+                            counts, countsStride );
+    return;
+  }
+#endif
+  addBitmapOverlapsScalar_( masks, numWords, inputs, numInputs, begin, end,
+                            counts, countsStride );
+}
+
+} // end namespace connections
+} // end namespace algorithms
+} // end namespace nupic
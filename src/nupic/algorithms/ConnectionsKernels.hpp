@@ -0,0 +1,179 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the vectorized kernels used by Connections
+ */
+
+#ifndef NTA_CONNECTIONS_KERNELS_HPP
+#define NTA_CONNECTIONS_KERNELS_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+namespace algorithms {
+namespace connections {
+
+/**
+ * Instruction sets which the kernels can use.  Higher levels include the
+ * lower ones.  AVX2 also requires the POPCNT instruction.
+ */
+enum class SimdLevel { Scalar = 0, SSE2 = 1, AVX2 = 2 };
+
+/**
+ * The best instruction set which both this build and the CPU support.  It is
+ * detected once, on the first call.
+ */
+SimdLevel simdLevel();
+
+/**
+ * Add a delta to every permanence of a segment, clip the results to
+ * [minPermanence, maxPermanence], and find the permanences which crossed the
+ * connected threshold, all in one pass.
+ *
+ * Every instruction set gives exactly the same permanences as the scalar
+ * loop `p = max(min(p + delta, maxPermanence), minPermanence)`.
+ *
+ * @param permanences Packed permanences, updated in place.
+ * @param count       Number of permanences.
+ * @param deltas      Delta for each permanence, or nullptr to add `delta` to
+ *                    all of them.
+ * @param delta       Delta for all permanences, when deltas is nullptr.
+ * @param threshold   Connected threshold: permanences >= threshold are
+ *                    connected.
+ * @param crossings   Output: the indices of the permanences whose connected
+ *                    state changed are appended, in increasing order.
+ * @param level       Instruction set to use, at most simdLevel().
+ */
+void addPermanences(Real32 *permanences, UInt32 count,
+                    const Real32 *deltas, Real32 delta,
+                    Real32 threshold, std::vector<UInt32> &crossings,
+                    SimdLevel level = simdLevel());
+
+/**
+ * Quantized permanences are 16 bit fixed point numbers, with 0 standing for
+ * a permanence of 0 and quantizedPermanenceMax for a permanence of 1.
+ */
+const UInt16 quantizedPermanenceMax = 65535u;
+
+/**
+ * The permanence which a quantized permanence stands for.  Increasing
+ * quantized permanences give increasing permanences.
+ */
+inline Real32 dequantizePermanence(UInt16 quantized) {
+  return (Real32)quantized / (Real32)quantizedPermanenceMax;
+}
+
+/**
+ * The nearest quantized permanence, after clipping to [0, 1].  Also used for
+ * the size of a permanence step.
+ */
+inline UInt16 quantizePermanence(Real32 permanence) {
+  const Real32 clipped = std::min(std::max(permanence, 0.0f), 1.0f);
+  return (UInt16)(clipped * (Real32)quantizedPermanenceMax + 0.5f);
+}
+
+/**
+ * The smallest quantized permanence `q` with
+ * `dequantizePermanence(q) >= threshold`, or quantizedPermanenceMax if there
+ * is none.  Comparing quantized permanences against it gives exactly the same
+ * result as comparing the dequantized permanences against the threshold.
+ */
+UInt16 quantizeThreshold(Real32 threshold);
+
+/**
+ * Quantized version of addPermanences: add an increment and subtract a
+ * decrement from every quantized permanence of a segment, saturating at 0
+ * and quantizedPermanenceMax, and find the permanences which crossed the
+ * connected threshold, all in one pass.
+ *
+ * Every instruction set gives exactly the same permanences as the scalar
+ * loop `p = max(min(p + increment, quantizedPermanenceMax) - decrement, 0)`.
+ * Usually only one of the increment and decrement of a permanence is not 0.
+ *
+ * @param permanences Packed quantized permanences, updated in place.
+ * @param count       Number of permanences.
+ * @param increments  Increment for each permanence, or nullptr to add
+ *                    `increment` to all of them.
+ * @param decrements  Decrement for each permanence, or nullptr to subtract
+ *                    `decrement` from all of them.
+ * @param threshold   Connected threshold: permanences >= threshold are
+ *                    connected, see quantizeThreshold.
+ * @param crossings   Output: the indices of the permanences whose connected
+ *                    state changed are appended, in increasing order.
+ * @param level       Instruction set to use, at most simdLevel().
+ */
+void addQuantizedPermanences(UInt16 *permanences, UInt32 count,
+                             const UInt16 *increments, UInt16 increment,
+                             const UInt16 *decrements, UInt16 decrement,
+                             UInt16 threshold, std::vector<UInt32> &crossings,
+                             SimdLevel level = simdLevel());
+
+/**
+ * Count the overlap of segment bitmasks with an input bitmap.
+ *
+ * For every segment in [begin, end), adds the number of bits which the
+ * segment's mask has in common with the input to counts[segment].
+ *
+ * @param masks    Bitmasks of all segments, numWords words per segment.
+ *                 The mask of segment `s` starts at masks[s * numWords].
+ * @param numWords Number of 64 bit words per mask and in the input.
+ * @param input    Input bitmap.
+ * @param begin    First segment.
+ * @param end      One past the last segment.
+ * @param counts   Output: counts per segment, incremented.
+ * @param level    Instruction set to use, at most simdLevel().
+ */
+void addBitmapOverlaps(const UInt64 *masks, UInt32 numWords,
+                       const UInt64 *input, UInt32 begin, UInt32 end,
+                       UInt32 *counts, SimdLevel level = simdLevel());
+
+/**
+ * Count the overlap of segment bitmasks with several input bitmaps.
+ *
+ * Each segment's mask is read once for all of the inputs, so the masks are
+ * streamed from memory once per batch instead of once per input.  For every
+ * segment in [begin, end) and input `i`, adds the overlap to
+ * counts[i * countsStride + segment].
+ *
+ * @param inputs       Input bitmaps, numWords words each, one after another.
+ * @param numInputs    Number of input bitmaps.
+ * @param countsStride Distance between the counts of consecutive inputs.
+ *
+ * The other parameters are as for addBitmapOverlaps.
+ */
+void addBitmapOverlapsBatch(const UInt64 *masks, UInt32 numWords,
+                            const UInt64 *inputs, UInt32 numInputs,
+                            UInt32 begin, UInt32 end,
+                            UInt32 *counts, Size countsStride,
+                            SimdLevel level = simdLevel());
+
+} // end namespace connections
+
+} // end namespace algorithms
+
+} // end namespace nupic
+
+#endif // NTA_CONNECTIONS_KERNELS_HPP
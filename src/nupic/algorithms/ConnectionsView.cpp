@@ -0,0 +1,266 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the ConnectionsView class
+ */
+
+#include <algorithm>
+#include <cmath> // abs
+#include <cstring>
+#include <numeric>
+
+#include <nupic/algorithms/ConnectionsBinary.hpp>
+#include <nupic/algorithms/ConnectionsView.hpp>
+#include <nupic/math/Math.hpp> // nupic::Epsilon
+
+using std::vector;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+
+namespace {
+
+/**
+ * Reads the header fields and finds the arrays of a mapped file, checking
+ * that they are within it.
+ */
+class Cursor {
+public:
+  Cursor(const MappedFile &file) : file_(file) {}
+
+  template<typename T> T value() {
+    T value;
+    NTA_CHECK( position_ + sizeof(T) <= file_.size() )
+      << "ConnectionsView: '" << file_.path() << "' is truncated.";
+    std::memcpy( &value, file_.data() + position_, sizeof(T) );
+    position_ += sizeof(T);
+    return value;
+  }
+
+  template<typename T> const T *array(Size count) {
+    const Size bytes = count * sizeof(T);
+    NTA_CHECK( position_ + bytes <= file_.size() )
+      << "ConnectionsView: '" << file_.path() << "' is truncated.";
+    const T *array = reinterpret_cast<const T *>( file_.data() + position_ );
+    position_ += bytes + binary::padding( bytes );
+    return array;
+  }
+
+  Size position() const { return position_; }
+
+private:
+  const MappedFile &file_;
+  Size position_ = 0u;
+};
+
+/**
+ * Whether an offsets array starts at zero, never decreases and ends at the
+ * given size.
+ */
+bool validOffsets(const UInt32 *offsets, const Size count, const UInt32 end) {
+  if( offsets[0] != 0u || offsets[count - 1u] != end )
+    return false;
+  for( Size i = 1u; i < count; i++ ) {
+    if( offsets[i] < offsets[i - 1u] )
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Whether every segment in a presynaptic map is within the segment count.
+ */
+bool validSegments(const Segment *segments, const Size count, const UInt32 numSegments) {
+  return std::all_of( segments, segments + count,
+                      [numSegments](const Segment segment) { return segment < numSegments; });
+}
+
+} // end anonymous namespace
+
+
+ConnectionsView::ConnectionsView(const std::string &path, const bool verify)
+  : file_( new MappedFile( path ))
+{
+  NTA_CHECK( binary::isLittleEndian() )
+    << "ConnectionsView: the host must be little-endian.";
+  Cursor cursor( *file_ );
+  NTA_CHECK( file_->size() >= binary::headerSize &&
+             std::equal( binary::magic, binary::magic + sizeof(binary::magic),
+                         file_->data() ))
+    << "ConnectionsView: '" << path << "' is not in the binary format.";
+  cursor.array<char>( sizeof(binary::magic) );
+  const UInt32 version = cursor.value<UInt32>();
+  NTA_CHECK( version == Connections::BINARY_VERSION )
+    << "ConnectionsView: unsupported binary version " << version
+    << ", save the connections again.";
+  numCells_            = cursor.value<UInt32>();
+  connectedThreshold_  = cursor.value<Permanence>();
+  numPresynapticCells_ = cursor.value<UInt32>();
+  const UInt64 segmentCount = cursor.value<UInt64>();
+  const UInt64 synapseCount = cursor.value<UInt64>();
+  const UInt64 hash         = cursor.value<UInt64>();
+  const UInt32 flags        = cursor.value<UInt32>();
+  cursor.value<UInt32>(); // Padding.
+  NTA_CHECK( cursor.position() == binary::headerSize );
+  NTA_CHECK( flags & binary::presynapticIndexFlag )
+    << "ConnectionsView: '" << path << "' has no presynaptic maps, save it "
+    << "with Connections::saveBinary(out, true).";
+  NTA_CHECK( segmentCount < std::numeric_limits<Segment>::max() &&
+             synapseCount < std::numeric_limits<Synapse>::max() )
+    << "ConnectionsView: corrupt header in '" << path << "'.";
+  numSegments_ = (UInt32)segmentCount;
+  numSynapses_ = (UInt32)synapseCount;
+
+  cellSegmentOffsets_    = cursor.array<UInt32>( (Size)numCells_ + 1u );
+  segmentSynapseOffsets_ = cursor.array<UInt32>( (Size)numSegments_ + 1u );
+  presynapticCells_      = cursor.array<CellIdx>( numSynapses_ );
+  permanences_           = cursor.array<Permanence>( numSynapses_ );
+  connectedOffsets_      = cursor.array<UInt32>( (Size)numPresynapticCells_ + 1u );
+  connectedSegments_     = cursor.array<Segment>( connectedOffsets_[numPresynapticCells_] );
+  potentialOffsets_      = cursor.array<UInt32>( (Size)numPresynapticCells_ + 1u );
+  potentialSegments_     = cursor.array<Segment>( potentialOffsets_[numPresynapticCells_] );
+  NTA_CHECK( cursor.position() == file_->size() &&
+             connectedOffsets_[numPresynapticCells_] +
+             potentialOffsets_[numPresynapticCells_] == numSynapses_ )
+    << "ConnectionsView: inconsistent sizes in '" << path << "'.";
+
+  // The arrays index each other, so check their structure on every open.
+  // This is linear in the file size, but unlike the checksum it only reads
+  // the offsets and the presynaptic maps.
+  const Size numMapOffsets = (Size)numPresynapticCells_ + 1u;
+  NTA_CHECK( validOffsets( cellSegmentOffsets_, (Size)numCells_ + 1u, numSegments_ ) &&
+             validOffsets( segmentSynapseOffsets_, (Size)numSegments_ + 1u, numSynapses_ ) &&
+             validOffsets( connectedOffsets_, numMapOffsets,
+                           connectedOffsets_[numPresynapticCells_] ) &&
+             validOffsets( potentialOffsets_, numMapOffsets,
+                           potentialOffsets_[numPresynapticCells_] ) &&
+             validSegments( connectedSegments_, connectedOffsets_[numPresynapticCells_],
+                            numSegments_ ) &&
+             validSegments( potentialSegments_, potentialOffsets_[numPresynapticCells_],
+                            numSegments_ ))
+    << "ConnectionsView: inconsistent arrays in '" << path << "'.";
+
+  if( verify ) {
+    binary::Checksum checksum;
+    binary::addHeader( checksum, version, numCells_, connectedThreshold_,
+                       numPresynapticCells_, segmentCount, synapseCount, flags );
+    checksum.add( cellSegmentOffsets_,    (Size)numCells_ + 1u );
+    checksum.add( segmentSynapseOffsets_, (Size)numSegments_ + 1u );
+    checksum.add( presynapticCells_,      numSynapses_ );
+    checksum.add( permanences_,           numSynapses_ );
+    checksum.add( connectedOffsets_,      (Size)numPresynapticCells_ + 1u );
+    checksum.add( connectedSegments_,     connectedOffsets_[numPresynapticCells_] );
+    checksum.add( potentialOffsets_,      (Size)numPresynapticCells_ + 1u );
+    checksum.add( potentialSegments_,     potentialOffsets_[numPresynapticCells_] );
+    NTA_CHECK( checksum.value() == hash )
+      << "ConnectionsView: checksum mismatch in '" << path << "'.";
+  }
+}
+
+
+UInt ConnectionsView::numSegments(const CellIdx cell) const {
+  NTA_ASSERT( cell < numCells_ );
+  return cellSegmentOffsets_[cell + 1u] - cellSegmentOffsets_[cell];
+}
+
+
+UInt ConnectionsView::numSynapses(const Segment segment) const {
+  NTA_ASSERT( segment < numSegments_ );
+  return segmentSynapseOffsets_[segment + 1u] - segmentSynapseOffsets_[segment];
+}
+
+
+vector<Segment> ConnectionsView::segmentsForCell(const CellIdx cell) const {
+  vector<Segment> segments( numSegments( cell ));
+  std::iota( segments.begin(), segments.end(), cellSegmentOffsets_[cell] );
+  return segments;
+}
+
+
+CellIdx ConnectionsView::cellForSegment(const Segment segment) const {
+  NTA_ASSERT( segment < numSegments_ );
+  // The last cell whose first segment is at or before this one.
+  const UInt32 *cell = std::upper_bound( cellSegmentOffsets_,
+                                         cellSegmentOffsets_ + numCells_ + 1u,
+                                         segment );
+  return (CellIdx)(cell - cellSegmentOffsets_) - 1u;
+}
+
+
+const CellIdx *ConnectionsView::presynapticCellsForSegment(const Segment segment) const {
+  NTA_ASSERT( segment < numSegments_ );
+  return presynapticCells_ + segmentSynapseOffsets_[segment];
+}
+
+
+const Permanence *ConnectionsView::permanencesForSegment(const Segment segment) const {
+  NTA_ASSERT( segment < numSegments_ );
+  return permanences_ + segmentSynapseOffsets_[segment];
+}
+
+
+void ConnectionsView::addActivity_(UInt32 *numActiveSynapsesForSegment,
+                                   const vector<CellIdx> &activePresynapticCells,
+                                   const UInt32 *offsets,
+                                   const Segment *segments) const {
+  for( const CellIdx cell : activePresynapticCells ) {
+    if( cell >= numPresynapticCells_ )
+      continue;
+    const UInt32 end = offsets[cell + 1u];
+    for( UInt32 i = offsets[cell]; i < end; i++ ) {
+      ++numActiveSynapsesForSegment[segments[i]];
+    }
+  }
+}
+
+
+void ConnectionsView::computeActivity(
+    vector<UInt32> &numActiveConnectedSynapsesForSegment,
+    vector<UInt32> &numActivePotentialSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells,
+    const Permanence connectedPermanence) const
+{
+  NTA_ASSERT( numActiveConnectedSynapsesForSegment.size() == numSegments_ );
+  NTA_ASSERT( numActivePotentialSynapsesForSegment.size() == numSegments_ );
+  NTA_CHECK( std::abs(connectedPermanence - connectedThreshold_) <= nupic::Epsilon );
+
+  // Iterate through all connected synapses.
+  addActivity_( numActiveConnectedSynapsesForSegment.data(),
+                activePresynapticCells, connectedOffsets_, connectedSegments_ );
+
+  // Iterate through all potential synapses.
+  std::copy( numActiveConnectedSynapsesForSegment.begin(),
+             numActiveConnectedSynapsesForSegment.end(),
+             numActivePotentialSynapsesForSegment.begin() );
+  addActivity_( numActivePotentialSynapsesForSegment.data(),
+                activePresynapticCells, potentialOffsets_, potentialSegments_ );
+}
+
+
+void ConnectionsView::computeActivity(
+    vector<UInt32> &numActiveConnectedSynapsesForSegment,
+    const vector<CellIdx> &activePresynapticCells) const
+{
+  NTA_ASSERT( numActiveConnectedSynapsesForSegment.size() == numSegments_ );
+  addActivity_( numActiveConnectedSynapsesForSegment.data(),
+                activePresynapticCells, connectedOffsets_, connectedSegments_ );
+}
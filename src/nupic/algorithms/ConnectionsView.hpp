@@ -0,0 +1,151 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the ConnectionsView class
+ */
+
+#ifndef NTA_CONNECTIONS_VIEW_HPP
+#define NTA_CONNECTIONS_VIEW_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nupic/algorithms/Connections.hpp>
+#include <nupic/os/MappedFile.hpp>
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+namespace algorithms {
+namespace connections {
+
+/**
+ * Frozen, read-only view of Connections, backed by a memory mapped file in
+ * the binary format of Connections::saveBinary(), saved with the presynaptic
+ * index.
+ *
+ * @b Description
+ * computeActivity and the getters run directly over the mapped arrays.
+ * Opening a view copies nothing, so it takes milliseconds.  Several
+ * processes which view the same file share one physical copy of it through
+ * the page cache.  This is meant for inference-only replicas of a trained
+ * model.
+ *
+ * Segments are numbered as in a Connections loaded from the same file, so the
+ * activity vectors of both can be used interchangeably.
+ *
+ * The arrays are used in place, so the host must be little-endian.  When
+ * the file is opened the header, the array sizes, the offsets and the
+ * segments of the presynaptic maps are checked.  Pass verify = true to also
+ * check the checksum, which reads the whole file.
+ */
+class ConnectionsView {
+public:
+  /**
+   * Map a file written by Connections::saveBinary(out, true).
+   *
+   * @param path   The file.
+   * @param verify Also check the checksum of the arrays.
+   */
+  explicit ConnectionsView(const std::string &path, bool verify = false);
+
+  CellIdx numCells() const { return numCells_; }
+  UInt numSegments() const { return numSegments_; }
+  UInt numSegments(CellIdx cell) const;
+  UInt numSynapses() const { return numSynapses_; }
+  UInt numSynapses(Segment segment) const;
+
+  /**
+   * The length of the activity vectors, as for
+   * Connections::segmentFlatListLength().
+   */
+  UInt32 segmentFlatListLength() const { return numSegments_; }
+
+  /**
+   * The connected threshold which the file was saved with.
+   */
+  Permanence getConnectedThreshold() const { return connectedThreshold_; }
+
+  /**
+   * Segments of a cell.  They are numbered consecutively.
+   */
+  std::vector<Segment> segmentsForCell(CellIdx cell) const;
+
+  CellIdx cellForSegment(Segment segment) const;
+
+  /**
+   * Presynaptic cells and permanences of the synapses of a segment,
+   * numSynapses(segment) of each.
+   */
+  const CellIdx *presynapticCellsForSegment(Segment segment) const;
+  const Permanence *permanencesForSegment(Segment segment) const;
+
+  /**
+   * Compute the segment excitations for a vector of active presynaptic
+   * cells, as Connections::computeActivity does.
+   *
+   * The output vectors aren't grown or cleared. They must be
+   * preinitialized with the length returned by segmentFlatListLength().
+   */
+  void
+  computeActivity(std::vector<UInt32> &numActiveConnectedSynapsesForSegment,
+                  std::vector<UInt32> &numActivePotentialSynapsesForSegment,
+                  const std::vector<CellIdx> &activePresynapticCells,
+                  Permanence connectedPermanence) const;
+
+  void
+  computeActivity(std::vector<UInt32> &numActiveConnectedSynapsesForSegment,
+                  const std::vector<CellIdx> &activePresynapticCells) const;
+
+private:
+  /**
+   * Add one to the counter of every segment in the presynaptic lists of the
+   * active cells.
+   */
+  void addActivity_(UInt32 *numActiveSynapsesForSegment,
+                    const std::vector<CellIdx> &activePresynapticCells,
+                    const UInt32 *offsets, const Segment *segments) const;
+
+  std::unique_ptr<MappedFile> file_;
+  CellIdx    numCells_;
+  UInt32     numSegments_;
+  UInt32     numSynapses_;
+  UInt32     numPresynapticCells_;
+  Permanence connectedThreshold_;
+
+  // Arrays in the mapped file
+  const UInt32     *cellSegmentOffsets_;
+  const UInt32     *segmentSynapseOffsets_;
+  const CellIdx    *presynapticCells_;
+  const Permanence *permanences_;
+  const UInt32     *connectedOffsets_;
+  const Segment    *connectedSegments_;
+  const UInt32     *potentialOffsets_;
+  const Segment    *potentialSegments_;
+};
+
+} // end namespace connections
+} // end namespace algorithms
+} // end namespace nupic
+
+#endif // NTA_CONNECTIONS_VIEW_HPP
@@ -21,7 +21,6 @@
  */
 
 #include <cmath> //exp
-#include <deque>
 #include <iostream>
 #include <limits>
 #include <map>
@@ -34,6 +33,7 @@
 
 
 #include <nupic/algorithms/SDRClassifier.hpp>
+#include <nupic/algorithms/SDRClassifierKernels.hpp>
 #include <nupic/utils/Log.hpp>
 
 
@@ -43,17 +43,58 @@ namespace sdr_classifier {
 
 using namespace std;
 
-/**
- * get(x,y) accessor interface for Matrix; handles sparse (missing) values
- * @return return value stored at map[row][col], or defaultVal if such field does not exist
- **/
-Real64 get_(const Matrix& m, const UInt row, const UInt col, const Real64 defaultVal=0.0) {
-  try {
-    return m.at(row).at(col);
-  } catch(std::exception& ex ) {
-    UNUSED(ex);
-    return defaultVal;
+void PatternHistory::reset(const UInt capacity) {
+  NTA_CHECK(capacity > 0u);
+  capacity_ = capacity;
+  size_ = 0u;
+  head_ = 0u;
+  recordNums_.assign(capacity_, 0u);
+  sizes_.assign(capacity_, 0u);
+  bits_.assign((size_t)capacity_ * slotSize_, 0u);
+}
+
+
+void PatternHistory::push(const UInt recordNum, const UInt *pattern,
+                          const UInt patternSize) {
+  NTA_ASSERT(capacity_ > 0u);
+  if (patternSize > slotSize_) {
+    // Re-layout with larger slots.
+    const UInt slotSize = max(patternSize, 2u * slotSize_);
+    vector<UInt> bits((size_t)capacity_ * slotSize, 0u);
+    for (UInt slot = 0; slot < capacity_; slot++) {
+      copy_n(bits_.begin() + (size_t)slot * slotSize_, sizes_[slot],
+             bits.begin() + (size_t)slot * slotSize);
+    }
+    bits_.swap(bits);
+    slotSize_ = slotSize;
   }
+
+  UInt slot;
+  if (size_ < capacity_) {
+    slot = (head_ + size_) % capacity_;
+    size_++;
+  } else {
+    slot = head_;
+    head_ = (head_ + 1u) % capacity_;
+  }
+  recordNums_[slot] = recordNum;
+  sizes_[slot] = patternSize;
+  copy_n(pattern, patternSize, bits_.begin() + (size_t)slot * slotSize_);
+}
+
+
+bool PatternHistory::operator==(const PatternHistory &other) const {
+  if (size_ != other.size_) {
+    return false;
+  }
+  for (UInt i = 0; i < size_; i++) {
+    if (recordNum(i) != other.recordNum(i) ||
+        patternSize(i) != other.patternSize(i) ||
+        !equal(pattern(i), pattern(i) + patternSize(i), other.pattern(i))) {
+      return false;
+    }
+  }
+  return true;
 }
 
 
@@ -75,6 +116,7 @@ void SDRClassifier::initialize(const vector<UInt> &steps, Real64 alpha,
    } else {
      maxSteps_ = 1;
    }
+   history_.reset(maxSteps_);
 
 
   // TODO: insert maxBucketIdx / maxInputIdx hint as parameter?
@@ -86,9 +128,9 @@ void SDRClassifier::initialize(const vector<UInt> &steps, Real64 alpha,
   // to reallocate this matrix only a few times, even never if we use
   // lower bounds
   for (const auto &step : steps_) {
-	  Matrix m;
-    weightMatrix_.emplace(step, m);
+    weightMatrix_.emplace(step, Matrix());
   }
+  growWeights_();
 }
 
 SDRClassifier::SDRClassifier(const vector<UInt> &steps, Real64 alpha, Real64 actValueAlpha,
@@ -102,20 +144,15 @@ void SDRClassifier::compute(UInt recordNum, const vector<UInt> &patternNZ,
                             bool learn, bool infer, ClassifierResult &result) {
   // ensures that recordNum increases monotonically
   UInt lastRecordNum = -1;
-  if (recordNumHistory_.size() > 0) {
-    lastRecordNum = recordNumHistory_[recordNumHistory_.size() - 1];
+  if (history_.size() > 0) {
+    lastRecordNum = history_.recordNum(history_.size() - 1);
     if (recordNum < lastRecordNum)
       NTA_THROW << "the record number has to increase monotonically";
   }
 
   // update pattern history if this is a new record
-  if (recordNumHistory_.size() == 0 || recordNum > lastRecordNum) {
-    patternNZHistory_.emplace_back(patternNZ.begin(), patternNZ.end());
-    recordNumHistory_.push_back(recordNum);
-    if (patternNZHistory_.size() > maxSteps_) {
-      patternNZHistory_.pop_front();
-      recordNumHistory_.pop_front();
-    }
+  if (history_.size() == 0 || recordNum > lastRecordNum) {
+    history_.push(recordNum, patternNZ.data(), (UInt)patternNZ.size());
   }
 
   // if input pattern has greater index than previously seen, update
@@ -126,6 +163,7 @@ void SDRClassifier::compute(UInt recordNum, const vector<UInt> &patternNZ,
       maxInputIdx_ = maxInputIdx;
     }
   }
+  growWeights_();
 
   // if in inference mode, compute likelihood and update return value
   if (infer) {
@@ -148,6 +186,7 @@ void SDRClassifier::compute(UInt recordNum, const vector<UInt> &patternNZ,
         actualValues_.push_back(0.0);
         actualValuesSet_.push_back(false);
       }
+      growWeights_();
       if (!actualValuesSet_[bucketIdx] || category) {
         actualValues_[bucketIdx] = actValue;
         actualValuesSet_[bucketIdx] = true;
@@ -158,25 +197,44 @@ void SDRClassifier::compute(UInt recordNum, const vector<UInt> &patternNZ,
       }
     }
 
-    // compute errors and update weights
-    auto patternIteration = patternNZHistory_.begin();
-    for (auto learnRecord = recordNumHistory_.begin();
-         learnRecord != recordNumHistory_.end();
-         learnRecord++, patternIteration++) {
-      const vector<UInt> learnPatternNZ = *patternIteration;
-      const UInt nSteps = recordNum - *learnRecord;
-
-      // update weights
-      if (binary_search(steps_.begin(), steps_.end(), nSteps)) {
-        const vector<Real64> error = calculateError_(bucketIdxList, learnPatternNZ, nSteps);
-        Matrix& w = weightMatrix_.at(nSteps);
-	NTA_ASSERT(alpha_ > 0.0);
-        for (const auto& bit : learnPatternNZ) {
-          for(UInt i = 0; i < error.size(); i++) {
-            const auto val = get_(w, bit, i) + alpha_ * error[i];
-	    if(val == 0) continue;
-	    w[bit][i] = val;
-          }
+    learn_(recordNum, bucketIdxList);
+  }
+}
+
+void SDRClassifier::learn_(const UInt recordNum,
+                           const vector<UInt> &bucketIdxList) {
+  NTA_ASSERT(alpha_ > 0.0);
+  // The target distribution is the same for every step.
+  const UInt numBuckets = maxBucketIdx_ + 1;
+  target_.assign(numBuckets, 0.0);
+  const Real64 numCategories = (Real64)bucketIdxList.size();
+  for (size_t i = 0; i < bucketIdxList.size(); i++)
+    target_[bucketIdxList[i]] = 1.0 / numCategories;
+
+  // compute errors and update weights, in one sweep over the history
+  for (UInt h = 0; h < history_.size(); h++) {
+    const UInt nSteps = recordNum - history_.recordNum(h);
+    if (!binary_search(steps_.begin(), steps_.end(), nSteps)) {
+      continue;
+    }
+    const UInt *learnPatternNZ = history_.pattern(h);
+    const UInt patternSize = history_.patternSize(h);
+
+    if (singlePrecision_) {
+      calculateError32_(learnPatternNZ, patternSize, nSteps, error32_);
+      Matrix32& w = weightMatrix32_.at(nSteps);
+      for (UInt b = 0; b < patternSize; b++) {
+        addScaledRow(w.row(learnPatternNZ[b]), error32_.data(),
+                     (Real32)alpha_, numBuckets);
+      }
+    } else {
+      calculateError_(learnPatternNZ, patternSize, nSteps, error_);
+      Matrix& w = weightMatrix_.at(nSteps);
+      // Dense rank-1 update of the active rows.
+      for (UInt b = 0; b < patternSize; b++) {
+        Real64 *row = w.row(learnPatternNZ[b]);
+        for(UInt i = 0; i < numBuckets; i++) {
+          row[i] += alpha_ * error_[i];
         }
       }
     }
@@ -213,43 +271,81 @@ void SDRClassifier::infer_(const vector<UInt> &patternNZ,
     }
   }
 
+  const UInt numBuckets = maxBucketIdx_ + 1;
   for (auto nSteps = steps_.begin(); nSteps != steps_.end(); ++nSteps) {
-    vector<Real64>* likelihoods = result.createVector(*nSteps, maxBucketIdx_ + 1, 0.0);
+    vector<Real64>* likelihoods = result.createVector(*nSteps, numBuckets, 0.0);
+    if (singlePrecision_) {
+      predict32_(patternNZ.data(), (UInt)patternNZ.size(), *nSteps, error32_);
+      copy(error32_.begin(), error32_.end(), likelihoods->begin());
+      continue;
+    }
+    Real64 *sum = likelihoods->data();
+    const Matrix& w = weightMatrix_.at(*nSteps);
     for (const auto& bit : patternNZ) {
-      const Matrix& w = weightMatrix_.at(*nSteps);
-      for(UInt i =0; i< (UInt)likelihoods->size(); i++) {
-        likelihoods->at(i) += get_(w, bit, i);
+      const Real64 *row = w.row(bit);
+      for(UInt i = 0; i < numBuckets; i++) {
+        sum[i] += row[i];
       }
     }
     softmax_(likelihoods->begin(), likelihoods->end());
   }
 }
 
-vector<Real64> SDRClassifier::calculateError_(const vector<UInt> &bucketIdxList,
-                                              const vector<UInt> patternNZ,
-                                              UInt step) {
+void SDRClassifier::calculateError_(const UInt *patternNZ,
+                                    const UInt patternSize, UInt step,
+                                    vector<Real64> &error) {
   // compute predicted likelihoods
-  vector<Real64> likelihoods(maxBucketIdx_ + 1, 0);
-
-  for (const auto& bit : patternNZ) {
-    const Matrix& w = weightMatrix_.at(step); //row
-    for(UInt i=0; i< (UInt)likelihoods.size(); i++) {
-      likelihoods[i] += get_(w, bit, i);
+  const UInt numBuckets = maxBucketIdx_ + 1;
+  error.assign(numBuckets, 0.0);
+
+  const Matrix& w = weightMatrix_.at(step);
+  for (UInt b = 0; b < patternSize; b++) {
+    const Real64 *row = w.row(patternNZ[b]);
+    for(UInt i = 0; i < numBuckets; i++) {
+      error[i] += row[i];
     }
   }
-  softmax_(likelihoods.begin(), likelihoods.end());
+  softmax_(error.begin(), error.end());
+
+  NTA_ASSERT(error.size() == target_.size());
+  for(UInt i = 0; i < numBuckets; i++) {
+    error[i] = target_[i] - error[i];
+  }
+}
+
+
+void SDRClassifier::predict32_(const UInt *patternNZ, const UInt patternSize,
+                               UInt step, vector<Real32> &likelihoods) {
+  const Matrix32& w = weightMatrix32_.at(step);
+  rows32_.resize(patternSize);
+  for (UInt b = 0; b < patternSize; b++) {
+    rows32_[b] = w.row(patternNZ[b]);
+  }
+  likelihoods.resize(maxBucketIdx_ + 1);
+  sumRows(rows32_.data(), patternSize, (UInt32)likelihoods.size(),
+          likelihoods.data());
+  softmax(likelihoods.data(), (UInt32)likelihoods.size());
+}
 
-  // compute target likelihoods
-  vector<Real64> targetDistribution(maxBucketIdx_ + 1, 0.0);
-  const Real64 numCategories = (Real64)bucketIdxList.size();
-  for (size_t i = 0; i < bucketIdxList.size(); i++)
-    targetDistribution[bucketIdxList[i]] = 1.0 / numCategories;
 
-  NTA_ASSERT(likelihoods.size() == targetDistribution.size());
-  for(UInt i = 0; i < likelihoods.size(); i++) {
-    likelihoods[i] = targetDistribution[i] - likelihoods[i];
+void SDRClassifier::calculateError32_(const UInt *patternNZ,
+                                      const UInt patternSize, UInt step,
+                                      vector<Real32> &error) {
+  predict32_(patternNZ, patternSize, step, error);
+  NTA_ASSERT(error.size() == target_.size());
+  for (UInt i = 0; i < (UInt)error.size(); i++) {
+    error[i] = (Real32)target_[i] - error[i];
+  }
+}
+
+
+void SDRClassifier::growWeights_() {
+  for (auto &elem : weightMatrix_) {
+    elem.second.grow(maxInputIdx_ + 1, maxBucketIdx_ + 1);
+  }
+  for (auto &elem : weightMatrix32_) {
+    elem.second.grow(maxInputIdx_ + 1, maxBucketIdx_ + 1);
   }
-  return likelihoods;
 }
 
 
@@ -274,6 +370,52 @@ void SDRClassifier::setVerbosity(UInt verbosity) { verbosity_ = verbosity; }
 
 Real64 SDRClassifier::getAlpha() const { return alpha_; }
 
+void SDRClassifier::setSinglePrecision(bool singlePrecision) {
+  if (singlePrecision == singlePrecision_) {
+    return;
+  }
+  // Convert the weights to the other precision.
+  for (const auto &step : steps_) {
+    if (singlePrecision) {
+      const Matrix &w = weightMatrix_.at(step);
+      Matrix32 &w32 = weightMatrix32_[step];
+      w32.grow(w.rows(), w.cols());
+      for (UInt i = 0; i < w.rows(); i++) {
+        copy_n(w.row(i), w.cols(), w32.row(i));
+      }
+    } else {
+      const Matrix32 &w32 = weightMatrix32_.at(step);
+      Matrix &w = weightMatrix_[step];
+      w.grow(w32.rows(), w32.cols());
+      for (UInt i = 0; i < w32.rows(); i++) {
+        copy_n(w32.row(i), w32.cols(), w.row(i));
+      }
+    }
+  }
+  if (singlePrecision) {
+    weightMatrix_.clear();
+  } else {
+    weightMatrix32_.clear();
+  }
+  singlePrecision_ = singlePrecision;
+}
+
+bool SDRClassifier::getSinglePrecision() const { return singlePrecision_; }
+
+template <typename Weights>
+static void saveWeights_(ostream &outStream, const Weights &weights,
+                         UInt maxInputIdx, UInt maxBucketIdx) {
+  outStream << weights.size() << " ";
+  for (const auto &elem : weights) {
+    outStream << elem.first << " ";
+    for(UInt i=0; i < maxInputIdx; i++) {
+      for(UInt j=0; j< maxBucketIdx; j++) {
+        outStream << elem.second.get(i, j) << " ";
+      }
+    }
+  }
+}
+
 void SDRClassifier::save(ostream &outStream) const {
   // Write a starting marker and version.
   outStream << "SDRClassifier" << endl;
@@ -282,12 +424,12 @@ void SDRClassifier::save(ostream &outStream) const {
   // Store the simple variables first.
   outStream << version() << " " << alpha_ << " " << actValueAlpha_ << " "
             << maxSteps_ << " " << maxBucketIdx_ << " " << maxInputIdx_ << " "
-            << verbosity_ << " " << endl;
+            << verbosity_ << " " << singlePrecision_ << " " << endl;
 
   // V1 additions.
-  outStream << recordNumHistory_.size() << " ";
-  for (const auto &elem : recordNumHistory_) {
-    outStream << elem << " ";
+  outStream << history_.size() << " ";
+  for (UInt i = 0; i < history_.size(); i++) {
+    outStream << history_.recordNum(i) << " ";
   }
   outStream << endl;
 
@@ -299,26 +441,21 @@ void SDRClassifier::save(ostream &outStream) const {
   outStream << endl;
 
   // Store the pattern history.
-  outStream << patternNZHistory_.size() << " ";
-  for (auto &pattern : patternNZHistory_) {
-    outStream << pattern.size() << " ";
-    for (auto &pattern_j : pattern) {
-      outStream << pattern_j << " ";
+  outStream << history_.size() << " ";
+  for (UInt i = 0; i < history_.size(); i++) {
+    const UInt *pattern = history_.pattern(i);
+    outStream << history_.patternSize(i) << " ";
+    for (UInt j = 0; j < history_.patternSize(i); j++) {
+      outStream << pattern[j] << " ";
     }
   }
   outStream << endl;
 
   // Store weight matrix
-  outStream << weightMatrix_.size() << " ";
-  for (const auto &elem : weightMatrix_) { // elem = Matrix
-    outStream << elem.first << " ";
-    const auto map2d =  elem.second; //2d map: map<int<map<int, double>>
-    for(UInt i=0; i < maxInputIdx_; i++) {
-      for(UInt j=0; j< maxBucketIdx_; j++) {
-	const Real64 val = get_(map2d, i, j); //store dense map because indices i,j have to match in load()
-        outStream << val << " "; //map2d[i][j]
-      }
-    }
+  if (singlePrecision_) {
+    saveWeights_(outStream, weightMatrix32_, maxInputIdx_, maxBucketIdx_);
+  } else {
+    saveWeights_(outStream, weightMatrix_, maxInputIdx_, maxBucketIdx_);
   }
   outStream << endl;
 
@@ -335,14 +472,33 @@ void SDRClassifier::save(ostream &outStream) const {
 }
 
 
+template <typename Weights>
+static void loadWeights_(istream &inStream, Weights &weights,
+                         UInt maxInputIdx, UInt maxBucketIdx) {
+  UInt numSteps;
+  inStream >> numSteps;
+  for (UInt s = 0; s < numSteps; ++s) {
+    UInt step;
+    inStream >> step;
+    // Insert the step to initialize the weight matrix
+    auto &m = weights[step];
+    m.grow(maxInputIdx + 1, maxBucketIdx + 1);
+    for (UInt i = 0; i < maxInputIdx; i++) {
+      auto *row = m.row(i);
+      for (UInt j = 0; j < maxBucketIdx; j++) {
+        inStream >> row[j];
+      }
+    }
+  }
+}
+
 void SDRClassifier::load(istream &inStream) {
   // Clean up the existing data structures before loading
   steps_.clear();
-  recordNumHistory_.clear();
-  patternNZHistory_.clear();
   actualValues_.clear();
   actualValuesSet_.clear();
   weightMatrix_.clear();
+  weightMatrix32_.clear();
 
   // Check the starting marker.
   string marker;
@@ -352,18 +508,21 @@ void SDRClassifier::load(istream &inStream) {
   // Check the version.
   UInt version;
   inStream >> version;
-  NTA_CHECK(version == 2);
+  NTA_CHECK(version == 2 || version == 3);
 
   // Load the simple variables.
   inStream >> version_ >> alpha_ >> actValueAlpha_ >> maxSteps_ >>
       maxBucketIdx_ >> maxInputIdx_ >> verbosity_;
+  singlePrecision_ = false;
+  if (version >= 3) {
+    inStream >> singlePrecision_;
+  }
 
   UInt recordNumHistory;
-  UInt curRecordNum;
   inStream >> recordNumHistory;
+  vector<UInt> recordNums(recordNumHistory);
   for (UInt i = 0; i < recordNumHistory; ++i) {
-      inStream >> curRecordNum;
-      recordNumHistory_.push_back(curRecordNum);
+      inStream >> recordNums[i];
   }
 
   // Load the prediction steps.
@@ -377,31 +536,24 @@ void SDRClassifier::load(istream &inStream) {
 
   // Load the input pattern history.
   inStream >> size;
+  NTA_CHECK(size == recordNumHistory);
+  history_.reset(maxSteps_);
   UInt vSize;
+  vector<UInt> pattern;
   for (UInt i = 0; i < size; ++i) {
     inStream >> vSize;
-    patternNZHistory_.emplace_back(vSize);
+    pattern.resize(vSize);
     for (UInt j = 0; j < vSize; ++j) {
-      inStream >> patternNZHistory_[i][j];
+      inStream >> pattern[j];
     }
+    history_.push(recordNums[i], pattern.data(), vSize);
   }
 
   // Load weight matrix.
-  UInt numSteps;
-  inStream >> numSteps;
-  for (UInt s = 0; s < numSteps; ++s) {
-    inStream >> step;
-    // Insert the step to initialize the weight matrix
-    auto m = Matrix();
-    for (UInt i = 0; i < maxInputIdx_; i++) {
-      for (UInt j = 0; j < maxBucketIdx_; j++) {
-	Real64 val;
-        inStream >> val;
-	if(val == 0.0) continue; //load sparse map only
-	m[i][j] = val;
-      }
-    }
-    weightMatrix_[step] = m;
+  if (singlePrecision_) {
+    loadWeights_(inStream, weightMatrix32_, maxInputIdx_, maxBucketIdx_);
+  } else {
+    loadWeights_(inStream, weightMatrix_, maxInputIdx_, maxBucketIdx_);
   }
 
   // Load the actual values for each bucket.
@@ -426,6 +578,29 @@ void SDRClassifier::load(istream &inStream) {
 
 
 
+template <typename Weights>
+static bool sameWeights_(const Weights &weights, const Weights &otherWeights,
+                         UInt maxInputIdx, UInt maxBucketIdx) {
+  if (weights.size() != otherWeights.size()) {
+    return false;
+  }
+  for (auto it = weights.begin(); it != weights.end(); it++) {
+    const auto &thisMatrix = it->second;
+    const auto otherIt = otherWeights.find(it->first);
+    if (otherIt == otherWeights.end()) {
+      return false;
+    }
+    for (UInt i = 0; i <= maxInputIdx; ++i) {
+      for (UInt j = 0; j <= maxBucketIdx; ++j) {
+        if (thisMatrix.get(i, j) != otherIt->second.get(i, j)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
 bool SDRClassifier::operator==(const SDRClassifier &other) const {
   if (steps_.size() != other.steps_.size()) {
     return false;
@@ -442,30 +617,9 @@ bool SDRClassifier::operator==(const SDRClassifier &other) const {
     return false;
   }
 
-  if (patternNZHistory_.size() != other.patternNZHistory_.size()) {
+  if (!(history_ == other.history_)) {
     return false;
   }
-  for (UInt i = 0; i < patternNZHistory_.size(); i++) {
-    if (patternNZHistory_.at(i).size() !=
-        other.patternNZHistory_.at(i).size()) {
-      return false;
-    }
-    for (UInt j = 0; j < patternNZHistory_.at(i).size(); j++) {
-      if (patternNZHistory_.at(i).at(j) !=
-          other.patternNZHistory_.at(i).at(j)) {
-        return false;
-      }
-    }
-  }
-
-  if (recordNumHistory_.size() != other.recordNumHistory_.size()) {
-    return false;
-  }
-  for (UInt i = 0; i < recordNumHistory_.size(); i++) {
-    if (recordNumHistory_.at(i) != other.recordNumHistory_.at(i)) {
-      return false;
-    }
-  }
 
   if (maxBucketIdx_ != other.maxBucketIdx_) {
     return false;
@@ -475,19 +629,12 @@ bool SDRClassifier::operator==(const SDRClassifier &other) const {
     return false;
   }
 
-  if (weightMatrix_.size() != other.weightMatrix_.size()) {
+  if (singlePrecision_ != other.singlePrecision_) {
     return false;
   }
-  for (auto it = weightMatrix_.begin(); it != weightMatrix_.end(); it++) {
-    const Matrix thisWeights = it->second;
-    const Matrix otherWeights = other.weightMatrix_.at(it->first);
-    for (UInt i = 0; i <= maxInputIdx_; ++i) {
-      for (UInt j = 0; j <= maxBucketIdx_; ++j) {
-        if (get_(thisWeights, i, j) != get_(otherWeights, i, j)) {
-          return false;
-        }
-      }
-    }
+  if (!sameWeights_(weightMatrix_, other.weightMatrix_, maxInputIdx_, maxBucketIdx_) ||
+      !sameWeights_(weightMatrix32_, other.weightMatrix32_, maxInputIdx_, maxBucketIdx_)) {
+    return false;
   }
 
   if (actualValues_.size() != other.actualValues_.size() ||
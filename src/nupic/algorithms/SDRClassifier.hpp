@@ -27,7 +27,7 @@
 #ifndef NTA_SDR_CLASSIFIER_HPP
 #define NTA_SDR_CLASSIFIER_HPP
 
-#include <deque>
+#include <algorithm>
 #include <iostream>
 #include <map>
 #include <string>
@@ -36,6 +36,7 @@
 #include <nupic/types/ClassifierResult.hpp>
 #include <nupic/types/Types.hpp>
 #include <nupic/types/Serializable.hpp>
+#include <nupic/utils/Log.hpp>
 
 namespace nupic {
 namespace algorithms {
@@ -43,14 +44,114 @@ namespace sdr_classifier {
 using namespace std;
 using nupic::types::ClassifierResult;
 
-const UInt sdrClassifierVersion = 2;
+const UInt sdrClassifierVersion = 3;
 
 /**
- * 2d map used to store the data. 
- * write with Matrix m; m[i][j] = 1.0; //map will always allocate for new i,j index
- * access/read with get_(&m, i, j): as it handles missing values i,j and returns 0.0 for them
+ * Dense row-major matrix used to store the weights, with one row per input
+ * bit and one column per bucket. Its capacity grows geometrically as new
+ * input bits and buckets are seen, so that inference and learning are plain
+ * loops over contiguous rows. Cells outside of the matrix read as 0.0.
  */
-typedef std::map<UInt, std::map<UInt, Real64>> Matrix; //Matrix[r][c] = 0.0d
+template <typename Real> class DenseMatrix {
+public:
+  UInt rows() const { return rows_; }
+  UInt cols() const { return cols_; }
+
+  /**
+   * Grows the matrix to at least rows x cols. New cells are zero.
+   */
+  void grow(const UInt rows, const UInt cols) {
+    if (cols > stride_) {
+      // Re-layout with a wider stride, leaving room for more buckets.
+      const UInt stride = std::max(cols, 2u * stride_);
+      vector<Real> data((size_t)rows_ * stride, (Real)0);
+      for (UInt r = 0; r < rows_; r++) {
+        std::copy_n(data_.begin() + (size_t)r * stride_, cols_,
+                    data.begin() + (size_t)r * stride);
+      }
+      data_.swap(data);
+      stride_ = stride;
+    }
+    cols_ = std::max(cols_, cols);
+    if (rows > rows_) {
+      // vector::resize grows its capacity geometrically.
+      data_.resize((size_t)rows * stride_, (Real)0);
+      rows_ = rows;
+    }
+  }
+
+  Real64 get(UInt row, UInt col) const {
+    return (row < rows_ && col < cols_) ? data_[(size_t)row * stride_ + col]
+                                        : 0.0;
+  }
+
+  Real *row(UInt row) {
+    NTA_ASSERT(row < rows_);
+    return data_.data() + (size_t)row * stride_;
+  }
+
+  const Real *row(UInt row) const {
+    NTA_ASSERT(row < rows_);
+    return data_.data() + (size_t)row * stride_;
+  }
+
+private:
+  UInt rows_   = 0u;
+  UInt cols_   = 0u;
+  UInt stride_ = 0u;
+  vector<Real> data_;
+};
+
+typedef DenseMatrix<Real64> Matrix;
+typedef DenseMatrix<Real32> Matrix32;
+
+/**
+ * Fixed capacity ring buffer of the most recent input patterns and their
+ * record numbers, oldest first.  The patterns are stored in one flat array
+ * with a fixed number of slots per pattern, which grows geometrically when a
+ * longer pattern arrives, so that pushing a pattern allocates nothing in
+ * steady state.
+ */
+class PatternHistory {
+public:
+  /**
+   * Empties the buffer and sets the number of patterns it keeps.
+   */
+  void reset(UInt capacity);
+
+  UInt size() const { return size_; }
+  UInt capacity() const { return capacity_; }
+
+  /**
+   * Appends a pattern, overwriting the oldest one when the buffer is full.
+   */
+  void push(UInt recordNum, const UInt *pattern, UInt patternSize);
+
+  /**
+   * The record number and pattern of entry i; entry 0 is the oldest.
+   */
+  UInt recordNum(UInt i) const { return recordNums_[slot_(i)]; }
+  const UInt *pattern(UInt i) const {
+    return bits_.data() + (size_t)slot_(i) * slotSize_;
+  }
+  UInt patternSize(UInt i) const { return sizes_[slot_(i)]; }
+
+  bool operator==(const PatternHistory &other) const;
+
+private:
+  UInt slot_(UInt i) const {
+    NTA_ASSERT(i < size_);
+    return (head_ + i) % capacity_;
+  }
+
+  UInt capacity_ = 0u;
+  UInt size_     = 0u;
+  UInt head_     = 0u; // Slot of the oldest entry
+  UInt slotSize_ = 0u; // Maximum pattern size which fits in a slot
+  vector<UInt> recordNums_;
+  vector<UInt> sizes_;
+  vector<UInt> bits_;
+};
 
 class SDRClassifier : public Serializable
 {
@@ -120,6 +221,17 @@ public:
    */
   Real64 getAlpha() const;
 
+  /**
+   * Store the weights in single precision and use the vectorized Real32
+   * kernels for inference and learning.  This halves the weight memory.
+   *
+   * The likelihoods agree with the default double precision mode to within
+   * about 1e-5 (see SDRClassifierTest.SinglePrecisionMatchesDouble), but are
+   * not bit identical.  Changing the mode converts the current weights.
+   */
+  void setSinglePrecision(bool singlePrecision);
+  bool getSinglePrecision() const;
+
   /**
    * Get the size of the string needed for the serialized state.
    */
@@ -150,8 +262,21 @@ private:
               ClassifierResult &result);
 
   // Helper function to compute the error signal in learning mode
-  vector<Real64> calculateError_(const vector<UInt> &bucketIdxList,
-                                 const vector<UInt> patternNZ, UInt step);
+  // against the target distribution in target_.
+  void calculateError_(const UInt *patternNZ, UInt patternSize, UInt step,
+                       vector<Real64> &error);
+
+  // Single precision versions of calculateError_ and of the likelihoods
+  void calculateError32_(const UInt *patternNZ, UInt patternSize, UInt step,
+                         vector<Real32> &error);
+  void predict32_(const UInt *patternNZ, UInt patternSize, UInt step,
+                  vector<Real32> &likelihoods);
+
+  // Learns the current buckets for every step of the history in one sweep.
+  void learn_(UInt recordNum, const vector<UInt> &bucketIdxList);
+
+  // Grows every weight matrix to cover maxInputIdx_ and maxBucketIdx_
+  void growWeights_();
 
   // softmax function
   void softmax_(vector<Real64>::iterator begin, vector<Real64>::iterator end);
@@ -170,11 +295,19 @@ private:
 
   // Stores the input pattern history, starting with the previous input
   // and containing _maxSteps total input patterns.
-  deque<vector<UInt>> patternNZHistory_;
-  deque<UInt> recordNumHistory_;
+  PatternHistory history_;
+
+  // Scratch space for learning, reused between calls to compute.
+  vector<Real64> target_;
+  vector<Real64> error_;
+  vector<Real32> error32_;
+  vector<const Real32 *> rows32_;
 
   // Weight matrices for the classifier (one per prediction step)
+  // Only one of the maps is filled, depending on singlePrecision_.
   map<UInt, Matrix> weightMatrix_;
+  map<UInt, Matrix32> weightMatrix32_;
+  bool singlePrecision_ = false;
 
   // The highest input bit that the classifier has seen so far.
   UInt maxInputIdx_;
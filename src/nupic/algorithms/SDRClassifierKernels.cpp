@@ -0,0 +1,369 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the single precision kernels used by the SDRClassifier
+ *
+ * Like the Connections kernels, the SIMD versions are compiled with
+ * per-function target attributes and chosen at runtime.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <nupic/algorithms/SDRClassifierKernels.hpp>
+#include <nupic/utils/Log.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define NTA_CLASSIFIER_SIMD
+  #define NTA_TARGET(isa) __attribute__((target(isa)))
+  #include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define NTA_CLASSIFIER_SIMD
+  #define NTA_TARGET(isa)
+  #include <immintrin.h>
+#endif
+
+using namespace nupic;
+using namespace nupic::algorithms::sdr_classifier;
+
+namespace {
+
+void sumRowsScalar_(const Real32 *const *rows, UInt32 numRows,
+                    UInt32 begin, UInt32 count, Real32 *sum) {
+  for(UInt32 i = begin; i < count; i++) {
+    Real32 s = 0.0f;
+    for(UInt32 r = 0u; r < numRows; r++) {
+      s += rows[r][i];
+    }
+    sum[i] = s;
+  }
+}
+
+void addScaledRowScalar_(Real32 *row, const Real32 *x, Real32 scale,
+                         UInt32 begin, UInt32 count) {
+  for(UInt32 i = begin; i < count; i++) {
+    row[i] += scale * x[i];
+  }
+}
+
+void softmaxScalar_(Real32 *values, UInt32 count) {
+  const Real32 maxVal = *std::max_element( values, values + count );
+  Real32 sum = 0.0f;
+  for(UInt32 i = 0u; i < count; i++) {
+    values[i] = std::exp( values[i] - maxVal );
+    sum += values[i];
+  }
+  NTA_ASSERT( sum > 0.0f );
+  for(UInt32 i = 0u; i < count; i++) {
+    values[i] /= sum;
+  }
+}
+
+#ifdef NTA_CLASSIFIER_SIMD
+
+// Coefficients of the Cephes expf approximation: exp(x) = 2^n * exp(r), with
+// |r| <= ln(2)/2 and exp(r) evaluated by a polynomial.
+const Real32 expLo_    = -87.3365448f; // exp() of this is the least normal float.
+const Real32 expHi_    =  88.3762626f;
+const Real32 log2e_    =  1.44269504088896341f;
+const Real32 ln2Hi_    =  0.693359375f;
+const Real32 ln2Lo_    = -2.12194440e-4f;
+const Real32 expP_[6]  = { 1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+                           4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f };
+
+NTA_TARGET("sse2")
+inline __m128 exp128_(__m128 x) {
+  const __m128 one = _mm_set1_ps( 1.0f );
+  x = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( expLo_ )), _mm_set1_ps( expHi_ ));
+  // n = floor(x * log2(e) + 0.5), without SSE4.1's floor instruction.
+  const __m128 fx    = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( log2e_ )), _mm_set1_ps( 0.5f ));
+  const __m128 trunc = _mm_cvtepi32_ps( _mm_cvttps_epi32( fx ));
+  const __m128 n     = _mm_sub_ps( trunc, _mm_and_ps( _mm_cmpgt_ps( trunc, fx ), one ));
+  x = _mm_sub_ps( x, _mm_mul_ps( n, _mm_set1_ps( ln2Hi_ )));
+  x = _mm_sub_ps( x, _mm_mul_ps( n, _mm_set1_ps( ln2Lo_ )));
+  __m128 y = _mm_set1_ps( expP_[0] );
+  for(int k = 1; k < 6; k++) {
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( expP_[k] ));
+  }
+  y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( y, _mm_mul_ps( x, x )), x ), one );
+  const __m128i exponent = _mm_slli_epi32( _mm_add_epi32(
+      _mm_cvttps_epi32( n ), _mm_set1_epi32( 127 )), 23 );
+  return _mm_mul_ps( y, _mm_castsi128_ps( exponent ));
+}
+
+NTA_TARGET("sse2")
+inline Real32 horizontalSum128_(__m128 v) {
+  v = _mm_add_ps( v, _mm_movehl_ps( v, v ));
+  v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ));
+  return _mm_cvtss_f32( v );
+}
+
+NTA_TARGET("sse2")
+inline Real32 horizontalMax128_(__m128 v) {
+  v = _mm_max_ps( v, _mm_movehl_ps( v, v ));
+  v = _mm_max_ss( v, _mm_shuffle_ps( v, v, 1 ));
+  return _mm_cvtss_f32( v );
+}
+
+NTA_TARGET("sse2")
+void sumRowsSSE2_(const Real32 *const *rows, UInt32 numRows, UInt32 count,
+                  Real32 *sum) {
+  UInt32 i = 0u;
+  for(; i + 16u <= count; i += 16u) {
+    __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+    __m128 c = _mm_setzero_ps(), d = _mm_setzero_ps();
+    for(UInt32 r = 0u; r < numRows; r++) {
+      const Real32 *row = rows[r] + i;
+      a = _mm_add_ps( a, _mm_loadu_ps( row ));
+      b = _mm_add_ps( b, _mm_loadu_ps( row + 4u ));
+      c = _mm_add_ps( c, _mm_loadu_ps( row + 8u ));
+      d = _mm_add_ps( d, _mm_loadu_ps( row + 12u ));
+    }
+    _mm_storeu_ps( sum + i,       a );
+    _mm_storeu_ps( sum + i + 4u,  b );
+    _mm_storeu_ps( sum + i + 8u,  c );
+    _mm_storeu_ps( sum + i + 12u, d );
+  }
+  for(; i + 4u <= count; i += 4u) {
+    __m128 a = _mm_setzero_ps();
+    for(UInt32 r = 0u; r < numRows; r++) {
+      a = _mm_add_ps( a, _mm_loadu_ps( rows[r] + i ));
+    }
+    _mm_storeu_ps( sum + i, a );
+  }
+  sumRowsScalar_( rows, numRows, i, count, sum );
+}
+
+NTA_TARGET("sse2")
+void addScaledRowSSE2_(Real32 *row, const Real32 *x, Real32 scale,
+                       UInt32 count) {
+  const __m128 s = _mm_set1_ps( scale );
+  UInt32 i = 0u;
+  for(; i + 4u <= count; i += 4u) {
+    const __m128 r = _mm_loadu_ps( row + i );
+    _mm_storeu_ps( row + i, _mm_add_ps( r, _mm_mul_ps( s, _mm_loadu_ps( x + i ))));
+  }
+  addScaledRowScalar_( row, x, scale, i, count );
+}
+
+NTA_TARGET("sse2")
+void softmaxSSE2_(Real32 *values, UInt32 count) {
+  UInt32 i = 0u;
+  __m128 vmax = _mm_set1_ps( values[0] );
+  for(; i + 4u <= count; i += 4u) {
+    vmax = _mm_max_ps( vmax, _mm_loadu_ps( values + i ));
+  }
+  Real32 maxVal = horizontalMax128_( vmax );
+  for(; i < count; i++) {
+    maxVal = std::max( maxVal, values[i] );
+  }
+
+  const __m128 m = _mm_set1_ps( maxVal );
+  __m128 vsum = _mm_setzero_ps();
+  for(i = 0u; i + 4u <= count; i += 4u) {
+    const __m128 e = exp128_( _mm_sub_ps( _mm_loadu_ps( values + i ), m ));
+    _mm_storeu_ps( values + i, e );
+    vsum = _mm_add_ps( vsum, e );
+  }
+  Real32 sum = horizontalSum128_( vsum );
+  for(; i < count; i++) {
+    values[i] = std::exp( values[i] - maxVal );
+    sum += values[i];
+  }
+  NTA_ASSERT( sum > 0.0f );
+
+  const __m128 s = _mm_set1_ps( sum );
+  for(i = 0u; i + 4u <= count; i += 4u) {
+    _mm_storeu_ps( values + i, _mm_div_ps( _mm_loadu_ps( values + i ), s ));
+  }
+  for(; i < count; i++) {
+    values[i] /= sum;
+  }
+}
+
+NTA_TARGET("avx2")
+inline __m256 exp256_(__m256 x) {
+  const __m256 one = _mm256_set1_ps( 1.0f );
+  x = _mm256_min_ps( _mm256_max_ps( x, _mm256_set1_ps( expLo_ )), _mm256_set1_ps( expHi_ ));
+  const __m256 n = _mm256_floor_ps( _mm256_add_ps(
+      _mm256_mul_ps( x, _mm256_set1_ps( log2e_ )), _mm256_set1_ps( 0.5f )));
+  x = _mm256_sub_ps( x, _mm256_mul_ps( n, _mm256_set1_ps( ln2Hi_ )));
+  x = _mm256_sub_ps( x, _mm256_mul_ps( n, _mm256_set1_ps( ln2Lo_ )));
+  __m256 y = _mm256_set1_ps( expP_[0] );
+  for(int k = 1; k < 6; k++) {
+    y = _mm256_add_ps( _mm256_mul_ps( y, x ), _mm256_set1_ps( expP_[k] ));
+  }
+  y = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( y, _mm256_mul_ps( x, x )), x ), one );
+  const __m256i exponent = _mm256_slli_epi32( _mm256_add_epi32(
+      _mm256_cvttps_epi32( n ), _mm256_set1_epi32( 127 )), 23 );
+  return _mm256_mul_ps( y, _mm256_castsi256_ps( exponent ));
+}
+
+NTA_TARGET("avx2")
+void sumRowsAVX2_(const Real32 *const *rows, UInt32 numRows, UInt32 count,
+                  Real32 *sum) {
+  UInt32 i = 0u;
+  // Four accumulators per pass over the rows, so each row is read once per
+  // 32 buckets and the sums stay in registers.
+  for(; i + 32u <= count; i += 32u) {
+    __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+    __m256 c = _mm256_setzero_ps(), d = _mm256_setzero_ps();
+    for(UInt32 r = 0u; r < numRows; r++) {
+      const Real32 *row = rows[r] + i;
+      a = _mm256_add_ps( a, _mm256_loadu_ps( row ));
+      b = _mm256_add_ps( b, _mm256_loadu_ps( row + 8u ));
+      c = _mm256_add_ps( c, _mm256_loadu_ps( row + 16u ));
+      d = _mm256_add_ps( d, _mm256_loadu_ps( row + 24u ));
+    }
+    _mm256_storeu_ps( sum + i,       a );
+    _mm256_storeu_ps( sum + i + 8u,  b );
+    _mm256_storeu_ps( sum + i + 16u, c );
+    _mm256_storeu_ps( sum + i + 24u, d );
+  }
+  for(; i + 8u <= count; i += 8u) {
+    __m256 a = _mm256_setzero_ps();
+    for(UInt32 r = 0u; r < numRows; r++) {
+      a = _mm256_add_ps( a, _mm256_loadu_ps( rows[r] + i ));
+    }
+    _mm256_storeu_ps( sum + i, a );
+  }
+  sumRowsScalar_( rows, numRows, i, count, sum );
+}
+
+NTA_TARGET("avx2")
+void addScaledRowAVX2_(Real32 *row, const Real32 *x, Real32 scale,
+                       UInt32 count) {
+  const __m256 s = _mm256_set1_ps( scale );
+  UInt32 i = 0u;
+  for(; i + 8u <= count; i += 8u) {
+    const __m256 r = _mm256_loadu_ps( row + i );
+    _mm256_storeu_ps( row + i, _mm256_add_ps( r, _mm256_mul_ps( s, _mm256_loadu_ps( x + i ))));
+  }
+  addScaledRowScalar_( row, x, scale, i, count );
+}
+
+NTA_TARGET("avx2")
+void softmaxAVX2_(Real32 *values, UInt32 count) {
+  UInt32 i = 0u;
+  __m256 vmax = _mm256_set1_ps( values[0] );
+  for(; i + 8u <= count; i += 8u) {
+    vmax = _mm256_max_ps( vmax, _mm256_loadu_ps( values + i ));
+  }
+  Real32 maxVal = horizontalMax128_( _mm_max_ps(
+      _mm256_castps256_ps128( vmax ), _mm256_extractf128_ps( vmax, 1 )));
+  for(; i < count; i++) {
+    maxVal = std::max( maxVal, values[i] );
+  }
+
+  const __m256 m = _mm256_set1_ps( maxVal );
+  __m256 vsum = _mm256_setzero_ps();
+  for(i = 0u; i + 8u <= count; i += 8u) {
+    const __m256 e = exp256_( _mm256_sub_ps( _mm256_loadu_ps( values + i ), m ));
+    _mm256_storeu_ps( values + i, e );
+    vsum = _mm256_add_ps( vsum, e );
+  }
+  Real32 sum = horizontalSum128_( _mm_add_ps(
+      _mm256_castps256_ps128( vsum ), _mm256_extractf128_ps( vsum, 1 )));
+  for(; i < count; i++) {
+    values[i] = std::exp( values[i] - maxVal );
+    sum += values[i];
+  }
+  NTA_ASSERT( sum > 0.0f );
+
+  const __m256 s = _mm256_set1_ps( sum );
+  for(i = 0u; i + 8u <= count; i += 8u) {
+    _mm256_storeu_ps( values + i, _mm256_div_ps( _mm256_loadu_ps( values + i ), s ));
+  }
+  for(; i < count; i++) {
+    values[i] /= sum;
+  }
+}
+
+#endif // NTA_CLASSIFIER_SIMD
+
+} // end anonymous namespace
+
+namespace nupic {
+namespace algorithms {
+namespace sdr_classifier {
+
+void sumRows(const Real32 *const *rows, UInt32 numRows, UInt32 count,
+             Real32 *sum, SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+  switch( level ) {
+#ifdef NTA_CLASSIFIER_SIMD
+    case SimdLevel::AVX2:
+      sumRowsAVX2_( rows, numRows, count, sum );
+      return;
+    case SimdLevel::SSE2:
+      sumRowsSSE2_( rows, numRows, count, sum );
+      return;
+#endif
+    default:
+      sumRowsScalar_( rows, numRows, 0u, count, sum );
+      return;
+  }
+}
+
+
+void addScaledRow(Real32 *row, const Real32 *x, Real32 scale, UInt32 count,
+                  SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+  switch( level ) {
+#ifdef NTA_CLASSIFIER_SIMD
+    case SimdLevel::AVX2:
+      addScaledRowAVX2_( row, x, scale, count );
+      return;
+    case SimdLevel::SSE2:
+      addScaledRowSSE2_( row, x, scale, count );
+      return;
+#endif
+    default:
+      addScaledRowScalar_( row, x, scale, 0u, count );
+      return;
+  }
+}
+
+
+void softmax(Real32 *values, UInt32 count, SimdLevel level) {
+  NTA_ASSERT( level <= simdLevel() );
+  if( count == 0u )
+    return;
+  switch( level ) {
+#ifdef NTA_CLASSIFIER_SIMD
+    case SimdLevel::AVX2:
+      softmaxAVX2_( values, count );
+      return;
+    case SimdLevel::SSE2:
+      softmaxSSE2_( values, count );
+      return;
+#endif
+    default:
+      softmaxScalar_( values, count );
+      return;
+  }
+}
+
+} // end namespace sdr_classifier
+} // end namespace algorithms
+} // end namespace nupic
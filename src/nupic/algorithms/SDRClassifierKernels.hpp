@@ -0,0 +1,76 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the single precision kernels used by the SDRClassifier
+ */
+
+#ifndef NTA_SDR_CLASSIFIER_KERNELS_HPP
+#define NTA_SDR_CLASSIFIER_KERNELS_HPP
+
+#include <nupic/algorithms/ConnectionsKernels.hpp>
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+namespace algorithms {
+namespace sdr_classifier {
+
+using connections::SimdLevel;
+using connections::simdLevel;
+
+/**
+ * Sum several weight rows: sum[i] = rows[0][i] + rows[1][i] + ...
+ *
+ * The rows are added in order for every element, so all instruction sets
+ * give exactly the same sums.
+ *
+ * @param rows    Pointers to the rows, count elements each.
+ * @param numRows Number of rows.
+ * @param count   Number of elements per row.
+ * @param sum     Output: count elements, overwritten.
+ * @param level   Instruction set to use, at most simdLevel().
+ */
+void sumRows(const Real32 *const *rows, UInt32 numRows, UInt32 count,
+             Real32 *sum, SimdLevel level = simdLevel());
+
+/**
+ * Add a scaled vector to a weight row: row[i] += scale * x[i].
+ *
+ * All instruction sets give exactly the same results.
+ */
+void addScaledRow(Real32 *row, const Real32 *x, Real32 scale, UInt32 count,
+                  SimdLevel level = simdLevel());
+
+/**
+ * Softmax of the values, in place.
+ *
+ * The SIMD levels use a polynomial approximation of exp() and reorder the
+ * normalizing sum, so their results are within a few ulp of the scalar
+ * level, which uses std::exp.
+ */
+void softmax(Real32 *values, UInt32 count, SimdLevel level = simdLevel());
+
+} // end namespace sdr_classifier
+} // end namespace algorithms
+} // end namespace nupic
+
+#endif // NTA_SDR_CLASSIFIER_KERNELS_HPP
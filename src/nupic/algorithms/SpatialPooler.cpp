@@ -29,6 +29,7 @@
 #include <iterator> //begin()
 #include <cmath> //fmod
 
+#include <nupic/algorithms/ConnectionsBinary.hpp>
 #include <nupic/algorithms/SpatialPooler.hpp>
 #include <nupic/math/Topology.hpp>
 #include <nupic/math/Math.hpp> // nupic::Epsilon
@@ -83,6 +84,80 @@ private:
   vector<UInt> bounds_;
 };
 
+// The coordinates which a (Wrapping)Neighborhood visits along one dimension,
+// as at most two half open intervals.
+struct NeighborhoodWindow1D {
+  UInt numIntervals;
+  UInt begin[2];
+  UInt end[2];
+  UInt size;
+
+  NeighborhoodWindow1D(UInt center, UInt radius, UInt dimension, bool wrap) {
+    if (!wrap) {
+      numIntervals = 1u;
+      begin[0] = center > radius ? center - radius : 0u;
+      end[0]   = (UInt) std::min<UInt64>((UInt64) center + radius + 1u, dimension);
+      size     = end[0] - begin[0];
+      return;
+    }
+    // WrappingNeighborhood visits offsets -radius, -radius+1, ... and stops
+    // before it would revisit a coordinate.
+    size = (UInt) std::min<UInt64>(2u * (UInt64) radius + 1u, dimension);
+    const UInt start = (center + dimension - radius % dimension) % dimension;
+    begin[0] = start;
+    if (start + size <= dimension) {
+      numIntervals = 1u;
+      end[0] = start + size;
+    } else {
+      numIntervals = 2u;
+      end[0]   = dimension;
+      begin[1] = 0u;
+      end[1]   = start + size - dimension;
+    }
+  }
+};
+
+// Counts marked columns inside rectangles of a 2-D column grid, using a 2-D
+// binary indexed (Fenwick) tree.  Both updates and queries take
+// O(log(rows) * log(cols)), independent of the size of the rectangle.
+class RectangleCounter2D {
+
+public:
+  RectangleCounter2D(UInt rows, UInt cols)
+    : rows_(rows), cols_(cols), tree_((rows + 1u) * (cols + 1u), 0) {}
+
+  void add(UInt row, UInt col, Int delta) {
+    for (UInt r = row + 1u; r <= rows_; r += r & (~r + 1u)) {
+      for (UInt c = col + 1u; c <= cols_; c += c & (~c + 1u)) {
+        tree_[r * (cols_ + 1u) + c] += delta;
+      }
+    }
+  }
+
+  // Number of marked columns in rows [row0, row1) and columns [col0, col1).
+  Int count(UInt row0, UInt row1, UInt col0, UInt col1) const {
+    return prefix_(row1, col1) - prefix_(row0, col1)
+         - prefix_(row1, col0) + prefix_(row0, col0);
+  }
+
+  void clear() { std::fill(tree_.begin(), tree_.end(), 0); }
+
+private:
+  Int prefix_(UInt row, UInt col) const {
+    Int sum = 0;
+    for (UInt r = row; r > 0u; r -= r & (~r + 1u)) {
+      for (UInt c = col; c > 0u; c -= c & (~c + 1u)) {
+        sum += tree_[r * (cols_ + 1u) + c];
+      }
+    }
+    return sum;
+  }
+
+  UInt rows_;
+  UInt cols_;
+  vector<Int> tree_;
+};
+
 SpatialPooler::SpatialPooler() {
   // The current version number.
   version_ = 2;
@@ -526,11 +601,84 @@ void SpatialPooler::compute(const SDR &input, bool learn, SDR &active) {
 }
 
 
+void SpatialPooler::computeBatch(const vector<SDR> &inputs,
+                                 vector<SDR> &actives) {
+  const UInt numInputs = (UInt)inputs.size();
+  // The SDRs convert their data lazily, so do that before the threads share them.
+  vector<const vector<connections::CellIdx> *> activeInputs( numInputs );
+  for(UInt i = 0u; i < numInputs; i++) {
+    NTA_CHECK( inputs[i].dimensions == inputDimensions_ );
+    activeInputs[i] = &inputs[i].getSparse();
+  }
+  if( actives.size() != numInputs )
+    actives.resize( numInputs, SDR( columnDimensions_ ));
+  for(const auto &active : actives)
+    NTA_CHECK( active.dimensions == columnDimensions_ );
+
+  for(UInt i = 0u; i < numInputs; i++)
+    updateBookeepingVars_(false);
+
+  // Count the overlaps of a block of inputs at a time, then boost and inhibit
+  // each input of the block on its own thread.  The block size bounds the
+  // memory for the counts.
+  const UInt blockSize = 64u;
+  vector<UInt32> counts;
+  for(UInt block = 0u; block < numInputs; block += blockSize) {
+    const UInt blockEnd = min(block + blockSize, numInputs);
+    const vector<const vector<connections::CellIdx> *> blockInputs(
+        activeInputs.begin() + block, activeInputs.begin() + blockEnd );
+    connections_.computeActivityBatch( counts, blockInputs, threadPool_.get() );
+
+    parallelFor_(block, blockEnd, [&](UInt begin, UInt end, UInt) {
+      vector<UInt> overlaps;
+      vector<Real> boosted( numColumns_ );
+      vector<UInt> activeColumns;
+      for(UInt i = begin; i < end; i++) {
+        const auto first = counts.begin() + (Size)(i - block) * numColumns_;
+        overlaps.assign( first, first + numColumns_ );
+        boostOverlaps_(overlaps, boosted);
+        inhibitColumns_(boosted, activeColumns);
+        actives[i].setSparse( activeColumns );
+      }
+    });
+  }
+}
+
+
+void SpatialPooler::setNumThreads(UInt numThreads) {
+  if( numThreads == 1u )
+    threadPool_.reset();
+  else
+    threadPool_ = std::make_shared<ThreadPool>( numThreads );
+}
+
+
+void SpatialPooler::setThreadPool(std::shared_ptr<ThreadPool> threadPool) {
+  threadPool_ = threadPool;
+}
+
+
+UInt SpatialPooler::getNumThreads() const {
+  return threadPool_ ? threadPool_->numThreads() : 1u;
+}
+
+
+void SpatialPooler::parallelFor_(UInt begin, UInt end,
+                                 const ThreadPool::Task &task) const {
+  if( threadPool_ )
+    threadPool_->parallelFor( begin, end, task );
+  else if( begin < end )
+    task( begin, end, 0u );
+}
+
+
 void SpatialPooler::boostOverlaps_(const vector<UInt> &overlaps, //TODO use Eigen sparse vector here
                                    vector<Real> &boosted) const {
-  for (UInt i = 0; i < numColumns_; i++) {
-    boosted[i] = overlaps[i] * boostFactors_[i];
-  }
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++) {
+      boosted[i] = overlaps[i] * boostFactors_[i];
+    }
+  });
 }
 
 
@@ -616,9 +764,17 @@ void SpatialPooler::updateInhibitionRadius_() {
     return;
   }
 
+  // Compute the spans in parallel but sum them in column order, so that the
+  // result does not depend on the number of threads.
+  vector<Real> spans( numColumns_ );
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++) {
+      spans[i] = avgConnectedSpanForColumnND_(i);
+    }
+  });
   Real connectedSpan = 0.0f;
   for (UInt i = 0; i < numColumns_; i++) {
-    connectedSpan += avgConnectedSpanForColumnND_(i);
+    connectedSpan += spans[i];
   }
   connectedSpan /= numColumns_;
   const Real columnsPerInput = avgColumnsPerInput_();
@@ -650,23 +806,13 @@ void SpatialPooler::updateMinDutyCyclesGlobal_() {
 
 
 void SpatialPooler::updateMinDutyCyclesLocal_() {
-  for (UInt i = 0; i < numColumns_; i++) {
-    Real maxActiveDuty = 0.0f;
-    Real maxOverlapDuty = 0.0f;
-    if (wrapAround_) {
-     for(auto column : WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-      maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-      maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-     }
-    } else {
-     for(auto column: Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-      maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-      maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-      }
+  const vector<Real> maxOverlapDuty = neighborhoodMax(
+      overlapDutyCycles_, inhibitionRadius_, columnDimensions_, wrapAround_);
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++) {
+      minOverlapDutyCycles_[i] = maxOverlapDuty[i] * minPctOverlapDutyCycles_;
     }
-
-    minOverlapDutyCycles_[i] = maxOverlapDuty * minPctOverlapDutyCycles_;
-  }
+  });
 }
 
 
@@ -685,8 +831,8 @@ void SpatialPooler::updateDutyCycles_(const vector<UInt> &overlaps,
 
   const UInt period = std::min(dutyCyclePeriod_, iterationNum_);
 
-  updateDutyCyclesHelper_(overlapDutyCycles_, newOverlap, period);
-  updateDutyCyclesHelper_(activeDutyCycles_, active, period);
+  updateDutyCyclesParallel_(overlapDutyCycles_, newOverlap, period);
+  updateDutyCyclesParallel_(activeDutyCycles_, active, period);
 }
 
 
@@ -779,6 +925,24 @@ void SpatialPooler::updateDutyCyclesHelper_(vector<Real> &dutyCycles,
 }
 
 
+void SpatialPooler::updateDutyCyclesParallel_(vector<Real> &dutyCycles,
+                                              SDR &newValues,
+                                              UInt period) const {
+  NTA_ASSERT(period > 0);
+  NTA_ASSERT(dutyCycles.size() == newValues.size);
+
+  const Real decay = (Real) (period - 1) / period;
+  parallelFor_(0u, (UInt)dutyCycles.size(), [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++)
+      dutyCycles[i] *= decay;
+  });
+
+  const Real increment = 1.0f / period;  // All non-zero values are 1.
+  for(const auto &idx : newValues.getSparse())
+    dutyCycles[idx] += increment;
+}
+
+
 void SpatialPooler::updateBoostFactors_() {
   if (globalInhibition_) {
     updateBoostFactorsGlobal_();
@@ -801,33 +965,24 @@ void SpatialPooler::updateBoostFactorsGlobal_() {
     targetDensity = localAreaDensity_;
   }
 
-  for (UInt i = 0; i < numColumns_; ++i) {
-    boostFactors_[i] = exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
-  }
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; ++i) {
+      boostFactors_[i] = exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
+    }
+  });
 }
 
 
 void SpatialPooler::updateBoostFactorsLocal_() {
-  for (UInt i = 0; i < numColumns_; ++i) {
-    UInt numNeighbors = 0u;
-    Real localActivityDensity = 0.0f;
-
-    if (wrapAround_) {
-      for(auto neighbor: WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
-    } else {
-      for(auto neighbor: Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
+  const vector<Real> localActivityDensity = neighborhoodMean(
+      activeDutyCycles_, inhibitionRadius_, columnDimensions_, wrapAround_);
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; ++i) {
+      const Real targetDensity = localActivityDensity[i];
+      boostFactors_[i] =
+          exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
     }
-
-    const Real targetDensity = localActivityDensity / numNeighbors;
-    boostFactors_[i] =
-        exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
-  }
+  });
 }
 
 
@@ -842,21 +997,24 @@ void SpatialPooler::updateBookeepingVars_(bool learn) {
 void SpatialPooler::calculateOverlap_(const SDR &input,
                                       vector<UInt> &overlaps) const {
   overlaps.assign( numColumns_, 0 );
-  connections_.computeActivity(overlaps, input.getSparse());
+  if( threadPool_ )
+    connections_.computeActivity(overlaps, input.getSparse(), *threadPool_);
+  else
+    connections_.computeActivity(overlaps, input.getSparse());
 }
 
 
 void SpatialPooler::calculateOverlapPct_(const vector<UInt> &overlaps,
                                          vector<Real> &overlapPct) const {
   overlapPct.assign(numColumns_, 0);
-  vector<UInt> connectedCounts( numColumns_ );
-  getConnectedCounts( connectedCounts.data() );
-
-  for (UInt i = 0; i < numColumns_; i++) {
-    if (connectedCounts[i] != 0) {
-      overlapPct[i] = ((Real)overlaps[i]) / connectedCounts[i];
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++) {
+      const UInt connectedCount = connections_.dataForSegment( i ).numConnected;
+      if (connectedCount != 0) {
+        overlapPct[i] = ((Real)overlaps[i]) / connectedCount;
+      }
     }
-  }
+  });
 }
 
 
@@ -888,9 +1046,11 @@ void SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
   NTA_ASSERT(density > 0.0f && density <= 1.0f);
 
   // Add a tiebreaker to the overlaps so that the output is deterministic.
-  vector<Real> overlaps_(overlaps.begin(), overlaps.end());
-  for(UInt i = 0; i < numColumns_; i++)
-    overlaps_[i] += tieBreaker_[i];
+  vector<Real> overlaps_( numColumns_ );
+  parallelFor_(0u, numColumns_, [&](UInt begin, UInt end, UInt) {
+    for(UInt i = begin; i < end; i++)
+      overlaps_[i] = overlaps[i] + tieBreaker_[i];
+  });
 
   activeColumns.clear();
   const UInt numDesired = (UInt)(density * numColumns_);
@@ -927,6 +1087,26 @@ void SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
 void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
                                          Real density,
                                          vector<UInt> &activeColumns) const {
+  // Iterating small neighborhoods directly is cheaper than maintaining the
+  // rank counting trees.
+  if (columnDimensions_.size() <= 2u) {
+    UInt64 area = 1u;
+    for (const auto dim : columnDimensions_) {
+      area *= std::min<UInt64>(2u * (UInt64) inhibitionRadius_ + 1u, dim);
+    }
+    if (area > 8u) {
+      inhibitColumnsLocalRanked_(overlaps, density, activeColumns);
+      return;
+    }
+  }
+  inhibitColumnsLocalNeighborhood_(overlaps, density, activeColumns);
+}
+
+
+void SpatialPooler::inhibitColumnsLocalNeighborhood_(
+                                         const vector<Real> &overlaps,
+                                         Real density,
+                                         vector<UInt> &activeColumns) const {
   activeColumns.clear();
 
   // Tie-breaking: when overlaps are equal, columns that have already been
@@ -977,6 +1157,108 @@ void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
 }
 
 
+void SpatialPooler::inhibitColumnsLocalRanked_(const vector<Real> &overlaps,
+                                               Real density,
+                                               vector<UInt> &activeColumns) const {
+  NTA_CHECK(columnDimensions_.size() <= 2u)
+      << "Ranked local inhibition supports only 1-D and 2-D column topologies.";
+  NTA_ASSERT(overlaps.size() == numColumns_);
+
+  // A 1-D topology is a 2-D topology with a single row.
+  const UInt rows = columnDimensions_.size() == 2u ? columnDimensions_[0] : 1u;
+  const UInt cols = columnDimensions_.back();
+  vector<NeighborhoodWindow1D> rowWindows, colWindows;
+  rowWindows.reserve(rows);
+  colWindows.reserve(cols);
+  for (UInt row = 0; row < rows; row++) {
+    rowWindows.emplace_back(row, inhibitionRadius_, rows, wrapAround_);
+  }
+  for (UInt col = 0; col < cols; col++) {
+    colWindows.emplace_back(col, inhibitionRadius_, cols, wrapAround_);
+  }
+
+  RectangleCounter2D counter(rows, cols);
+  // Counts the marked columns in the neighborhood of the given column,
+  // including the column itself.
+  const auto countNeighborhood = [&](UInt column) -> UInt {
+    const NeighborhoodWindow1D &rowWindow = rowWindows[column / cols];
+    const NeighborhoodWindow1D &colWindow = colWindows[column % cols];
+    Int sum = 0;
+    for (UInt r = 0; r < rowWindow.numIntervals; r++) {
+      for (UInt c = 0; c < colWindow.numIntervals; c++) {
+        sum += counter.count(rowWindow.begin[r], rowWindow.end[r],
+                             colWindow.begin[c], colWindow.end[c]);
+      }
+    }
+    return (UInt) sum;
+  };
+
+  // Sort the columns by decreasing overlap.  The stable sort keeps the
+  // columns with equal overlaps in index order, which is the order in which
+  // ties are arbitrated.
+  vector<UInt> order(numColumns_);
+  for (UInt i = 0; i < numColumns_; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&overlaps](const UInt a, const UInt b)
+                   { return overlaps[a] > overlaps[b]; });
+  // Start of every group of columns with equal overlaps, plus the end.
+  vector<UInt> groups;
+  for (UInt i = 0; i < numColumns_; i++) {
+    if (i == 0u || overlaps[order[i]] != overlaps[order[i - 1u]]) {
+      groups.push_back(i);
+    }
+  }
+  groups.push_back(numColumns_);
+
+  // Count the neighbors with strictly bigger overlaps: insert the groups in
+  // order of decreasing overlap and query each group before inserting it.
+  vector<UInt> numBigger(numColumns_);
+  for (Size g = 0; g + 1u < groups.size(); g++) {
+    for (UInt i = groups[g]; i < groups[g + 1u]; i++) {
+      numBigger[order[i]] = countNeighborhood(order[i]);
+    }
+    for (UInt i = groups[g]; i < groups[g + 1u]; i++) {
+      counter.add(order[i] / cols, order[i] % cols, 1);
+    }
+  }
+
+  // Tie-breaking: when overlaps are equal, columns that have already been
+  // selected are treated as "bigger".  Ties only occur within a group, so
+  // each group is arbitrated on its own, in index order.
+  counter.clear();
+  vector<bool> activeColumnsDense(numColumns_, false);
+  for (Size g = 0; g + 1u < groups.size(); g++) {
+    for (UInt i = groups[g]; i < groups[g + 1u]; i++) {
+      const UInt column = order[i];
+      if (overlaps[column] < stimulusThreshold_) {
+        continue;
+      }
+      const UInt numNeighborhood = rowWindows[column / cols].size *
+                                   colWindows[column % cols].size;
+      const UInt numActive = (UInt)(0.5f + (density * numNeighborhood));
+      if (numBigger[column] + countNeighborhood(column) < numActive) {
+        activeColumnsDense[column] = true;
+        counter.add(column / cols, column % cols, 1);
+      }
+    }
+    for (UInt i = groups[g]; i < groups[g + 1u]; i++) {
+      if (activeColumnsDense[order[i]]) {
+        counter.add(order[i] / cols, order[i] % cols, -1);
+      }
+    }
+  }
+
+  activeColumns.clear();
+  for (UInt column = 0; column < numColumns_; column++) {
+    if (activeColumnsDense[column]) {
+      activeColumns.push_back(column);
+    }
+  }
+}
+
+
 bool SpatialPooler::isUpdateRound_() const {
   return (iterationNum_ % updatePeriod_) == 0;
 }
@@ -1066,6 +1348,120 @@ void SpatialPooler::save(ostream &outStream) const {
   outStream << "~SpatialPooler" << endl;
 }
 
+namespace {
+/**
+ * Start of the binary format, with the high bit set like that of Connections.
+ */
+const char binaryMagic[8] = { '\x89', 'N', 'T', 'A', 'S', 'P', 'L', '\n' };
+const char binaryEndMagic[8] = { '~', 'N', 'T', 'A', 'S', 'P', 'L', '\n' };
+const UInt32 BINARY_VERSION = 1u;
+} // end anonymous namespace
+
+void SpatialPooler::saveBinary(ostream &outStream) const {
+  using namespace nupic::algorithms::connections::binary;
+  outStream.write( binaryMagic, sizeof(binaryMagic) );
+  writeValue( outStream, BINARY_VERSION );
+  // The sizes of the configurable types.
+  writeValue( outStream, (Byte)sizeof(UInt) );
+  writeValue( outStream, (Byte)sizeof(Real) );
+
+  // Store the simple variables first.
+  for( const UInt value : { numInputs_, numColumns_, potentialRadius_,
+                            stimulusThreshold_, inhibitionRadius_,
+                            dutyCyclePeriod_, iterationNum_, iterationLearnNum_,
+                            spVerbosity_, updatePeriod_ })
+    writeValue( outStream, value );
+  writeValue( outStream, numActiveColumnsPerInhArea_ );
+  for( const Real value : { potentialPct_, initConnectedPct_, localAreaDensity_,
+                            boostStrength_, synPermInactiveDec_,
+                            synPermActiveInc_, synPermBelowStimulusInc_,
+                            synPermConnected_, minPctOverlapDutyCycles_ })
+    writeValue( outStream, value );
+  writeValue( outStream, (Byte)globalInhibition_ );
+  writeValue( outStream, (Byte)wrapAround_ );
+
+  // Store vectors, each one with a single write.
+  writeVector( outStream, inputDimensions_ );
+  writeVector( outStream, columnDimensions_ );
+  writeVector( outStream, boostFactors_ );
+  writeVector( outStream, overlapDutyCycles_ );
+  writeVector( outStream, activeDutyCycles_ );
+  writeVector( outStream, minOverlapDutyCycles_ );
+  writeVector( outStream, tieBreaker_ );
+
+  connections_.saveBinary( outStream );
+
+  // Random is only serializable as text.
+  stringstream rng;
+  rng << rng_;
+  const string &rngState = rng.str();
+  writeVector( outStream, vector<char>( rngState.begin(), rngState.end() ));
+
+  outStream.write( binaryEndMagic, sizeof(binaryEndMagic) );
+}
+
+void SpatialPooler::loadBinary_(istream &inStream) {
+  using namespace nupic::algorithms::connections::binary;
+  char magic[sizeof(binaryMagic)];
+  read( inStream, magic, sizeof(magic) );
+  NTA_CHECK( std::equal( magic, magic + sizeof(magic), binaryMagic ))
+    << "SpatialPooler: not in the binary format.";
+  const UInt32 version = readValue<UInt32>( inStream );
+  NTA_CHECK( version <= BINARY_VERSION )
+    << "SpatialPooler: unsupported binary version " << version;
+  const Byte uintSize = readValue<Byte>( inStream );
+  const Byte realSize = readValue<Byte>( inStream );
+  NTA_CHECK( (Size)uintSize == sizeof(UInt) && (Size)realSize == sizeof(Real) )
+    << "SpatialPooler: saved with other sizes of UInt and Real.";
+
+  // Retrieve simple variables
+  for( UInt *value : { &numInputs_, &numColumns_, &potentialRadius_,
+                       &stimulusThreshold_, &inhibitionRadius_,
+                       &dutyCyclePeriod_, &iterationNum_, &iterationLearnNum_,
+                       &spVerbosity_, &updatePeriod_ })
+    *value = readValue<UInt>( inStream );
+  numActiveColumnsPerInhArea_ = readValue<Int>( inStream );
+  for( Real *value : { &potentialPct_, &initConnectedPct_, &localAreaDensity_,
+                       &boostStrength_, &synPermInactiveDec_,
+                       &synPermActiveInc_, &synPermBelowStimulusInc_,
+                       &synPermConnected_, &minPctOverlapDutyCycles_ })
+    *value = readValue<Real>( inStream );
+  globalInhibition_ = readValue<Byte>( inStream ) != 0;
+  wrapAround_       = readValue<Byte>( inStream ) != 0;
+
+  // Retrieve vectors.
+  readVector( inStream, inputDimensions_ );
+  readVector( inStream, columnDimensions_ );
+  readVector( inStream, boostFactors_ );
+  readVector( inStream, overlapDutyCycles_ );
+  readVector( inStream, activeDutyCycles_ );
+  readVector( inStream, minOverlapDutyCycles_ );
+  readVector( inStream, tieBreaker_ );
+  for( const auto *columnState : { &boostFactors_, &overlapDutyCycles_,
+                                   &activeDutyCycles_, &minOverlapDutyCycles_,
+                                   &tieBreaker_ })
+    NTA_CHECK( columnState->size() == numColumns_ )
+      << "SpatialPooler: corrupt binary data.";
+
+  connections_.load( inStream );
+  NTA_CHECK( connections_.numCells() == numColumns_ )
+    << "SpatialPooler: corrupt binary data.";
+
+  vector<char> rngState;
+  readVector( inStream, rngState );
+  stringstream rng( string( rngState.begin(), rngState.end() ));
+  rng >> rng_;
+
+  read( inStream, magic, sizeof(magic) );
+  NTA_CHECK( std::equal( magic, magic + sizeof(magic), binaryEndMagic ))
+    << "SpatialPooler: corrupt binary data.";
+
+  // initialize ephemeral members
+  overlaps_.resize(numColumns_);
+  overlapsPct_.resize(numColumns_);
+  boostedOverlaps_.resize(numColumns_);
+}
+
 // Implementation note: this method sets up the instance using data from
 // inStream. This method does not call initialize. As such we have to be careful
 // that everything in initialize is handled properly here.
@@ -1073,6 +1469,13 @@ void SpatialPooler::load(istream &inStream) {
   // Current version
   version_ = 2;
 
+  // The binary format starts with a byte which can't start the text format.
+  inStream >> std::ws;
+  if (inStream.peek() == (unsigned char)binaryMagic[0]) {
+    loadBinary_(inStream);
+    return;
+  }
+
   // Check the marker
   string marker;
   inStream >> marker;
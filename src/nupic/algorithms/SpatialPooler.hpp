@@ -28,12 +28,14 @@
 #define NTA_spatial_pooler_HPP
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <iomanip> // std::setprecision
 #include <nupic/algorithms/Connections.hpp>
 #include <nupic/types/Types.hpp>
 #include <nupic/types/Serializable.hpp>
 #include <nupic/types/Sdr.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 
 namespace nupic {
@@ -279,6 +281,53 @@ public:
    */
   virtual void compute(const sdr::SDR &input, bool learn, sdr::SDR &active);
 
+  /**
+  Compute the active columns for a batch of inputs, without learning.
+
+  The result is the same as calling compute(inputs[i], false, actives[i]) for
+  every input in turn, including the iteration counter.  The overlaps of a
+  block of inputs are counted together with
+  Connections::computeActivityBatch, and the inputs are then inhibited in
+  parallel on the threads of the thread pool, if any.
+
+  getOverlaps and getBoostedOverlaps are not updated.
+
+  @param inputs SDRs which comprise the inputs to the spatial pooler.
+
+  @param actives Output: the winning columns for each input.  It is resized
+        to the number of inputs, and new SDRs have the column dimensions.
+   */
+  void computeBatch(const std::vector<sdr::SDR> &inputs,
+                    std::vector<sdr::SDR> &actives);
+
+
+  /**
+  Enable or disable multithreaded compute.
+
+  The per-column stages of compute (overlap, boosting, duty cycles, boost
+  factors, minimum duty cycles and inhibition radius) are split into
+  contiguous ranges of columns, one range per thread.  Inhibition and the
+  permanence updates which change the shared synapse bookkeeping always run
+  on the calling thread.  The output is identical to the serial path for any
+  number of threads.
+
+  The thread pool is not serialized.
+
+  @param numThreads Number of threads to use, including the caller.  Zero
+        uses all hardware threads.  One disables multithreading.
+   */
+  void setNumThreads(UInt numThreads);
+
+  /**
+  Use a thread pool owned by the caller, which may be shared with other
+  algorithms.  Pass nullptr to disable multithreading.
+   */
+  void setThreadPool(std::shared_ptr<ThreadPool> threadPool);
+
+  /**
+  @returns Number of threads used by compute, including the caller.
+   */
+  UInt getNumThreads() const;
 
   /**
    * Get the version number of this spatial pooler.
@@ -304,6 +353,16 @@ public:
    */
   virtual void load(istream &inStream) override;
 
+  /**
+  Save (serialize) the current state of the spatial pooler in a binary
+  format, which load() also reads.  It is much faster to write and to read
+  than save(), because the per-column arrays are written with single writes
+  and the connections with Connections::saveBinary().
+
+  @param outStream A valid ostream, opened in binary mode.
+   */
+  void saveBinary(ostream &outStream) const;
+
 
   /**
   Returns the number of bytes that a save operation would result in.
@@ -961,6 +1020,27 @@ public:
   void inhibitColumnsLocal_(const vector<Real> &overlaps, Real density,
                             vector<UInt> &activeColumns) const;
 
+  /**
+     Performs local inhibition by iterating over the neighborhood of every
+     column.  Supports any number of column dimensions, but the cost grows
+     with the size of the neighborhood.  Parameters are the same as for
+     inhibitColumnsLocal_.
+  */
+  void inhibitColumnsLocalNeighborhood_(const vector<Real> &overlaps,
+                                        Real density,
+                                        vector<UInt> &activeColumns) const;
+
+  /**
+     Performs local inhibition for 1-D and 2-D column topologies by counting
+     ranks with 2-D Fenwick trees.  Costs O(numColumns * log^2(numColumns)),
+     independent of the inhibition radius, and selects exactly the same
+     columns as inhibitColumnsLocalNeighborhood_, including its tie-breaking.
+     inhibitColumnsLocal_ uses it when the neighborhoods are large.
+     Parameters are the same as for inhibitColumnsLocal_.
+  */
+  void inhibitColumnsLocalRanked_(const vector<Real> &overlaps, Real density,
+                                  vector<UInt> &activeColumns) const;
+
   /**
       The primary method in charge of learning.
 
@@ -1072,6 +1152,13 @@ public:
   static void updateDutyCyclesHelper_(vector<Real> &dutyCycles,
                                       sdr::SDR &newValues, UInt period);
 
+  /**
+  Same as updateDutyCyclesHelper_, with the decay of all of the duty cycles
+  split over the thread pool.  The results are identical.
+  */
+  void updateDutyCyclesParallel_(vector<Real> &dutyCycles,
+                                 sdr::SDR &newValues, UInt period) const;
+
   /**
   Updates the duty cycles for each column. The OVERLAP duty cycle is a moving
   average of the number of inputs which overlapped with the each column. The
@@ -1164,6 +1251,17 @@ public:
   void printState(vector<Real> &state);
 
 protected:
+  /**
+  Run the task on contiguous ranges of [begin, end), on the thread pool if
+  one is set, otherwise on the calling thread.
+  */
+  void parallelFor_(UInt begin, UInt end, const ThreadPool::Task &task) const;
+
+  /**
+  Load the binary format of saveBinary().
+   */
+  void loadBinary_(istream &inStream);
+
   UInt numInputs_;
   UInt numColumns_;
   vector<UInt> columnDimensions_;
@@ -1213,6 +1311,8 @@ protected:
 
   UInt version_;
   Random rng_;
+
+  std::shared_ptr<ThreadPool> threadPool_;
 };
 
 } // end namespace spatial_pooler
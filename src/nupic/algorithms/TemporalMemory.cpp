@@ -42,6 +42,7 @@
 #include <vector>
 
 
+#include <nupic/algorithms/ConnectionsBinary.hpp>
 #include <nupic/algorithms/TemporalMemory.hpp>
 
 #include <nupic/utils/GroupBy.hpp>
@@ -61,7 +62,7 @@ using nupic::algorithms::connections::Permanence;
 using nupic::algorithms::connections::Synapse;
 
 
-static const UInt TM_VERSION = 2;
+static const UInt TM_VERSION = 3;
 
 template <typename Iterator>
 bool isSortedWithoutDuplicates(const Iterator begin, const Iterator end) {
@@ -150,7 +151,8 @@ void TemporalMemory::initialize(
   reset();
 }
 
-static CellIdx getLeastUsedCell(Random &rng, UInt column,
+template <typename RandomGenerator>
+static CellIdx getLeastUsedCell(RandomGenerator &rng, UInt column,
                                 const Connections &connections,
                                 UInt cellsPerColumn) {
   const CellIdx start = column * cellsPerColumn;
@@ -217,7 +219,7 @@ static void adaptSegment(Connections &connections, Segment segment,
   }
 }
 
-static void destroyMinPermanenceSynapses(Connections &connections, Random &rng,
+static void destroyMinPermanenceSynapses(Connections &connections,
                                          Segment segment, Int nDestroy,
                                          const vector<CellIdx> &excludeCells) {
   // Don't destroy any cells that are in excludeCells.
@@ -287,7 +289,7 @@ static void growSynapses(Connections &connections, Random &rng, Segment segment,
   const Int32 overrun =
       (connections.numSynapses(segment) + nActual - maxSynapsesPerSegment);
   if (overrun > 0) {
-    destroyMinPermanenceSynapses(connections, rng, segment, overrun,
+    destroyMinPermanenceSynapses(connections, segment, overrun,
                                  prevWinnerCells);
   }
 
@@ -448,6 +450,275 @@ static void punishPredictedColumn(
   }
 }
 
+/**
+ * Counter based random number stream for one column in one iteration.
+ *
+ * The stream is a SplitMix64 sequence whose starting point is a hash of
+ * (seed, iteration, column), so every column can draw its random numbers
+ * independently of the others, in any order and on any thread.
+ */
+class ColumnRandom {
+public:
+  ColumnRandom(UInt64 seed, UInt64 iteration, UInt64 column)
+    : state_(mix_(mix_(mix_(seed) ^ iteration) ^ column)) {}
+
+  UInt32 getUInt32(const UInt32 max) {
+    NTA_ASSERT(max > 0);
+    state_ += 0x9E3779B97F4A7C15ull;
+    return (UInt32)(((mix_(state_) >> 32) * max) >> 32);
+  }
+
+private:
+  static UInt64 mix_(UInt64 z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  UInt64 state_;
+};
+
+/**
+ * The changes which one column makes to the connections in one time step,
+ * planned from a read only view of the connections and applied later.
+ */
+struct ColumnUpdate {
+  struct SegmentUpdate {
+    Segment segment;             // Unused for new segments.
+    CellIdx cell;                // Cell for new segments.
+    bool newSegment;
+    bool adapt;
+    Permanence increment;
+    Permanence decrement;
+    bool grow;
+    UInt32 nActual;              // Synapses growSynapses would try to grow.
+    vector<CellIdx> newSynapses; // Presynaptic cells, in the order grown.
+  };
+
+  vector<CellIdx> activeCells;
+  vector<CellIdx> winnerCells;
+  vector<SegmentUpdate> segments;
+};
+
+/**
+ * Choose the synapses which adaptSegment followed by growSynapses would grow
+ * on a segment, without modifying the connections.
+ */
+static void chooseNewSynapses(ColumnUpdate::SegmentUpdate &update,
+                              ColumnRandom &rng,
+                              const Connections &connections,
+                              UInt32 nDesiredNewSynapses,
+                              const vector<bool> &prevActiveCellsDense,
+                              const vector<CellIdx> &prevWinnerCells,
+                              UInt maxSynapsesPerSegment) {
+  vector<CellIdx> candidates(prevWinnerCells.begin(), prevWinnerCells.end());
+  NTA_ASSERT(std::is_sorted(candidates.begin(), candidates.end()));
+
+  // Find the synapses which survive adaptSegment.  Remove their cells from
+  // the candidates, and count the ones destroyMinPermanenceSynapses could
+  // destroy.
+  UInt32 numSynapses = 0;
+  UInt32 numDestroyable = 0;
+  if (!update.newSegment) {
+    for (Synapse synapse : connections.synapsesForSegment(update.segment)) {
+      const SynapseData &synapseData = connections.dataForSynapse(synapse);
+      if (update.adapt) {
+        Permanence permanence = synapseData.permanence;
+        if (prevActiveCellsDense[synapseData.presynapticCell]) {
+          permanence += update.increment;
+        } else {
+          permanence -= update.decrement;
+        }
+        permanence = min(permanence, (Permanence)1.0);
+        permanence = max(permanence, (Permanence)0.0);
+        if (permanence < nupic::Epsilon) {
+          continue;
+        }
+      }
+      numSynapses++;
+      const CellIdx presynapticCell = synapseData.presynapticCell;
+      auto ineligible =
+          std::lower_bound(candidates.begin(), candidates.end(), presynapticCell);
+      if (ineligible != candidates.end() && *ineligible == presynapticCell) {
+        candidates.erase(ineligible);
+      }
+      if (!std::binary_search(prevWinnerCells.begin(), prevWinnerCells.end(),
+                              presynapticCell)) {
+        numDestroyable++;
+      }
+    }
+  }
+
+  const UInt32 nActual =
+      std::min(nDesiredNewSynapses, (UInt32)candidates.size());
+  update.nActual = nActual;
+
+  const Int32 overrun = (numSynapses + nActual - maxSynapsesPerSegment);
+  if (overrun > 0) {
+    numSynapses -= std::min((UInt32)overrun, numDestroyable);
+  }
+  const UInt32 nActualWithMax =
+      std::min(nActual, maxSynapsesPerSegment - numSynapses);
+
+  update.newSynapses.clear();
+  for (UInt32 c = 0; c < nActualWithMax; c++) {
+    UInt32 i = rng.getUInt32((UInt32)candidates.size());
+    update.newSynapses.push_back(candidates[i]);
+    candidates.erase(candidates.begin() + i);
+  }
+}
+
+/**
+ * Plan one column of activateCells, like activatePredictedColumn,
+ * burstColumn and punishPredictedColumn but without modifying the
+ * connections.
+ */
+static void planColumn(
+    ColumnUpdate &update, ColumnRandom &rng, UInt column, bool isActiveColumn,
+    vector<Segment>::const_iterator columnActiveSegmentsBegin,
+    vector<Segment>::const_iterator columnActiveSegmentsEnd,
+    vector<Segment>::const_iterator columnMatchingSegmentsBegin,
+    vector<Segment>::const_iterator columnMatchingSegmentsEnd,
+    const Connections &connections,
+    const vector<bool> &prevActiveCellsDense,
+    const vector<CellIdx> &prevWinnerCells,
+    const vector<UInt32> &numActivePotentialSynapsesForSegment,
+    UInt cellsPerColumn, UInt maxNewSynapseCount,
+    Permanence permanenceIncrement, Permanence permanenceDecrement,
+    Permanence predictedSegmentDecrement, UInt maxSynapsesPerSegment,
+    bool learn) {
+  const auto adaptAndGrow = [&](Segment segment) {
+    ColumnUpdate::SegmentUpdate segmentUpdate;
+    segmentUpdate.segment    = segment;
+    segmentUpdate.newSegment = false;
+    segmentUpdate.adapt      = true;
+    segmentUpdate.increment  = permanenceIncrement;
+    segmentUpdate.decrement  = permanenceDecrement;
+    const Int32 nGrowDesired =
+        maxNewSynapseCount - numActivePotentialSynapsesForSegment[segment];
+    segmentUpdate.grow = nGrowDesired > 0;
+    if (segmentUpdate.grow) {
+      chooseNewSynapses(segmentUpdate, rng, connections, nGrowDesired,
+                        prevActiveCellsDense, prevWinnerCells,
+                        maxSynapsesPerSegment);
+    }
+    update.segments.push_back(std::move(segmentUpdate));
+  };
+
+  if (!isActiveColumn) {
+    // Punish the matching segments of a predicted but inactive column.
+    if (learn && predictedSegmentDecrement > 0.0) {
+      for (auto segment = columnMatchingSegmentsBegin;
+           segment != columnMatchingSegmentsEnd; segment++) {
+        ColumnUpdate::SegmentUpdate segmentUpdate;
+        segmentUpdate.segment    = *segment;
+        segmentUpdate.newSegment = false;
+        segmentUpdate.adapt      = true;
+        segmentUpdate.increment  = -predictedSegmentDecrement;
+        segmentUpdate.decrement  = 0.0;
+        segmentUpdate.grow       = false;
+        update.segments.push_back(std::move(segmentUpdate));
+      }
+    }
+    return;
+  }
+
+  if (columnActiveSegmentsBegin != columnActiveSegmentsEnd) {
+    // Predicted column.
+    for (auto segment = columnActiveSegmentsBegin;
+         segment != columnActiveSegmentsEnd; segment++) {
+      const CellIdx cell = connections.cellForSegment(*segment);
+      if (update.activeCells.empty() || update.activeCells.back() != cell) {
+        update.activeCells.push_back(cell);
+        update.winnerCells.push_back(cell);
+      }
+      if (learn) {
+        adaptAndGrow(*segment);
+      }
+    }
+    return;
+  }
+
+  // Bursting column.
+  const CellIdx start = column * cellsPerColumn;
+  for (CellIdx cell = start; cell < start + cellsPerColumn; cell++) {
+    update.activeCells.push_back(cell);
+  }
+
+  const auto bestMatchingSegment =
+      std::max_element(columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
+                       [&](Segment a, Segment b) {
+                         return (numActivePotentialSynapsesForSegment[a] <
+                                 numActivePotentialSynapsesForSegment[b]);
+                       });
+
+  const CellIdx winnerCell =
+      (bestMatchingSegment != columnMatchingSegmentsEnd)
+          ? connections.cellForSegment(*bestMatchingSegment)
+          : getLeastUsedCell(rng, column, connections, cellsPerColumn);
+  update.winnerCells.push_back(winnerCell);
+
+  if (!learn) {
+    return;
+  }
+  if (bestMatchingSegment != columnMatchingSegmentsEnd) {
+    adaptAndGrow(*bestMatchingSegment);
+  } else {
+    // Don't grow a segment that will never match.
+    const UInt32 nGrowExact =
+        std::min(maxNewSynapseCount, (UInt32)prevWinnerCells.size());
+    if (nGrowExact > 0) {
+      ColumnUpdate::SegmentUpdate segmentUpdate;
+      segmentUpdate.cell       = winnerCell;
+      segmentUpdate.newSegment = true;
+      segmentUpdate.adapt      = false;
+      segmentUpdate.grow       = true;
+      chooseNewSynapses(segmentUpdate, rng, connections, nGrowExact,
+                        prevActiveCellsDense, prevWinnerCells,
+                        maxSynapsesPerSegment);
+      update.segments.push_back(std::move(segmentUpdate));
+    }
+  }
+}
+
+/**
+ * Apply the planned changes of one column to the connections.
+ */
+static void applyColumnUpdate(
+    Connections &connections, vector<UInt64> &lastUsedIterationForSegment,
+    const ColumnUpdate &update,
+    const vector<bool> &prevActiveCellsDense,
+    const vector<CellIdx> &prevWinnerCells,
+    UInt64 iteration, Permanence initialPermanence,
+    UInt maxSegmentsPerCell, UInt maxSynapsesPerSegment) {
+  for (const auto &segmentUpdate : update.segments) {
+    Segment segment = segmentUpdate.segment;
+    if (segmentUpdate.newSegment) {
+      segment = createSegment(connections, lastUsedIterationForSegment,
+                              segmentUpdate.cell, iteration, maxSegmentsPerCell);
+    }
+    if (segmentUpdate.adapt) {
+      adaptSegment(connections, segment, prevActiveCellsDense,
+                   segmentUpdate.increment, segmentUpdate.decrement);
+    }
+    if (segmentUpdate.grow) {
+      // As growSynapses, with the cells chosen in advance.
+      const Int32 overrun = (connections.numSynapses(segment) +
+                             segmentUpdate.nActual - maxSynapsesPerSegment);
+      if (overrun > 0) {
+        destroyMinPermanenceSynapses(connections, segment, overrun,
+                                     prevWinnerCells);
+      }
+      NTA_ASSERT(segmentUpdate.newSynapses.size() ==
+                 std::min(segmentUpdate.nActual,
+                          maxSynapsesPerSegment - connections.numSynapses(segment)));
+      for (const CellIdx cell : segmentUpdate.newSynapses) {
+        connections.createSynapse(segment, cell, initialPermanence);
+      }
+    }
+  }
+}
+
 void TemporalMemory::activateCells(const SDR &activeColumns, bool learn) {
     NTA_CHECK( activeColumns.dimensions == columnDimensions_ );
     const auto &sparse = activeColumns.getSparse();
@@ -475,6 +746,13 @@ void TemporalMemory::activateCells(const size_t activeColumnsSize,
     return connections.cellForSegment(segment) / cellsPerColumn_;
   };
 
+  if (columnRandomStreams_) {
+    activateColumnsStaged_(activeColumnsSize, activeColumns,
+                           prevActiveCellsDense, prevWinnerCells, learn);
+    segmentsValid_ = false;
+    return;
+  }
+
   for (auto &columnData : iterGroupBy( //TODO explain this
            activeColumns, activeColumns + activeColumnsSize, identity<UInt>,
            activeSegments_.begin(), activeSegments_.end(), columnForSegment,
@@ -521,6 +799,79 @@ void TemporalMemory::activateCells(const size_t activeColumnsSize,
   segmentsValid_ = false;
 }
 
+void TemporalMemory::activateColumnsStaged_(
+    const size_t activeColumnsSize, const UInt activeColumns[],
+    const vector<bool> &prevActiveCellsDense,
+    const vector<CellIdx> &prevWinnerCells, bool learn) {
+  const auto columnForSegment = [&](Segment segment) {
+    return connections.cellForSegment(segment) / cellsPerColumn_;
+  };
+
+  struct ColumnSegments {
+    UInt column;
+    bool isActive;
+    vector<Segment>::const_iterator activeBegin, activeEnd;
+    vector<Segment>::const_iterator matchingBegin, matchingEnd;
+  };
+  vector<ColumnSegments> columns;
+  for (auto &columnData : iterGroupBy(
+           activeColumns, activeColumns + activeColumnsSize, identity<UInt>,
+           activeSegments_.cbegin(), activeSegments_.cend(), columnForSegment,
+           matchingSegments_.cbegin(), matchingSegments_.cend(),
+           columnForSegment)) {
+    ColumnSegments c;
+    const UInt *activeColumnsBegin;
+    const UInt *activeColumnsEnd;
+    tie(c.column, activeColumnsBegin, activeColumnsEnd, c.activeBegin,
+        c.activeEnd, c.matchingBegin, c.matchingEnd) = columnData;
+    c.isActive = activeColumnsBegin != activeColumnsEnd;
+    columns.push_back(c);
+  }
+
+  // Plan the columns independently, each with its own random stream, so
+  // they can run on any number of threads with the same results.
+  const UInt64 seed = rng_.getSeed();
+  vector<ColumnUpdate> updates(columns.size());
+  const auto planColumns = [&](UInt begin, UInt end, UInt) {
+    for (UInt i = begin; i < end; i++) {
+      const ColumnSegments &c = columns[i];
+      ColumnRandom rng(seed, iteration_, c.column);
+      planColumn(updates[i], rng, c.column, c.isActive, c.activeBegin,
+                 c.activeEnd, c.matchingBegin, c.matchingEnd, connections,
+                 prevActiveCellsDense, prevWinnerCells,
+                 numActivePotentialSynapsesForSegment_, cellsPerColumn_,
+                 maxNewSynapseCount_, permanenceIncrement_,
+                 permanenceDecrement_, predictedSegmentDecrement_,
+                 maxSynapsesPerSegment_, learn);
+    }
+  };
+  if (threadPool_) {
+    threadPool_->parallelFor(0u, (UInt)columns.size(), planColumns);
+  } else {
+    planColumns(0u, (UInt)columns.size(), 0u);
+  }
+
+  // Apply the changes in column order.
+  for (const auto &update : updates) {
+    activeCells_.insert(activeCells_.end(), update.activeCells.begin(),
+                        update.activeCells.end());
+    winnerCells_.insert(winnerCells_.end(), update.winnerCells.begin(),
+                        update.winnerCells.end());
+    applyColumnUpdate(connections, lastUsedIterationForSegment_, update,
+                      prevActiveCellsDense, prevWinnerCells, iteration_,
+                      initialPermanence_, maxSegmentsPerCell_,
+                      maxSynapsesPerSegment_);
+  }
+}
+
+void TemporalMemory::setColumnRandomStreams(bool columnRandomStreams) {
+  columnRandomStreams_ = columnRandomStreams;
+}
+
+bool TemporalMemory::getColumnRandomStreams() const {
+  return columnRandomStreams_;
+}
+
 void TemporalMemory::activateDendrites(bool learn,
                                        const SDR &extraActive,
                                        const SDR &extraWinners)
@@ -547,6 +898,19 @@ void TemporalMemory::activateDendrites(bool learn,
   if( segmentsValid_ )
     return;
 
+  // The segment numbers are only held in the segment bookkeeping here, as
+  // the active and matching segments are about to be recomputed.
+  if( connections.needsCompaction() ) {
+    const vector<Segment> remap = connections.compact();
+    vector<UInt64> lastUsedIteration( connections.segmentFlatListLength(), 0u );
+    const Size length = std::min( remap.size(), lastUsedIterationForSegment_.size() );
+    for( Segment segment = 0u; segment < length; segment++ ) {
+      if( remap[segment] != Connections::INVALID_SEGMENT )
+        lastUsedIteration[remap[segment]] = lastUsedIterationForSegment_[segment];
+    }
+    lastUsedIterationForSegment_.swap( lastUsedIteration );
+  }
+
   // Handle external predictive inputs.  extraActive & extraWinners default
   // values are `vector({ SENTINEL })`
   const auto SENTINEL = std::numeric_limits<UInt>::max();
@@ -577,22 +941,44 @@ void TemporalMemory::activateDendrites(bool learn,
 
   numActiveConnectedSynapsesForSegment_.assign(length, 0);
   numActivePotentialSynapsesForSegment_.assign(length, 0);
-  connections.computeActivity(numActiveConnectedSynapsesForSegment_,
-                              numActivePotentialSynapsesForSegment_,
-                              activeCells_, connectedPermanence_);
-
-  // Active segments, connected synapses.
-  activeSegments_.clear();
-  for (Segment segment = 0;
-       segment < numActiveConnectedSynapsesForSegment_.size(); segment++) {
-    if (numActiveConnectedSynapsesForSegment_[segment] >=
-        activationThreshold_) {
-      activeSegments_.push_back(segment);
+  if( threadPool_ ) {
+    connections.computeActivity(numActiveConnectedSynapsesForSegment_,
+                                numActivePotentialSynapsesForSegment_,
+                                activeCells_, connectedPermanence_,
+                                *threadPool_);
+    findSegmentsParallel_();
+  }
+  else {
+    connections.computeActivity(numActiveConnectedSynapsesForSegment_,
+                                numActivePotentialSynapsesForSegment_,
+                                activeCells_, connectedPermanence_);
+
+    // Active segments, connected synapses.
+    activeSegments_.clear();
+    for (Segment segment = 0;
+         segment < numActiveConnectedSynapsesForSegment_.size(); segment++) {
+      if (numActiveConnectedSynapsesForSegment_[segment] >=
+          activationThreshold_) {
+        activeSegments_.push_back(segment);
+      }
+    }
+    std::sort(
+        activeSegments_.begin(), activeSegments_.end(),
+        [&](Segment a, Segment b) { return connections.compareSegments(a, b); });
+
+    // Matching segments, potential synapses.
+    matchingSegments_.clear();
+    for (Segment segment = 0;
+         segment < numActivePotentialSynapsesForSegment_.size(); segment++) {
+      if (numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
+        matchingSegments_.push_back(segment);
+      }
     }
+    std::sort(
+        matchingSegments_.begin(), matchingSegments_.end(),
+        [&](Segment a, Segment b) { return connections.compareSegments(a, b); });
   }
-  std::sort(
-      activeSegments_.begin(), activeSegments_.end(),
-      [&](Segment a, Segment b) { return connections.compareSegments(a, b); });
+
   // Update segment bookkeeping.
   if (learn) {
     for (const auto &segment : activeSegments_) {
@@ -601,19 +987,55 @@ void TemporalMemory::activateDendrites(bool learn,
     iteration_++;
   }
 
-  // Matching segments, potential synapses.
+  segmentsValid_ = true;
+}
+
+void TemporalMemory::findSegmentsParallel_() {
+  // Each thread visits a range of cells in order, and the segments of each
+  // cell in order of creation.  That is the order of compareSegments, so the
+  // lists come out sorted, and concatenating the threads' lists in thread
+  // order keeps them sorted.
+  const UInt numThreads = threadPool_->numThreads();
+  vector<vector<Segment>> active( numThreads );
+  vector<vector<Segment>> matching( numThreads );
+  threadPool_->parallelFor(0u, connections.numCells(),
+    [&](UInt begin, UInt end, UInt thread) {
+      for (CellIdx cell = begin; cell < end; cell++) {
+        for (const Segment segment : connections.segmentsForCell(cell)) {
+          if (numActiveConnectedSynapsesForSegment_[segment] >=
+              activationThreshold_) {
+            active[thread].push_back(segment);
+          }
+          if (numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
+            matching[thread].push_back(segment);
+          }
+        }
+      }
+  });
+
+  activeSegments_.clear();
   matchingSegments_.clear();
-  for (Segment segment = 0;
-       segment < numActivePotentialSynapsesForSegment_.size(); segment++) {
-    if (numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
-      matchingSegments_.push_back(segment);
-    }
+  for (UInt thread = 0; thread < numThreads; thread++) {
+    activeSegments_.insert(activeSegments_.end(),
+                           active[thread].begin(), active[thread].end());
+    matchingSegments_.insert(matchingSegments_.end(),
+                             matching[thread].begin(), matching[thread].end());
   }
-  std::sort(
-      matchingSegments_.begin(), matchingSegments_.end(),
-      [&](Segment a, Segment b) { return connections.compareSegments(a, b); });
+}
 
-  segmentsValid_ = true;
+void TemporalMemory::setNumThreads(UInt numThreads) {
+  if( numThreads == 1u )
+    threadPool_.reset();
+  else
+    threadPool_ = std::make_shared<ThreadPool>( numThreads );
+}
+
+void TemporalMemory::setThreadPool(std::shared_ptr<ThreadPool> threadPool) {
+  threadPool_ = threadPool;
+}
+
+UInt TemporalMemory::getNumThreads() const {
+  return threadPool_ ? threadPool_->numThreads() : 1u;
 }
 
 void TemporalMemory::compute(const size_t        activeColumnsSize,
@@ -844,6 +1266,7 @@ void TemporalMemory::save(ostream &outStream) const {
   outStream << extra_ << " ";
   outStream << maxSegmentsPerCell_ << " " << maxSynapsesPerSegment_ << " "
             << iteration_ << " ";
+  outStream << columnRandomStreams_ << " ";
 
   outStream << endl;
 
@@ -904,7 +1327,151 @@ void TemporalMemory::save(ostream &outStream) const {
 
 
 
+namespace {
+/**
+ * Start of the binary format, with the high bit set like that of Connections.
+ */
+const char binaryMagic[8] = { '\x89', 'N', 'T', 'A', 'T', 'M', 'M', '\n' };
+const char binaryEndMagic[8] = { '~', 'N', 'T', 'A', 'T', 'M', 'M', '\n' };
+const UInt32 BINARY_VERSION = 1u;
+
+template <typename T>
+T valueOrZero(const vector<T> &values, const Segment segment) {
+  return segment < values.size() ? values[segment] : (T)0u;
+}
+} // end anonymous namespace
+
+void TemporalMemory::saveBinary(ostream &outStream) const {
+  using namespace nupic::algorithms::connections::binary;
+  outStream.write( binaryMagic, sizeof(binaryMagic) );
+  writeValue( outStream, BINARY_VERSION );
+  writeValue( outStream, (Byte)sizeof(UInt) );
+
+  for( const UInt value : { numColumns_, cellsPerColumn_, activationThreshold_,
+                            minThreshold_, maxNewSynapseCount_, extra_,
+                            maxSegmentsPerCell_, maxSynapsesPerSegment_ })
+    writeValue( outStream, value );
+  writeValue( outStream, iteration_ );
+  for( const Permanence value : { initialPermanence_, connectedPermanence_,
+                                  permanenceIncrement_, permanenceDecrement_,
+                                  predictedSegmentDecrement_ })
+    writeValue( outStream, value );
+  writeValue( outStream, (Byte)checkInputs_ );
+  writeValue( outStream, (Byte)columnRandomStreams_ );
+  writeValue( outStream, (Byte)segmentsValid_ );
+
+  writeVector( outStream, columnDimensions_ );
+
+  connections.saveBinary( outStream );
+
+  // Random is only serializable as text.
+  stringstream rng;
+  rng << rng_;
+  const string &rngState = rng.str();
+  writeVector( outStream, vector<char>( rngState.begin(), rngState.end() ));
+
+  writeVector( outStream, activeCells_ );
+  writeVector( outStream, winnerCells_ );
+
+  // The per segment state, in the segment numbering of the loaded connections,
+  // which is the order of the cells.
+  vector<Segment> loadedSegment( connections.segmentFlatListLength() );
+  vector<UInt32> numActiveConnected, numActivePotential;
+  vector<UInt64> lastUsedIteration;
+  numActiveConnected.reserve( connections.numSegments() );
+  numActivePotential.reserve( connections.numSegments() );
+  lastUsedIteration.reserve( connections.numSegments() );
+  for( CellIdx cell = 0u; cell < connections.numCells(); cell++ ) {
+    for( const Segment segment : connections.segmentsForCell( cell )) {
+      loadedSegment[segment] = (Segment)lastUsedIteration.size();
+      numActiveConnected.push_back( valueOrZero( numActiveConnectedSynapsesForSegment_, segment ));
+      numActivePotential.push_back( valueOrZero( numActivePotentialSynapsesForSegment_, segment ));
+      lastUsedIteration.push_back( valueOrZero( lastUsedIterationForSegment_, segment ));
+    }
+  }
+  vector<Segment> activeSegments, matchingSegments;
+  activeSegments.reserve( activeSegments_.size() );
+  matchingSegments.reserve( matchingSegments_.size() );
+  for( const Segment segment : activeSegments_ )
+    activeSegments.push_back( loadedSegment[segment] );
+  for( const Segment segment : matchingSegments_ )
+    matchingSegments.push_back( loadedSegment[segment] );
+  writeVector( outStream, activeSegments );
+  writeVector( outStream, matchingSegments );
+  writeVector( outStream, numActiveConnected );
+  writeVector( outStream, numActivePotential );
+  writeVector( outStream, lastUsedIteration );
+
+  outStream.write( binaryEndMagic, sizeof(binaryEndMagic) );
+}
+
+void TemporalMemory::loadBinary_(istream &inStream) {
+  using namespace nupic::algorithms::connections::binary;
+  char magic[sizeof(binaryMagic)];
+  read( inStream, magic, sizeof(magic) );
+  NTA_CHECK( std::equal( magic, magic + sizeof(magic), binaryMagic ))
+    << "TemporalMemory: not in the binary format.";
+  const UInt32 version = readValue<UInt32>( inStream );
+  NTA_CHECK( version <= BINARY_VERSION )
+    << "TemporalMemory: unsupported binary version " << version;
+  NTA_CHECK( (Size)readValue<Byte>( inStream ) == sizeof(UInt) )
+    << "TemporalMemory: saved with another size of UInt.";
+
+  for( UInt *value : { &numColumns_, &cellsPerColumn_, &activationThreshold_,
+                       &minThreshold_, &maxNewSynapseCount_, &extra_,
+                       &maxSegmentsPerCell_, &maxSynapsesPerSegment_ })
+    *value = readValue<UInt>( inStream );
+  iteration_ = readValue<UInt64>( inStream );
+  for( Permanence *value : { &initialPermanence_, &connectedPermanence_,
+                             &permanenceIncrement_, &permanenceDecrement_,
+                             &predictedSegmentDecrement_ })
+    *value = readValue<Permanence>( inStream );
+  checkInputs_         = readValue<Byte>( inStream ) != 0;
+  columnRandomStreams_ = readValue<Byte>( inStream ) != 0;
+  segmentsValid_       = readValue<Byte>( inStream ) != 0;
+
+  readVector( inStream, columnDimensions_ );
+
+  connections.load( inStream );
+  NTA_CHECK( connections.numCells() == numColumns_ * cellsPerColumn_ )
+    << "TemporalMemory: corrupt binary data.";
+
+  vector<char> rngState;
+  readVector( inStream, rngState );
+  stringstream rng( string( rngState.begin(), rngState.end() ));
+  rng >> rng_;
+
+  readVector( inStream, activeCells_ );
+  readVector( inStream, winnerCells_ );
+  readVector( inStream, activeSegments_ );
+  readVector( inStream, matchingSegments_ );
+  readVector( inStream, numActiveConnectedSynapsesForSegment_ );
+  readVector( inStream, numActivePotentialSynapsesForSegment_ );
+  readVector( inStream, lastUsedIterationForSegment_ );
+  const Size numSegments = connections.segmentFlatListLength();
+  NTA_CHECK( numActiveConnectedSynapsesForSegment_.size() == numSegments &&
+             numActivePotentialSynapsesForSegment_.size() == numSegments &&
+             lastUsedIterationForSegment_.size() == numSegments )
+    << "TemporalMemory: corrupt binary data.";
+  for( const auto *segments : { &activeSegments_, &matchingSegments_ }) {
+    for( const Segment segment : *segments ) {
+      NTA_CHECK( segment < numSegments ) << "TemporalMemory: corrupt binary data.";
+    }
+  }
+
+  read( inStream, magic, sizeof(magic) );
+  NTA_CHECK( std::equal( magic, magic + sizeof(magic), binaryEndMagic ))
+    << "TemporalMemory: corrupt binary data.";
+}
+
 void TemporalMemory::load(istream &inStream) {
+  // The binary format starts with a byte which can't start the text format.
+  inStream >> std::ws;
+  if (inStream.peek() == (unsigned char)binaryMagic[0]) {
+    loadBinary_(inStream);
+    return;
+  }
+
   // Check the marker
   string marker;
   inStream >> marker;
@@ -921,6 +1488,10 @@ void TemporalMemory::load(istream &inStream) {
       maxNewSynapseCount_ >> checkInputs_ >> permanenceIncrement_ >>
       permanenceDecrement_ >> predictedSegmentDecrement_ >> extra_ >>
       maxSegmentsPerCell_ >> maxSynapsesPerSegment_ >> iteration_;
+  columnRandomStreams_ = false;
+  if (version >= 3) {
+    inStream >> columnRandomStreams_;
+  }
 
   connections.load(inStream);
 
@@ -1047,7 +1618,8 @@ bool TemporalMemory::operator==(const TemporalMemory &other) {
       winnerCells_ != other.winnerCells_ ||
       maxSegmentsPerCell_ != other.maxSegmentsPerCell_ ||
       maxSynapsesPerSegment_ != other.maxSynapsesPerSegment_ ||
-      iteration_ != other.iteration_) {
+      iteration_ != other.iteration_ ||
+      columnRandomStreams_ != other.columnRandomStreams_) {
     return false;
   }
 
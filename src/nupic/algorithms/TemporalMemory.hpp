@@ -32,6 +32,8 @@
 #include <nupic/types/Sdr.hpp>
 #include <nupic/types/Serializable.hpp>
 #include <nupic/utils/Random.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+#include <memory>
 #include <vector>
 
 
@@ -276,6 +278,48 @@ public:
   virtual void compute(const sdr::SDR &activeColumns, bool learn,
                        const sdr::SDR &extraActive, const sdr::SDR &extraWinners);
 
+  /**
+   * Enable or disable multithreaded compute.
+   *
+   * activateDendrites splits the segment activity counting and the search
+   * for active and matching segments across the threads.  With
+   * setColumnRandomStreams, activateCells also plans the columns on the
+   * threads.  The results are identical to the serial path for any number
+   * of threads.
+   *
+   * The thread pool is not serialized.
+   *
+   * @param numThreads Number of threads to use, including the caller.  Zero
+   * uses all hardware threads.  One disables multithreading.
+   */
+  void setNumThreads(UInt numThreads);
+
+  /**
+   * Use a thread pool owned by the caller, which may be shared with other
+   * algorithms.  Pass nullptr to disable multithreading.
+   */
+  void setThreadPool(std::shared_ptr<ThreadPool> threadPool);
+
+  /**
+   * @returns Number of threads used by compute, including the caller.
+   */
+  UInt getNumThreads() const;
+
+  /**
+   * Draw the random numbers of activateCells from a separate stream for each
+   * column, derived from (seed, iteration, column), instead of from the
+   * single shared random generator.
+   *
+   * Each column's changes to the connections are then planned independently
+   * and applied in column order, so the columns are planned in parallel
+   * when a thread pool is set.  The results are the same for any number of
+   * threads, but differ from the results with the shared generator.
+   *
+   * This setting is serialized.  It is off by default.
+   */
+  void setColumnRandomStreams(bool columnRandomStreams);
+  bool getColumnRandomStreams() const;
+
   // ==============================
   //  Helper functions
   // ==============================
@@ -459,6 +503,17 @@ public:
    */
   virtual void load(istream &inStream) override;
 
+  /**
+   * Save (serialize) the current state of the temporal memory in a binary
+   * format, which load() also reads.  It is much faster to write and to read
+   * than save(), because the arrays are written with single writes and the
+   * connections with Connections::saveBinary().  Unlike save(), it also keeps
+   * the segment activity and the last used iteration of every segment.
+   *
+   * @param outStream A valid ostream, opened in binary mode.
+   */
+  void saveBinary(ostream &outStream) const;
+
   bool operator==(const TemporalMemory &other);
   bool operator!=(const TemporalMemory &other);
 
@@ -481,6 +536,27 @@ public:
   UInt columnForCell(const CellIdx cell) const;
 
 protected:
+  /**
+   * Find the active and matching segments from the segment activity, already
+   * sorted, on the thread pool.
+   */
+  void findSegmentsParallel_();
+
+  /**
+   * Load the binary format of saveBinary().
+   */
+  void loadBinary_(istream &inStream);
+
+  /**
+   * The part of activateCells which walks the columns, when
+   * columnRandomStreams_ is set.
+   */
+  void activateColumnsStaged_(const size_t activeColumnsSize,
+                              const UInt activeColumns[],
+                              const vector<bool> &prevActiveCellsDense,
+                              const vector<CellIdx> &prevWinnerCells,
+                              bool learn);
+
   UInt numColumns_;
   vector<UInt> columnDimensions_;
   UInt cellsPerColumn_;
@@ -509,6 +585,9 @@ protected:
   vector<UInt64> lastUsedIterationForSegment_;
 
   Random rng_;
+  bool columnRandomStreams_ = false;
+
+  std::shared_ptr<ThreadPool> threadPool_;
 
 public:
   Connections connections;
@@ -105,6 +105,9 @@ std::shared_ptr<Link> Input::findLink(const std::string &srcRegionName,
 }
 
 void Input::prepare() {
+  // A fan-in view reads the source outputs directly.
+  if (fanInView_)
+    return;
   // Each link copies data into its section of the overall input
   // TODO: initialization check?
   for (auto &elem : links_) {
@@ -309,7 +312,8 @@ void Input::initialize() {
   dim_ = inD;
 
   if (data_.getType() == NTA_BasicType_SDR) {
-    data_.allocateBuffer(dim_);
+    if (!is_FanIn || !initializeFanInView_())
+      data_.allocateBuffer(dim_);
   } else if (dim_.isDontcare()) {
     data_.allocateBuffer(0);  // lets hope this is an unused input.
   } else {
@@ -328,6 +332,34 @@ void Input::uninitialize() {
 
   initialized_ = false;
   data_.releaseBuffer();
+  releaseFanInView_();
+}
+
+bool Input::initializeFanInView_() {
+  for (const auto &link : links_) {
+    const Array &src = link->getSrc().getData();
+    if (link->getPropagationDelay() != 0 ||
+        src.getType() != NTA_BasicType_SDR || !src.has_buffer())
+      return false;
+  }
+  // The copying path appends the source buffers, which is a concatenation
+  // of the flattened sources along axis 0.
+  std::vector<sdr::SDR *> sources;
+  for (const auto &link : links_) {
+    sdr::SDR &src = link->getSrc().getData().getSDR();
+    fanInSources_.emplace_back(new sdr::Reshape(src, {src.size}));
+    sources.push_back(fanInSources_.back().get());
+  }
+  fanInConcatenation_.reset(new sdr::Concatenation(sources, 0u));
+  fanInView_.reset(new sdr::Reshape(*fanInConcatenation_, dim_));
+  data_.setView(*fanInView_);
+  return true;
+}
+
+void Input::releaseFanInView_() {
+  fanInView_.reset();
+  fanInConcatenation_.reset();
+  fanInSources_.clear();
 }
 
 namespace nupic {
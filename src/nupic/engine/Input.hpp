@@ -31,7 +31,9 @@
 
 #include <nupic/engine/Region.hpp>
 #include <nupic/ntypes/Array.hpp>
+#include <nupic/types/SdrTools.hpp>
 #include <nupic/types/Types.hpp>
+#include <memory>
 #include <vector>
 
 namespace nupic {
@@ -230,6 +232,13 @@ private:
   Dimensions dim_;
   Array data_;
 
+  // Zero-copy fan-in of SDR links. data_ wraps fanInView_, which shows the
+  // concatenation of the flattened source outputs in dim_ dimensions.
+  // Declared in dependency order so they are destroyed view first.
+  std::vector<std::unique_ptr<sdr::Reshape>> fanInSources_;
+  std::unique_ptr<sdr::Concatenation> fanInConcatenation_;
+  std::unique_ptr<sdr::Reshape> fanInView_;
+
   // Useful for us to know our own name
   std::string name_;
 
@@ -243,6 +252,14 @@ private:
    * but does not affect the links.
    */
   void uninitialize();
+
+  /*
+   * Presents a fan-in of SDR links without delay as a view onto the source
+   * outputs, so prepare() has nothing to copy. Returns false if any link
+   * needs the copying path.
+   */
+  bool initializeFanInView_();
+  void releaseFanInView_();
 };
 
 } // namespace nupic
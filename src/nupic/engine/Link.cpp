@@ -59,9 +59,12 @@ Link::Link(const std::string &linkType, const std::string &linkParams,
 
 Link::Link() {  // needed for deserialization
   destOffset_ = 0;
+  delayHead_ = 0;
   src_ = nullptr;
   dest_ = nullptr;
   initialized_ = false;
+  profilingEnabled_ = false;
+  tracingEnabled_ = false;
 }
 
 void Link::commonConstructorInit_(const std::string &linkType,
@@ -78,12 +81,14 @@ void Link::commonConstructorInit_(const std::string &linkType,
   destRegionName_ = destRegionName;
   destInputName_ = destInputName;
   propagationDelay_ = propagationDelay;
+  delayHead_ = 0;
   destOffset_ = 0;
   is_FanIn_ = false;
   src_ = nullptr;
   dest_ = nullptr;
   initialized_ = false;
-
+  profilingEnabled_ = false;
+  tracingEnabled_ = false;
 }
 
 
@@ -114,8 +119,10 @@ void Link::initialize(size_t destinationOffset, bool is_FanIn) {
     // because the buffer size is not known prior to then.
     // front of queue will be the next value to be copied to the dest Input buffer.
     // back of queue will be the same as the current contents of source Output.
+    // One more buffer is the spare, see propagationDelayBuffer_.
     Array &output_buffer = src_->getData();
-    for (size_t i = 0; i < (propagationDelay_); i++) {
+    delayHead_ = 0;
+    for (size_t i = 0; i < propagationDelay_ + 1; i++) {
       Array delayedbuffer = output_buffer.copy();
       delayedbuffer.zeroBuffer();
       propagationDelayBuffer_.push_back(delayedbuffer);
@@ -184,16 +191,27 @@ Input &Link::getDest() const {
 
 
 void Link::compute() {
+  if (!profilingEnabled_) {
+    compute_();
+    return;
+  }
+  const UInt64 start = profile::now();
+  const UInt64 allocations = ArrayBase::getAllocationCount();
+  profile_.bytesCopied += compute_();
+  recordProfile_(profile_.compute, "compute", start, allocations);
+}
+
+size_t Link::compute_() {
   NTA_CHECK(initialized_);
 
   if (propagationDelay_) {
-    // A delayed link's queue buffer size should always be number of delays.
-    NTA_CHECK(propagationDelayBuffer_.size() == (propagationDelay_));
+    // A delayed link's ring has a buffer per delay, plus the spare.
+    NTA_CHECK(propagationDelayBuffer_.size() == propagationDelay_ + 1);
   }
 
   // Copy data from source to destination. For delayed links, will copy from
   // head of circular queue; otherwise directly from source.
-  const Array &src = propagationDelay_ ? propagationDelayBuffer_.front() : src_->getData();
+  const Array &src = propagationDelay_ ? propagationDelayBuffer_[delayHead_] : src_->getData();
   Array &dest = dest_->getData();
 
   NTA_DEBUG << "Link::compute: " << getMoniker() << "; copying to dest input"
@@ -205,31 +223,91 @@ void Link::compute() {
         << "Not enough room in buffer to propogate to " << destRegionName_
         << " " << destInputName_ << ". ";
 
-  if (src.getType() == dest.getType() && !is_FanIn_ && propagationDelay_==0) {
-    dest = src;   // Performs a shallow copy. Data not copied but passed in shared_ptr.
-  } else {
-    // we must perform a deep copy with possible type conversion.
-    // It is copied into the destination Input
-    // buffer at the specified offset so an Input with multiple incoming links
-    // has the Output buffers appended into a single large Input buffer.
-    src.convertInto(dest, destOffset_, dest.getMaxElementsCount());
+  if (src.getType() == dest.getType() && !is_FanIn_) {
+    // Performs a shallow copy. Data not copied but passed in shared_ptr.
+    // The head of a delay ring is not overwritten until the shift after next.
+    dest = src;
+    return 0;
   }
+  // we must perform a deep copy with possible type conversion.
+  // It is copied into the destination Input
+  // buffer at the specified offset so an Input with multiple incoming links
+  // has the Output buffers appended into a single large Input buffer.
+  src.convertInto(dest, destOffset_, dest.getMaxElementsCount());
+  return src.getCount() * BasicType::getSize(dest.getType());
+}
+
+// Deep copy an array into another one of the same type, reusing its buffer
+// when it is large enough.
+static void copyInto_(const Array &from, Array &to) {
+  NTA_ASSERT(from.getType() == to.getType());
+  if (from.getType() == NTA_BasicType_SDR) {
+    if (!to.has_buffer() || to.getSDR().dimensions != from.getSDR().dimensions)
+      to.allocateBuffer(from.getSDR().dimensions);
+    to.getSDR().setSDR(from.getSDR());
+    return;
+  }
+  if (to.getMaxElementsCount() < from.getCount())
+    to.allocateBuffer(from.getCount());
+  to.setCount(from.getCount());
+  if (from.getCount() > 0)
+    memcpy((char *)to.getBuffer(), (const char *)from.getBuffer(),
+           from.getCount() * BasicType::getSize(from.getType()));
 }
 
 void Link::shiftBufferedData() {
+  if (!profilingEnabled_ || !propagationDelay_) {
+    shift_();
+    return;
+  }
+  const UInt64 start = profile::now();
+  const UInt64 allocations = ArrayBase::getAllocationCount();
+  profile_.bytesCopied += shift_();
+  recordProfile_(profile_.shift, "shift", start, allocations);
+}
+
+size_t Link::shift_() {
   if (propagationDelay_) {   // Source buffering is not used in 0-delay links
-    Array& from = src_->getData();
-    NTA_CHECK(propagationDelayBuffer_.size() == (propagationDelay_));
+    const size_t ringSize = propagationDelay_ + 1;
+    NTA_CHECK(propagationDelayBuffer_.size() == ringSize);
+
+    // Push a copy of the source Output buffer on the back of the queue, by
+    // overwriting the spare buffer behind it.  This must be a deep copy.
+    Array &back = propagationDelayBuffer_[(delayHead_ + propagationDelay_) % ringSize];
+    // The destination normally shares the head by now.  If it did not
+    // compute since it shared this buffer, it keeps its own copy.
+    Array &dest = dest_->getData();
+    if (dest.isInstance(back))
+      dest = back.copy();
+    copyInto_(src_->getData(), back);
+
+    // Pop the head of the queue; it becomes the spare.
+    // The next buffer now becomes the value to copy to destination.
+    delayHead_ = (delayHead_ + 1) % ringSize;
+    return back.getCount() * BasicType::getSize(back.getType());
+  }
+  return 0;
+}
 
-    // push a copy of the source Output buffer on the back of the queue.
-    // This must be a deep copy.
-    Array a = from.copy();
-    propagationDelayBuffer_.push_back(a);
+void Link::enableProfiling(bool trace) {
+  profilingEnabled_ = true;
+  tracingEnabled_ = trace;
+}
 
-    // Pop the head of the queue
-    // The top of the queue now becomes the value to copy to destination.
-    propagationDelayBuffer_.pop_front();
-  }
+void Link::disableProfiling() {
+  profilingEnabled_ = false;
+  tracingEnabled_ = false;
+}
+
+void Link::resetProfiling() { profile_.reset(); }
+
+void Link::recordProfile_(LatencyHistogram &latency, const char *name,
+                          UInt64 start, UInt64 allocations) {
+  const UInt64 duration = profile::now() - start;
+  latency.add(duration);
+  profile_.allocations += ArrayBase::getAllocationCount() - allocations;
+  if (tracingEnabled_)
+    profile_.trace.push_back({name, start, duration, profile::threadId()});
 }
 
 void Link::serialize(std::ostream &f) {
@@ -243,7 +321,7 @@ void Link::serialize(std::ostream &f) {
   f << "destRegion: " << getDestRegionName() << "\n";
   f << "destInput: " << getDestInputName() << "\n";
   f << "propagationDelay: " << propagationDelay_ << "\n";
-  f << "propagationDelayBuffer: [ " << propagationDelayBuffer_.size() << "\n";
+  f << "propagationDelayBuffer: [ " << propagationDelay_ << "\n";
   if (propagationDelay_ > 0) {
     // we need to capture the propagationDelayBuffer_ used for propagationDelay
     // Do not copy the last entry.  It is the same as the output buffer.
@@ -257,12 +335,9 @@ void Link::serialize(std::ostream &f) {
     Array a = dest_->getData().subset(destOffset_, srcCount);
     a.save(f); // our part of the current Dest Input buffer.
 
-    std::deque<Array>::iterator itr;
-    for (auto itr = propagationDelayBuffer_.begin();
-         itr != propagationDelayBuffer_.end(); itr++) {
-      if (itr + 1 == propagationDelayBuffer_.end())
-        break; // skip the last buffer. Its the current output.
-      Array &buf = *itr;
+    // skip the last buffer. Its the current output.
+    for (size_t i = 0; i + 1 < propagationDelay_; i++) {
+      const Array &buf = propagationDelayBuffer_[(delayHead_ + i) % (propagationDelay_ + 1)];
       buf.save(f);
     } // end for
   }
@@ -359,6 +434,9 @@ void Link::deserialize(std::istream &f) {
     a.load(f);
     propagationDelayBuffer_.push_back(a);
   }
+  if (count > 0) // and the spare
+    propagationDelayBuffer_.push_back(propagationDelayBuffer_.back().copy());
+  delayHead_ = 0;
   // To complete the restore, call r->prepareInputs() and then shiftBufferedData();
   // This is performed in Network class at the end of the load().
   f >> tag;
@@ -406,8 +484,8 @@ std::ostream &operator<<(std::ostream &f, const Link &link) {
     << "</propagationDelay>\n";
   if (link.getPropagationDelay() > 0) {
   	f <<   "   <propagationDelayBuffer>\n";
-	for (auto buf : link.propagationDelayBuffer_) {
-		f << buf << "\n";
+	for (size_t i = 0; i < link.propagationDelay_; i++) {
+		f << link.propagationDelayBuffer_[(link.delayHead_ + i) % (link.propagationDelay_ + 1)] << "\n";
 	}
 	f <<   "   </propagationDelayBuffer>\n";
   }
@@ -28,9 +28,10 @@
 #define NTA_LINK_HPP
 
 #include <string>
-#include <deque>
+#include <vector>
 
 #include <nupic/engine/Input.hpp> 
+#include <nupic/engine/Profile.hpp>
 #include <nupic/ntypes/Array.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
 #include <nupic/types/Types.hpp>
@@ -436,6 +437,8 @@ public:
   /*
    * No-op for links without delay; for delayed links, remove head element of
    * the propagation delay buffer and push back the current value from source.
+   * The value is copied into a preallocated buffer of the ring, so nothing is
+   * allocated once the link is running.
    *
    * NOTE It's intended that this method be called exactly once on all links
    * within a network at the end of every time step. Network::run calls it
@@ -479,6 +482,30 @@ public:
    */
   void deserialize(std::istream &f);
 
+  /**
+   * @}
+   *
+   * @name Profiling
+   *
+   * @{
+   */
+
+  /**
+   * Record the latency, the bytes copied and the Array allocations of
+   * compute() and shiftBufferedData().  Normally enabled together with the
+   * destination Region by Network::enableProfiling().
+   *
+   * @param trace Also keep every call as an event, for a trace export.
+   */
+  void enableProfiling(bool trace = false);
+  void disableProfiling();
+  void resetProfiling();
+  const LinkProfile &getProfile() const { return profile_; }
+
+  /**
+   * @}
+   */
+
 private:
   // common initialization for the two Link constructors.
   void commonConstructorInit_(const std::string &linkType,
@@ -518,13 +545,30 @@ private:
   size_t destOffset_;
   bool is_FanIn_;
 
-  // Queue buffer for delayed source data buffering
-  std::deque<Array> propagationDelayBuffer_;
+  // Ring of propagationDelay_ + 1 preallocated buffers for delayed source
+  // data.  The propagationDelay_ buffers starting at delayHead_, wrapping
+  // around, are the delayed outputs, oldest first; the oldest is the next
+  // one passed to the destination.  The remaining buffer is the one the
+  // destination read last, which it may still share, and is the next one
+  // to be overwritten.
+  std::vector<Array> propagationDelayBuffer_;
+  size_t delayHead_;
   // Number of delay slots
   size_t propagationDelay_;
 
   // link must be initialized before it can compute()
   bool initialized_;
+
+  bool profilingEnabled_;
+  bool tracingEnabled_;
+  LinkProfile profile_;
+
+  // compute() and shiftBufferedData() without profiling, returning the
+  // number of bytes copied.
+  size_t compute_();
+  size_t shift_();
+  void recordProfile_(LatencyHistogram &latency, const char *name,
+                      UInt64 start, UInt64 allocations);
 };
 
 } // namespace nupic
@@ -32,6 +32,7 @@ Implementation of the Network class
 #include <nupic/engine/Input.hpp>
 #include <nupic/engine/Link.hpp>
 #include <nupic/engine/Network.hpp>
+#include <nupic/engine/NetworkScheduler.hpp>
 #include <nupic/engine/NuPIC.hpp> // for register/unregister
 #include <nupic/engine/Output.hpp>
 #include <nupic/engine/Region.hpp>
@@ -43,6 +44,7 @@ Implementation of the Network class
 #include <nupic/types/BasicType.hpp>
 #include <nupic/utils/Log.hpp>
 #include <nupic/utils/StringUtils.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace nupic {
 
@@ -357,7 +359,7 @@ void Network::removeLink(const std::string &srcRegionName,
   destInput->removeLink(link);
 }
 
-void Network::run(int n) {
+void Network::run(int n, ThreadPool *pool) {
   if (!initialized_) {
     initialize();
   }
@@ -368,6 +370,11 @@ void Network::run(int n) {
   NTA_CHECK(maxEnabledPhase_ < phaseInfo_.size())
       << "maxphase: " << maxEnabledPhase_ << " size: " << phaseInfo_.size();
 
+  if (pool != nullptr && pool->numThreads() > 1u) {
+    runParallel_(n, *pool);
+    return;
+  }
+
   for (int iter = 0; iter < n; iter++) {
     iteration_++;
 
@@ -402,6 +409,71 @@ void Network::run(int n) {
   return;
 }
 
+void Network::runParallel_(int n, ThreadPool &pool) {
+  if (n <= 0)
+    return;
+  const UInt64 firstIteration = iteration_;
+  std::vector<NetworkScheduler::Step> steps;
+
+  // compute on all enabled regions in phase order.  A region reads the
+  // outputs of its zero delay links, which it may keep sharing until its
+  // next compute, and the queues of its delayed links.
+  for (UInt32 phase = minEnabledPhase_; phase <= maxEnabledPhase_; phase++) {
+    for (auto r : phaseInfo_[phase]) {
+      NetworkScheduler::Step step;
+      step.run = [r](UInt64) {
+        r->prepareInputs();
+        r->compute();
+      };
+      step.writes.push_back(r);
+      for (const auto &inputTuple : r->getInputs()) {
+        for (const auto &pLink : inputTuple.second->getLinks()) {
+          if (pLink->getPropagationDelay() > 0)
+            step.reads.push_back(pLink.get());
+          else
+            step.reads.push_back(pLink->getSrc().getRegion());
+        }
+      }
+      steps.push_back(step);
+    }
+  }
+
+  // invoke callbacks
+  if (callbacks_.getCount() > 0) {
+    NetworkScheduler::Step step;
+    step.barrier = true;
+    step.run = [this, firstIteration](UInt64 iteration) {
+      iteration_ = firstIteration + iteration + 1u;
+      for (UInt32 i = 0; i < callbacks_.getCount(); i++) {
+        const std::pair<std::string, callbackItem> &callback = callbacks_.getByIndex(i);
+        callback.second.first(this, iteration_, callback.second.second);
+      }
+    };
+    steps.push_back(step);
+  }
+
+  // Shift the delayed links.  Links without delay have nothing to shift.
+  for (size_t i = 0; i < regions_.getCount(); i++) {
+    const std::shared_ptr<Region> r = regions_.getByIndex(i).second;
+    for (const auto &inputTuple : r->getInputs()) {
+      for (const auto &pLink : inputTuple.second->getLinks()) {
+        if (pLink->getPropagationDelay() == 0)
+          continue;
+        Link *link = pLink.get();
+        NetworkScheduler::Step step;
+        step.run = [link](UInt64) { link->shiftBufferedData(); };
+        step.writes.push_back(link);
+        step.reads.push_back(link->getSrc().getRegion());
+        steps.push_back(step);
+      }
+    }
+  }
+
+  NetworkScheduler scheduler(std::move(steps));
+  scheduler.run((UInt64)n, pool);
+  iteration_ = firstIteration + (UInt64)n;
+}
+
 void Network::initialize() {
 
   /*
@@ -705,9 +777,9 @@ void Network::load(std::istream &f) {
   }
 }
 
-void Network::enableProfiling() {
+void Network::enableProfiling(bool trace) {
   for (size_t i = 0; i < regions_.getCount(); i++)
-    regions_.getByIndex(i).second->enableProfiling();
+    regions_.getByIndex(i).second->enableProfiling(trace);
 }
 
 void Network::disableProfiling() {
@@ -720,6 +792,62 @@ void Network::resetProfiling() {
     regions_.getByIndex(i).second->resetProfiling();
 }
 
+void Network::saveProfile(std::ostream &f) const {
+  f << "{\"unit\": \"microseconds\",\n\"regions\": [";
+  for (size_t i = 0; i < regions_.getCount(); i++) {
+    const std::shared_ptr<Region> r = regions_.getByIndex(i).second;
+    const RegionProfile &profile = r->getProfile();
+    const UInt64 iterations = profile.compute.getCount();
+    f << (i ? ",\n" : "\n")
+      << "{\"name\": " << profile::quoteJSON(r->getName())
+      << ", \"type\": " << profile::quoteJSON(r->getType())
+      << ",\n \"prepare\": ";
+    profile.prepare.saveJSON(f);
+    f << ",\n \"compute\": ";
+    profile.compute.saveJSON(f);
+    f << ",\n \"allocations\": " << profile.allocations
+      << ", \"allocationsPerIteration\": "
+      << (iterations ? (Real64)profile.allocations / (Real64)iterations : 0.0)
+      << "}";
+  }
+  f << "],\n\"links\": [";
+  bool first = true;
+  for (size_t i = 0; i < regions_.getCount(); i++) {
+    const std::shared_ptr<Region> r = regions_.getByIndex(i).second;
+    for (const auto &inputTuple : r->getInputs()) {
+      for (const auto &pLink : inputTuple.second->getLinks()) {
+        const LinkProfile &profile = pLink->getProfile();
+        f << (first ? "\n" : ",\n")
+          << "{\"name\": " << profile::quoteJSON(pLink->getMoniker())
+          << ", \"propagationDelay\": " << pLink->getPropagationDelay()
+          << ",\n \"compute\": ";
+        profile.compute.saveJSON(f);
+        f << ",\n \"shift\": ";
+        profile.shift.saveJSON(f);
+        f << ",\n \"bytesCopied\": " << profile.bytesCopied
+          << ", \"allocations\": " << profile.allocations << "}";
+        first = false;
+      }
+    }
+  }
+  f << "]}\n";
+}
+
+void Network::saveProfileTrace(std::ostream &f) const {
+  f << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  bool first = true;
+  for (size_t i = 0; i < regions_.getCount(); i++) {
+    const std::shared_ptr<Region> r = regions_.getByIndex(i).second;
+    profile::saveTraceEvents(f, r->getName(), "region", r->getProfile().trace, first);
+    for (const auto &inputTuple : r->getInputs()) {
+      for (const auto &pLink : inputTuple.second->getLinks())
+        profile::saveTraceEvents(f, pLink->getMoniker(), "link",
+                                 pLink->getProfile().trace, first);
+    }
+  }
+  f << "\n]}\n";
+}
+
   /*
    * Adds a region to the RegionImplFactory's list of packages
    */
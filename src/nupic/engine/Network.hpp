@@ -46,6 +46,7 @@ class Region;
 class Dimensions;
 class RegisteredRegionImpl;
 class Link;
+class ThreadPool;
 
 /**
  * Represents an HTM network. A network is a collection of regions.
@@ -328,9 +329,22 @@ public:
    *
    * For each iteration, Region.compute() is called.
    *
+   * With a thread pool, regions which do not depend on each other run
+   * concurrently, and upstream regions can start the next iteration while
+   * downstream regions finish this one, as far as the links allow.  A region
+   * waits for the regions whose outputs it reads, a region's next compute
+   * waits for the regions reading its outputs, and the callbacks wait for,
+   * and hold back, everything.  The results are exactly those of running on
+   * the calling thread, provided that regions only exchange data through
+   * links.
+   *
    * @param n Number of iterations
+   *
+   * @param pool
+   * Threads to use, or nullptr to run on the calling thread.  Regions which
+   * use the same pool for their own work run it inline.
    */
-  void run(int n);
+  void run(int n, ThreadPool *pool = nullptr);
 
   /**
    * The type of run callback function.
@@ -365,9 +379,13 @@ public:
    */
 
   /**
-   * Start profiling for all regions of this network.
+   * Start profiling for all regions and links of this network.
+   *
+   * @param trace Also record every region and link operation as an event
+   *        for saveProfileTrace().  The events grow with the number of
+   *        iterations until resetProfiling().
    */
-  void enableProfiling();
+  void enableProfiling(bool trace = false);
 
   /**
    * Stop profiling for all regions of this network.
@@ -379,6 +397,20 @@ public:
    */
   void resetProfiling();
 
+  /**
+   * Write the profiles of all regions and links as JSON.  Each region has
+   * the latencies of preparing its inputs and of computing, each link the
+   * latencies of compute and shift and the bytes it copied, both with the
+   * Array buffers they allocated.  Latencies are in microseconds.
+   */
+  void saveProfile(std::ostream &f) const;
+
+  /**
+   * Write the events recorded while tracing in the Chrome trace-event
+   * format, which chrome://tracing and Perfetto can open.
+   */
+  void saveProfileTrace(std::ostream &f) const;
+
 
   /**
    * @}
@@ -422,6 +454,9 @@ private:
   // the network
   void resetEnabledPhases_();
 
+  // run() on the threads of the pool.
+  void runParallel_(int n, ThreadPool &pool);
+
   bool initialized_;
   Collection<std::shared_ptr<Region>> regions_;
 
@@ -0,0 +1,190 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the NetworkScheduler class
+ */
+
+#include <nupic/engine/NetworkScheduler.hpp>
+#include <nupic/utils/Log.hpp>
+
+using namespace nupic;
+
+NetworkScheduler::NetworkScheduler(std::vector<Step> steps)
+    : steps_(std::move(steps)) {}
+
+
+void NetworkScheduler::run(UInt64 iterations, ThreadPool &pool) {
+  if( iterations == 0u || steps_.empty() )
+    return;
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    tasks_.clear();
+    resources_.clear();
+    ready_.clear();
+    remaining_.clear();
+    lastBarrier_ = 0u;
+    iterations_  = iterations;
+    generated_   = 0u;
+    completed_   = 0u;
+    running_     = 0u;
+    error_       = nullptr;
+    maxInFlight_ = pool.numThreads() + 1u;
+    while( generated_ < iterations_ && generated_ < completed_ + maxInFlight_ )
+      addIteration_();
+  }
+
+  // One chunk per thread, and every chunk works off the shared ready queue.
+  pool.parallelFor( 0u, pool.numThreads(), [this](UInt, UInt, UInt) {
+    workerLoop_();
+  });
+
+  if( error_ )
+    std::rethrow_exception( error_ );
+}
+
+
+void NetworkScheduler::workerLoop_() {
+  std::unique_lock<std::mutex> lock( mutex_ );
+  while( true ) {
+    changed_.wait( lock, [this] {
+      return finished_() || (!ready_.empty() && !error_);
+    });
+    if( finished_() )
+      return;
+
+    const TaskId id = ready_.front();
+    ready_.pop_front();
+    const Task &task = tasks_.at( id );
+    const UInt   step      = task.step;
+    const UInt64 iteration = task.iteration;
+    running_++;
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      steps_[step].run( iteration );
+    }
+    catch(...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    running_--;
+    if( error && !error_ )
+      error_ = error;
+    completeTask_( id );
+    changed_.notify_all();
+  }
+}
+
+
+bool NetworkScheduler::finished_() const {
+  return completed_ == iterations_ || (error_ && running_ == 0u);
+}
+
+
+void NetworkScheduler::addIteration_() {
+  remaining_.push_back( (UInt)steps_.size() );
+  for(UInt step = 0u; step < steps_.size(); step++) {
+    addTask_( step, generated_ );
+  }
+  generated_++;
+}
+
+
+void NetworkScheduler::addTask_(UInt step, UInt64 iteration) {
+  const TaskId id = nextTask_++;
+  Task &task = tasks_[id];
+  task.step      = step;
+  task.iteration = iteration;
+
+  const Step &s = steps_[step];
+  if( s.barrier ) {
+    for( const auto &entry : tasks_ ) {
+      if( entry.first != id )
+        addDependency_( entry.first, task, id );
+    }
+    // Every later task waits for the barrier instead.
+    resources_.clear();
+    lastBarrier_ = id;
+  }
+  else {
+    addDependency_( lastBarrier_, task, id );
+    for( const void *resource : s.writes ) {
+      Resource &r = resources_[resource];
+      addDependency_( r.writer, task, id );
+      for( const TaskId reader : r.readers )
+        addDependency_( reader, task, id );
+      r.writer = id;
+      r.readers.clear();
+    }
+    for( const void *resource : s.reads ) {
+      Resource &r = resources_[resource];
+      if( r.writer == id )
+        continue; // Also written by this step.
+      addDependency_( r.writer, task, id );
+      r.readers.push_back( id );
+    }
+  }
+
+  if( task.pending == 0u )
+    ready_.push_back( id );
+}
+
+
+void NetworkScheduler::addDependency_(TaskId before, Task &task, TaskId id) {
+  if( before == 0u )
+    return;
+  const auto it = tasks_.find( before );
+  if( it == tasks_.end() )
+    return; // Already finished.
+  auto &successors = it->second.successors;
+  // All dependencies of a task are added together, so duplicates are adjacent.
+  if( !successors.empty() && successors.back() == id )
+    return;
+  successors.push_back( id );
+  task.pending++;
+}
+
+
+void NetworkScheduler::completeTask_(TaskId id) {
+  const auto it = tasks_.find( id );
+  NTA_ASSERT( it != tasks_.end() );
+  const std::vector<TaskId> successors = std::move( it->second.successors );
+  const UInt64 iteration = it->second.iteration;
+  tasks_.erase( it );
+
+  for( const TaskId successor : successors ) {
+    if( --tasks_.at( successor ).pending == 0u )
+      ready_.push_back( successor );
+  }
+
+  remaining_[(Size)(iteration - completed_)]--;
+  while( !remaining_.empty() && remaining_.front() == 0u ) {
+    remaining_.pop_front();
+    completed_++;
+  }
+  while( !error_ && generated_ < iterations_ &&
+         generated_ < completed_ + maxInFlight_ )
+    addIteration_();
+}
@@ -0,0 +1,136 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Interface for the NetworkScheduler class
+ */
+
+#ifndef NTA_NETWORK_SCHEDULER_HPP
+#define NTA_NETWORK_SCHEDULER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+
+namespace nupic {
+
+/**
+ * Runs the iterations of a Network on several threads, with the same results
+ * as running them one step at a time.
+ *
+ * @b Description
+ * An iteration is a list of steps, such as computing a region or shifting a
+ * delayed link.  Each step declares the resources, any distinct pointers,
+ * which it reads and writes.  The scheduler unrolls the iterations step by
+ * step, in the sequential order, and makes every step wait for the earlier
+ * steps which write a resource it uses, or which read a resource it writes.
+ * Steps which touch different resources run concurrently, both within an
+ * iteration and across iterations, so upstream regions can start the next
+ * iteration while downstream regions finish this one.  Conflicting steps
+ * keep their sequential order, which is what makes the results exact.
+ *
+ * A barrier step, such as the network callbacks, waits for all earlier steps
+ * and all later steps wait for it.
+ */
+class NetworkScheduler {
+public:
+  struct Step {
+    /** Run the step for the given iteration, counted from 0. */
+    std::function<void(UInt64)> run;
+    std::vector<const void *>   reads;
+    std::vector<const void *>   writes;
+    bool                        barrier = false;
+  };
+
+  /**
+   * @param steps The steps of one iteration, in sequential order.
+   */
+  explicit NetworkScheduler(std::vector<Step> steps);
+
+  NetworkScheduler(const NetworkScheduler &) = delete;
+  NetworkScheduler &operator=(const NetworkScheduler &) = delete;
+
+  /**
+   * Run the given number of iterations on the threads of the pool, and wait
+   * for them.  At most numThreads() + 1 iterations are in flight.  If a step
+   * throws, no more steps are started and the first exception is rethrown
+   * once the running steps have finished.
+   */
+  void run(UInt64 iterations, ThreadPool &pool);
+
+private:
+  typedef UInt64 TaskId;
+
+  struct Task {
+    UInt                step;
+    UInt64              iteration;
+    UInt                pending = 0u;
+    std::vector<TaskId> successors;
+  };
+
+  // The tasks which last wrote, and since then read, a resource.
+  struct Resource {
+    TaskId              writer = 0u;
+    std::vector<TaskId> readers;
+  };
+
+  void workerLoop_();
+  void addIteration_();
+  void addTask_(UInt step, UInt64 iteration);
+  void addDependency_(TaskId before, Task &task, TaskId id);
+  void completeTask_(TaskId id);
+  bool finished_() const;
+
+  std::vector<Step> steps_;
+
+  std::mutex              mutex_;
+  std::condition_variable changed_;
+
+  // Only the unfinished tasks are kept, so a missing id is a finished task.
+  // Task ids start at 1 so that 0 means none.
+  std::unordered_map<TaskId, Task>  tasks_;
+  std::map<const void *, Resource>  resources_;
+  std::deque<TaskId>                ready_;
+  TaskId                            nextTask_     = 1u;
+  TaskId                            lastBarrier_  = 0u;
+
+  // Remaining tasks of the iterations in flight, oldest first.
+  std::deque<UInt>  remaining_;
+  UInt64            iterations_ = 0u;
+  UInt64            generated_  = 0u;
+  UInt64            completed_  = 0u;
+  UInt64            maxInFlight_ = 1u;
+  UInt              running_    = 0u;
+  std::exception_ptr error_;
+};
+
+} // end namespace nupic
+
+#endif // NTA_NETWORK_SCHEDULER_HPP
@@ -0,0 +1,180 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the profiling records of Regions and Links
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include <nupic/engine/Profile.hpp>
+
+using namespace nupic;
+
+namespace {
+
+// Buckets 0-7 hold 0-7ns exactly, then 8 buckets per power of two.
+const size_t numBuckets_ = 8u + 61u * 8u;
+
+size_t bucket_(UInt64 ns) {
+  if (ns < 8u)
+    return (size_t)ns;
+  UInt32 log2 = 3u;
+  while ((ns >> (log2 + 1u)) != 0u)
+    log2++;
+  const UInt64 sub = (ns >> (log2 - 3u)) & 7u;
+  return (size_t)(8u + (log2 - 3u) * 8u + sub);
+}
+
+UInt64 bucketUpperBound_(size_t bucket) {
+  if (bucket < 8u)
+    return bucket;
+  const UInt64 shift = (bucket - 8u) / 8u;
+  const UInt64 sub = (bucket - 8u) % 8u;
+  return ((9u + sub) << shift) - 1u; // wraps to the max for the last bucket
+}
+
+// Exact, since the default stream precision would round long traces.
+std::string microseconds_(UInt64 ns) {
+  std::ostringstream f;
+  f << ns / 1000u << '.' << std::setw(3) << std::setfill('0') << ns % 1000u;
+  return f.str();
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+void LatencyHistogram::add(UInt64 nanoseconds) {
+  buckets_[bucket_(nanoseconds)]++;
+  count_++;
+  total_ += nanoseconds;
+  if (nanoseconds > max_)
+    max_ = nanoseconds;
+}
+
+void LatencyHistogram::reset() {
+  buckets_.assign(numBuckets_, 0u);
+  count_ = 0u;
+  total_ = 0u;
+  max_ = 0u;
+}
+
+UInt64 LatencyHistogram::getPercentile(Real64 percent) const {
+  if (count_ == 0u)
+    return 0u;
+  UInt64 rank = (UInt64)std::ceil(percent / 100.0 * (Real64)count_);
+  if (rank < 1u)
+    rank = 1u;
+  UInt64 seen = 0u;
+  for (size_t b = 0; b < buckets_.size(); b++) {
+    seen += buckets_[b];
+    if (seen >= rank)
+      return std::min(bucketUpperBound_(b), max_);
+  }
+  return max_;
+}
+
+void LatencyHistogram::saveJSON(std::ostream &f) const {
+  const UInt64 mean = count_ ? total_ / count_ : 0u;
+  f << "{\"count\": " << count_
+    << ", \"total\": " << microseconds_(total_)
+    << ", \"mean\": " << microseconds_(mean)
+    << ", \"p50\": " << microseconds_(getPercentile(50.0))
+    << ", \"p99\": " << microseconds_(getPercentile(99.0))
+    << ", \"max\": " << microseconds_(max_) << "}";
+}
+
+void RegionProfile::reset() {
+  prepare.reset();
+  compute.reset();
+  allocations = 0u;
+  trace.clear();
+}
+
+void LinkProfile::reset() {
+  compute.reset();
+  shift.reset();
+  bytesCopied = 0u;
+  allocations = 0u;
+  trace.clear();
+}
+
+namespace nupic {
+namespace profile {
+
+UInt64 now() {
+  static const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  return (UInt64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch).count();
+}
+
+UInt32 threadId() {
+  static std::atomic<UInt32> next(0u);
+  static thread_local const UInt32 id = next++;
+  return id;
+}
+
+std::string quoteJSON(const std::string &s) {
+  std::ostringstream f;
+  f << '"';
+  for (const char c : s) {
+    switch (c) {
+    case '"':  f << "\\\""; break;
+    case '\\': f << "\\\\"; break;
+    case '\n': f << "\\n"; break;
+    case '\t': f << "\\t"; break;
+    default:
+      if ((unsigned char)c < 0x20u)
+        f << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+          << std::dec;
+      else
+        f << c;
+    }
+  }
+  f << '"';
+  return f.str();
+}
+
+void saveTraceEvents(std::ostream &f, const std::string &name,
+                     const std::string &category,
+                     const std::vector<ProfileEvent> &events, bool &first) {
+  for (const auto &event : events) {
+    if (!first)
+      f << ",\n";
+    first = false;
+    f << "{\"name\": " << quoteJSON(name + "." + event.name)
+      << ", \"cat\": " << quoteJSON(category)
+      << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << event.thread
+      << ", \"ts\": " << microseconds_(event.start)
+      << ", \"dur\": " << microseconds_(event.duration) << "}";
+  }
+}
+
+} // namespace profile
+} // namespace nupic
@@ -0,0 +1,142 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Interface for the profiling records of Regions and Links
+ */
+
+#ifndef NTA_PROFILE_HPP
+#define NTA_PROFILE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+/**
+ * Histogram of latencies in nanoseconds.
+ *
+ * @b Description
+ * The buckets are logarithmic with 8 buckets per power of two, so adding a
+ * sample is constant time and a percentile is at most 12.5% above the
+ * latency it stands for.  Percentiles are never above the maximum.
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+
+  void add(UInt64 nanoseconds);
+  void reset();
+
+  UInt64 getCount() const { return count_; }
+  UInt64 getTotal() const { return total_; }
+  UInt64 getMax() const { return max_; }
+
+  /**
+   * @param percent In [0, 100], for example 50 for the median.
+   * @returns The upper bound of the bucket holding that percentile, in
+   *          nanoseconds, or 0 if there are no samples.
+   */
+  UInt64 getPercentile(Real64 percent) const;
+
+  /**
+   * Write the count, and the total, mean, p50, p99 and max in microseconds
+   * as a JSON object.
+   */
+  void saveJSON(std::ostream &f) const;
+
+private:
+  std::vector<UInt64> buckets_;
+  UInt64 count_;
+  UInt64 total_;
+  UInt64 max_;
+};
+
+/**
+ * One timed operation, for the Chrome trace-event export.
+ */
+struct ProfileEvent {
+  const char *name; // static string, such as "compute"
+  UInt64 start;     // nanoseconds on the profile clock
+  UInt64 duration;  // nanoseconds
+  UInt32 thread;
+};
+
+/**
+ * Profile of a Region, recorded while profiling is enabled.  Preparing the
+ * inputs includes the Link::compute of the incoming links.
+ */
+struct RegionProfile {
+  LatencyHistogram prepare;
+  LatencyHistogram compute;
+  UInt64 allocations = 0; // Array buffers allocated by prepare and compute
+  std::vector<ProfileEvent> trace; // Only while tracing.
+
+  void reset();
+};
+
+/**
+ * Profile of a Link, recorded while the destination Region profiles.
+ */
+struct LinkProfile {
+  LatencyHistogram compute;
+  LatencyHistogram shift;
+  UInt64 bytesCopied = 0; // by compute and by shifting delayed data
+  UInt64 allocations = 0; // Array buffers allocated by compute and shift
+  std::vector<ProfileEvent> trace; // Only while tracing.
+
+  void reset();
+};
+
+namespace profile {
+
+/**
+ * Nanoseconds on a steady clock shared by all profiles.
+ */
+UInt64 now();
+
+/**
+ * A small number identifying the calling thread in trace events.
+ */
+UInt32 threadId();
+
+/**
+ * Quote and escape a string for JSON.
+ */
+std::string quoteJSON(const std::string &s);
+
+/**
+ * Write events as Chrome trace "complete" events, comma separated.
+ *
+ * @param first Whether no event was written yet, updated.
+ */
+void saveTraceEvents(std::ostream &f, const std::string &name,
+                     const std::string &category,
+                     const std::vector<ProfileEvent> &events, bool &first);
+
+} // namespace profile
+} // namespace nupic
+
+#endif // NTA_PROFILE_HPP
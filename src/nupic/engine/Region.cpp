@@ -52,7 +52,7 @@ class GenericRegisteredRegionImpl;
 Region::Region(std::string name, const std::string &nodeType,
                const std::string &nodeParams, Network *network)
     : name_(std::move(name)), type_(nodeType), initialized_(false),
-      network_(network), profilingEnabled_(false) {
+      network_(network), profilingEnabled_(false), tracingEnabled_(false) {
   // Set region info before creating the RegionImpl so that the
   // Impl has access to the region info in its constructor.
   RegionImplFactory &factory = RegionImplFactory::getInstance();
@@ -64,6 +64,7 @@ Region::Region(Network *net) {
       network_ = net;
       initialized_ = false;
       profilingEnabled_ = false;
+      tracingEnabled_ = false;
     } // for deserialization of region.
 
 
@@ -179,15 +180,19 @@ void Region::compute() {
     NTA_THROW << "Region " << getName()
               << " unable to compute because not initialized";
 
-  if (profilingEnabled_)
-    computeTimer_.start();
+  if (!profilingEnabled_) {
+    impl_->compute();
+    return;
+  }
 
-  impl_->compute();
+  const UInt64 start = profile::now();
+  const UInt64 allocations = ArrayBase::getAllocationCount();
+  computeTimer_.start();
 
-  if (profilingEnabled_)
-    computeTimer_.stop();
+  impl_->compute();
 
-  return;
+  computeTimer_.stop();
+  recordProfile_(profile_.compute, "compute", start, allocations);
 }
 
 /**
@@ -421,13 +426,41 @@ void Region::load(std::istream &f) {
 
 
 
-void Region::enableProfiling() { profilingEnabled_ = true; }
+void Region::enableProfiling(bool trace) {
+  profilingEnabled_ = true;
+  tracingEnabled_ = trace;
+  for (const auto &input : inputs_) {
+    for (const auto &link : input.second->getLinks())
+      link->enableProfiling(trace);
+  }
+}
 
-void Region::disableProfiling() { profilingEnabled_ = false; }
+void Region::disableProfiling() {
+  profilingEnabled_ = false;
+  tracingEnabled_ = false;
+  for (const auto &input : inputs_) {
+    for (const auto &link : input.second->getLinks())
+      link->disableProfiling();
+  }
+}
 
 void Region::resetProfiling() {
   computeTimer_.reset();
   executeTimer_.reset();
+  profile_.reset();
+  for (const auto &input : inputs_) {
+    for (const auto &link : input.second->getLinks())
+      link->resetProfiling();
+  }
+}
+
+void Region::recordProfile_(LatencyHistogram &latency, const char *name,
+                            UInt64 start, UInt64 allocations) {
+  const UInt64 duration = profile::now() - start;
+  latency.add(duration);
+  profile_.allocations += ArrayBase::getAllocationCount() - allocations;
+  if (tracingEnabled_)
+    profile_.trace.push_back({name, start, duration, profile::threadId()});
 }
 
 const Timer &Region::getComputeTimer() const { return computeTimer_; }
@@ -551,10 +584,16 @@ const Array& Region::getInputData(const std::string &inputName) const {
 }
 
 void Region::prepareInputs() {
+  const UInt64 start = profilingEnabled_ ? profile::now() : 0u;
+  const UInt64 allocations = profilingEnabled_ ? ArrayBase::getAllocationCount() : 0u;
+
   // Ask each input to prepare itself
   for (InputMap::const_iterator i = inputs_.begin(); i != inputs_.end(); i++) {
     i->second->prepare();
   }
+
+  if (profilingEnabled_)
+    recordProfile_(profile_.prepare, "prepare", start, allocations);
 }
 
 
@@ -40,6 +40,7 @@
 #include <nupic/engine/Input.hpp>
 #include <nupic/engine/Network.hpp>
 #include <nupic/engine/Output.hpp>
+#include <nupic/engine/Profile.hpp>
 #include <nupic/engine/Region.hpp>
 #include <nupic/engine/RegionImpl.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
@@ -353,9 +354,15 @@ public:
    */
 
   /**
-   * Enable profiling of the compute and execute operations
+   * Enable profiling of the compute and execute operations, and of
+   * preparing the inputs.  The links connected to the inputs at this time
+   * are profiled too.
+   *
+   * @param trace Also keep every prepare and compute as an event, for a
+   *        trace export.  The events grow with the number of iterations
+   *        until resetProfiling().
    */
-  void enableProfiling();
+  void enableProfiling(bool trace = false);
 
   /**
    * Disable profiling of the compute and execute operations
@@ -363,10 +370,17 @@ public:
   void disableProfiling();
 
   /**
-   * Reset the compute and execute timers
+   * Reset the compute and execute timers, and the profiles of the region
+   * and of its incoming links.
    */
   void resetProfiling();
 
+  /**
+   * Get the latencies of preparing the inputs and computing, recorded
+   * while profiling is enabled.
+   */
+  const RegionProfile &getProfile() const { return profile_; }
+
   /**
    * Get the timer used to profile the compute operation.
    *
@@ -494,8 +508,13 @@ private:
 
   // Profiling related methods and variables.
   bool profilingEnabled_;
+  bool tracingEnabled_;
   Timer computeTimer_;
   Timer executeTimer_;
+  RegionProfile profile_;
+
+  void recordProfile_(LatencyHistogram &latency, const char *name,
+                      UInt64 start, UInt64 allocations);
 };
 
 } // namespace nupic
@@ -27,6 +27,7 @@
 #include <nupic/math/Topology.hpp>
 #include <nupic/utils/Log.hpp>
 #include <algorithm>
+#include <limits>
 
 using std::vector;
 using namespace nupic;
@@ -65,6 +66,134 @@ UInt indexFromCoordinates(const vector<UInt> &coordinates,
   return index;
 }
 
+/**
+ * Apply a 1-D filter to every line of the grid, along each dimension in
+ * turn.  The filter is called as filter(line, radius) and replaces the
+ * contents of the line.
+ */
+template <typename T, typename Filter>
+static void separableFilter_(vector<T> &grid, UInt radius,
+                             const vector<UInt> &dimensions, Filter filter) {
+  vector<T> line;
+  UInt inner = (UInt)grid.size();
+  for (const UInt dim : dimensions) {
+    // Points along this dimension are 'inner' elements apart.
+    const UInt outer = (UInt)grid.size() / inner;
+    inner /= dim;
+    line.resize(dim);
+    for (UInt o = 0; o < outer; o++) {
+      for (UInt i = 0; i < inner; i++) {
+        const UInt base = o * dim * inner + i;
+        for (UInt k = 0; k < dim; k++) {
+          line[k] = grid[base + k * inner];
+        }
+        filter(line, radius);
+        for (UInt k = 0; k < dim; k++) {
+          grid[base + k * inner] = line[k];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * The padded copy of a line which a window of 2*radius+1 slides over:
+ * padded[j] is the value at coordinate j - radius.  Coordinates outside of
+ * the line wrap around, or take the given fill value.
+ */
+template <typename T>
+static void padLine_(const vector<T> &line, UInt radius, bool wrapAround,
+                     T fill, vector<T> &padded) {
+  const Int n = (Int)line.size();
+  padded.resize(line.size() + 2u * radius);
+  for (Int j = 0; j < (Int)padded.size(); j++) {
+    const Int coord = j - (Int)radius;
+    if (coord >= 0 && coord < n) {
+      padded[j] = line[coord];
+    } else if (wrapAround) {
+      padded[j] = line[((coord % n) + n) % n];
+    } else {
+      padded[j] = fill;
+    }
+  }
+}
+
+vector<Real> neighborhoodMax(const vector<Real> &data, UInt radius,
+                             const vector<UInt> &dimensions, bool wrapAround) {
+  NTA_ASSERT(!dimensions.empty());
+  vector<Real> result(data);
+  vector<Real> padded, forward, backward;
+
+  separableFilter_(result, radius, dimensions,
+                   [&](vector<Real> &line, UInt r) {
+    const UInt n = (UInt)line.size();
+    // A window which covers the whole line.  Truncated windows then see the
+    // whole line too, and wrapping windows would start revisiting points.
+    if ((UInt64)r >= n - 1u || (wrapAround && 2u * (UInt64)r + 1u >= n)) {
+      std::fill(line.begin(), line.end(),
+                *std::max_element(line.begin(), line.end()));
+      return;
+    }
+    const UInt window = 2u * r + 1u;
+    padLine_(line, r, wrapAround, std::numeric_limits<Real>::lowest(), padded);
+
+    // Running max from the start of each block of 'window' elements, and
+    // from the end of each block.  Every window spans at most two blocks.
+    const UInt size = (UInt)padded.size();
+    forward.resize(size);
+    backward.resize(size);
+    for (UInt j = 0; j < size; j++) {
+      forward[j] = (j % window == 0u) ? padded[j]
+                                      : std::max(forward[j - 1u], padded[j]);
+    }
+    for (UInt j = size; j-- > 0u;) {
+      backward[j] = (j + 1u == size || (j + 1u) % window == 0u)
+                        ? padded[j] : std::max(backward[j + 1u], padded[j]);
+    }
+    for (UInt i = 0; i < n; i++) {
+      line[i] = std::max(backward[i], forward[i + window - 1u]);
+    }
+  });
+  return result;
+}
+
+vector<Real> neighborhoodMean(const vector<Real> &data, UInt radius,
+                              const vector<UInt> &dimensions, bool wrapAround) {
+  NTA_ASSERT(!dimensions.empty());
+  // The mean over a hypercube is the mean along each dimension of the means
+  // along the other dimensions.
+  vector<Real64> grid(data.begin(), data.end());
+  vector<Real64> prefix;
+
+  separableFilter_(grid, radius, dimensions,
+                   [&](vector<Real64> &line, UInt r) {
+    const UInt n = (UInt)line.size();
+    if (wrapAround && 2u * (UInt64)r + 1u >= n) {
+      Real64 sum = 0.0;
+      for (const Real64 value : line) {
+        sum += value;
+      }
+      std::fill(line.begin(), line.end(), sum / n);
+      return;
+    }
+    // Prefix sums over the line, wrapped around on both sides if needed.
+    const UInt pad = wrapAround ? r : 0u;
+    prefix.resize(n + 2u * pad + 1u);
+    prefix[0] = 0.0;
+    for (UInt j = 0; j < n + 2u * pad; j++) {
+      prefix[j + 1u] = prefix[j] + line[(j + n - pad % n) % n];
+    }
+    for (UInt i = 0; i < n; i++) {
+      // Window [i - r, i + r], in coordinates of the prefix sums.
+      const UInt64 begin = wrapAround ? i : (i > r ? i - r : 0u);
+      const UInt64 end = wrapAround ? (UInt64)i + 2u * r + 1u
+                                    : std::min<UInt64>((UInt64)i + r + 1u, n);
+      line[i] = (prefix[end] - prefix[begin]) / (Real64)(end - begin);
+    }
+  });
+  return vector<Real>(grid.begin(), grid.end());
+}
+
 } // end namespace topology
 } // namespace math
 } // end namespace nupic
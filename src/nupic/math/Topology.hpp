@@ -203,6 +203,52 @@ private:
   const UInt radius_;
 };
 
+/**
+ * Compute the maximum value in the neighborhood of every point.
+ *
+ * The result is the same as iterating a Neighborhood (or a
+ * WrappingNeighborhood) around every point, but the cost is
+ * O(numPoints * numDimensions), independent of the radius.  The hypercube
+ * is separable, so this runs a 1-D running max filter (van Herk /
+ * Gil-Werman) along each dimension in turn.
+ *
+ * @param data
+ * The value of every point, as a flat array in the coordinate system.
+ *
+ * @param radius
+ * The radius of the neighborhoods.
+ *
+ * @param dimensions
+ * The coordinate system.
+ *
+ * @param wrapAround
+ * If true, neighborhoods wrap around like WrappingNeighborhood. Otherwise
+ * they are truncated like Neighborhood.
+ *
+ * @returns
+ * A vector with the maximum over the neighborhood of every point.
+ */
+std::vector<Real> neighborhoodMax(const std::vector<Real> &data, UInt radius,
+                                  const std::vector<UInt> &dimensions,
+                                  bool wrapAround);
+
+/**
+ * Compute the mean value in the neighborhood of every point.
+ *
+ * Like neighborhoodMax, this is equivalent to iterating the neighborhood of
+ * every point, but it runs a 1-D running mean along each dimension in turn,
+ * using prefix sums.  Sums are accumulated in double precision, so the
+ * results may differ from a single precision sum in the last bits.
+ *
+ * Parameters are the same as for neighborhoodMax.
+ *
+ * @returns
+ * A vector with the mean over the neighborhood of every point.
+ */
+std::vector<Real> neighborhoodMean(const std::vector<Real> &data, UInt radius,
+                                   const std::vector<UInt> &dimensions,
+                                   bool wrapAround);
+
 } // end namespace topology
 } // namespace math
 } // end namespace nupic
@@ -107,6 +107,7 @@
 // A.getBuffer()                     -- returns a void* pointer to beginning of buffer.
 // A.setBuffer(ptr, count)           -- set un-owned buffer
 // A.setBuffer(sdr)                  -- set un-owned SDR
+// A.setView(sdr)                    -- set un-owned read-only SDR view
 // A.zeroBuffer()                    -- fills A with 0's, A retains type and size.
 // A.releaseBuffer()                 -- free everything (if owned)
 // A.getSDR()                        -- get reference to enclosed SDR
@@ -38,6 +38,10 @@ using nupic::sdr::SDR;
 
 namespace nupic {
 
+static thread_local UInt64 allocationCount_ = 0u;
+
+UInt64 ArrayBase::getAllocationCount() { return allocationCount_; }
+
 /**
  * This makes a deep copy of the buffer so this class will own the buffer.
  */
@@ -80,6 +84,7 @@ ArrayBase::ArrayBase(NTA_BasicType type) {
   }
   type_ = type;
   own_ = true;
+  view_ = false;
   releaseBuffer();
 }
 
@@ -112,6 +117,8 @@ void ArrayBase::allocateBuffer(size_t count) {
                              std::default_delete<char[]>());
     buffer_ = sp;
     own_ = true;
+    view_ = false;
+    allocationCount_++;
   }
 }
 
@@ -121,6 +128,8 @@ void ArrayBase::allocateBuffer( const std::vector<UInt>& dimensions) { // only f
   std::shared_ptr<char> sp((char *)(sdr));
   buffer_ = sp;
   own_ = true;
+  view_ = false;
+  allocationCount_++;
   count_ = sdr->size;
   capacity_ = count_ * sizeof(Byte);
 }
@@ -153,6 +162,7 @@ void ArrayBase::setBuffer(void *buffer, size_t count) {
   capacity_ = count * BasicType::getSize(type_);
   buffer_ = std::shared_ptr<char>((char *)buffer, nonDeleter());
   own_ = false;
+  view_ = false;
 }
 void ArrayBase::setBuffer(SDR &sdr) {
   type_ = NTA_BasicType_SDR;
@@ -160,6 +170,11 @@ void ArrayBase::setBuffer(SDR &sdr) {
   count_ = sdr.size;
   capacity_ = count_ * BasicType::getSize(type_);
   own_ = false;
+  view_ = false;
+}
+void ArrayBase::setView(SDR &view) {
+  setBuffer(view);
+  view_ = true;
 }
 
 
@@ -198,7 +213,8 @@ SDR& ArrayBase::getSDR() {
     allocateBuffer(zeroDim);  // Create an empty SDR object.
   }
   SDR& sdr = *((SDR *)buffer_.get());
-  sdr.setDense(sdr.getDense()); // cleanup cache
+  if (!view_) // a view is kept current by its sources, and is read only.
+    sdr.setDense(sdr.getDense()); // cleanup cache
   return sdr;
 }
 const SDR& ArrayBase::getSDR() const {
@@ -207,7 +223,8 @@ const SDR& ArrayBase::getSDR() const {
     // this is const, cannot create an empty SDR.
     NTA_THROW << "getSDR: SDR pointer is null";  
   SDR& sdr = *((SDR *)buffer_.get());
-  sdr.setDense(sdr.getDense()); // cleanup cache
+  if (!view_)
+    sdr.setDense(sdr.getDense()); // cleanup cache
   return sdr;
 }
 
@@ -304,6 +321,13 @@ void ArrayBase::convertInto(ArrayBase &a, size_t offset, size_t maxsize) const {
   char *toPtr =  (char *)a.getBuffer(); // char* so it has size
   if (offset)
     toPtr += (offset * BasicType::getSize(a.getType()));
+  if (type_ == NTA_BasicType_SDR && has_buffer()) {
+    // Zero the destination once and set only the active bits. The SDR is
+    // read as is, so a source holding sparse data never builds its dense form.
+    const sdr::SDR_sparse_t &sparse = ((const SDR *)buffer_.get())->getSparse();
+    BasicType::convertSparseArray(toPtr, a.type_, sparse.data(), sparse.size(), getCount());
+    return;
+  }
   const void *fromPtr = getBuffer();
   BasicType::convertArray(toPtr, a.type_, fromPtr, type_, getCount());
 }
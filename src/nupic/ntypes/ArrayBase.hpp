@@ -105,6 +105,12 @@ namespace nupic
     virtual void allocateBuffer(size_t count);
     virtual void allocateBuffer(const std::vector<UInt>& dimensions);  // only for SDR
 
+    /**
+     * The number of buffers allocated by ArrayBase on the calling thread.
+     * Profiling takes the difference over an operation.
+     */
+    static UInt64 getAllocationCount();
+
     /**
      * Ask ArrayBase to zero fill its buffer
      */
@@ -161,6 +167,14 @@ namespace nupic
     virtual void setBuffer(void *buffer, size_t count);
     virtual void setBuffer(sdr::SDR &sdr);
 
+    /**
+     * Wrap a read-only SDR view, such as a Reshape of a Concatenation, which
+     * is kept current by the SDRs it reads from.  Unlike setBuffer(sdr),
+     * getSDR() does not refresh the view's cache, which a view can not set.
+     * The same lifetime rules as for setBuffer apply.
+     */
+    void setView(sdr::SDR &view);
+
     /**
      * Set the number of elements.  This is used to truncate the array.
      * For NTA_BasicTypeSparse, this sets the current length of the sparse array.
@@ -207,6 +221,7 @@ namespace nupic
     size_t capacity_;   // size of the allocated buffer in bytes
     NTA_BasicType type_;// type of data in this buffer
     bool own_;
+    bool view_;         // wraps a read-only SDR view, see setView()
 
     // Buffer array conversion routines
     void convertInto(ArrayBase &a, size_t offset=0, size_t maxsize=0) const;
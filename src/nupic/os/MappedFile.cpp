@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2013, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of read-only memory mapped files
+ */
+
+#include <nupic/os/MappedFile.hpp>
+#include <nupic/os/OS.hpp>
+#include <nupic/utils/Log.hpp>
+
+#if defined(NTA_OS_WINDOWS)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace nupic {
+
+#if defined(NTA_OS_WINDOWS)
+
+MappedFile::MappedFile(const std::string &path) : path_(path) {
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  NTA_CHECK(file_ != INVALID_HANDLE_VALUE)
+      << "MappedFile: can not open '" << path << "': " << OS::getErrorMessage();
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+    CloseHandle(file_);
+    NTA_THROW << "MappedFile: '" << path << "' is empty or has no size.";
+  }
+  size_ = (Size)size.QuadPart;
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ != nullptr)
+    data_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (data_ == nullptr) {
+    const std::string error = OS::getErrorMessage();
+    if (mapping_ != nullptr)
+      CloseHandle(mapping_);
+    CloseHandle(file_);
+    NTA_THROW << "MappedFile: can not map '" << path << "': " << error;
+  }
+}
+
+MappedFile::~MappedFile() {
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) : path_(path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  NTA_CHECK(fd >= 0)
+      << "MappedFile: can not open '" << path << "': " << OS::getErrorMessage();
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    NTA_THROW << "MappedFile: '" << path << "' is empty or has no size.";
+  }
+  size_ = (Size)info.st_size;
+  void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  const std::string error = data == MAP_FAILED ? OS::getErrorMessage() : "";
+  // The mapping stays valid after the file is closed.
+  ::close(fd);
+  NTA_CHECK(data != MAP_FAILED)
+      << "MappedFile: can not map '" << path << "': " << error;
+  data_ = (const char *)data;
+}
+
+MappedFile::~MappedFile() {
+  ::munmap((void *)data_, size_);
+}
+
+#endif
+
+} // namespace nupic
@@ -0,0 +1,77 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2013, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Read-only memory mapped files
+ */
+
+#ifndef NTA_MAPPED_FILE_HPP
+#define NTA_MAPPED_FILE_HPP
+
+#include <nupic/types/Types.hpp>
+#include <string>
+
+namespace nupic {
+
+/**
+ * @Responsibility
+ * Map a whole file into memory, read-only.
+ *
+ * @Description
+ * The mapping is shared, so that several processes which map the same file
+ * share one physical copy of it through the page cache.  Pages are only read
+ * from disk when they are first touched.  The file is unmapped when the
+ * object is destroyed.
+ */
+class MappedFile {
+public:
+  /**
+   * Map the file.  Throws if the file can not be opened or mapped, or is
+   * empty.
+   */
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * The contents of the file.  The data is page aligned.
+   */
+  const char *data() const { return data_; }
+  Size size() const { return size_; }
+
+  const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+  const char *data_ = nullptr;
+  Size size_ = 0u;
+#if defined(NTA_OS_WINDOWS)
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+
+} // namespace nupic
+
+#endif // NTA_MAPPED_FILE_HPP
@@ -20,6 +20,7 @@
  * ---------------------------------------------------------------------
  */
 
+#include <cstring>
 #include <limits>
 
 #include <nupic/types/BasicType.hpp>
@@ -27,6 +28,12 @@
 #include <nupic/utils/Log.hpp>
 #include <nupic/types/Sdr.hpp>
 
+// SSE2 is part of the x86-64 baseline, so it needs no runtime dispatch.
+#if defined(__SSE2__) || (defined(_MSC_VER) && defined(_M_X64))
+  #define NTA_CONVERT_SSE2
+  #include <emmintrin.h>
+#endif
+
 
 using namespace nupic;
 
@@ -229,6 +236,40 @@ static void cpyIntoSDR(Byte *toPtr, const T *fromPtr, size_t count) {
     toPtr[i] = fromPtr[i] != zero; // 1 or 0
 }
 
+#ifdef NTA_CONVERT_SSE2
+// Real buffers going into an SDR are mostly zero, so scan 16 values at a
+// time and only write the blocks which have nonzero values.
+static void cpyIntoSDR(Byte *toPtr, const Real32 *fromPtr, size_t count) {
+  const __m128 zero = _mm_setzero_ps();
+  size_t i = 0u;
+  for(; i + 16u <= count; i += 16u) {
+    // cmpneq is true for NaN, the same as the scalar != compare.
+    const int mask =
+         _mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(fromPtr + i),      zero))
+      | (_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(fromPtr + i + 4),  zero)) << 4)
+      | (_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(fromPtr + i + 8),  zero)) << 8)
+      | (_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(fromPtr + i + 12), zero)) << 12);
+    std::memset(toPtr + i, 0, 16u);
+    if (mask != 0) {
+      for(int bit = 0; bit < 16; bit++)
+        toPtr[i + bit] = (Byte)((mask >> bit) & 1);
+    }
+  }
+  for(; i < count; i++)
+    toPtr[i] = fromPtr[i] != 0.0f; // 1 or 0
+}
+#endif
+
+template <typename T>
+static void scatterOnes(void *toPtr, const UInt *indices, size_t numIndices, size_t count) {
+  T *ptr = (T *)toPtr;
+  std::memset(ptr, 0, count * sizeof(T));
+  for(size_t i = 0u; i < numIndices; i++) {
+    NTA_ASSERT(indices[i] < count);
+    ptr[indices[i]] = (T)1;
+  }
+}
+
 
 void BasicType::convertArray(void *ptr1, NTA_BasicType toType, const void *ptr2,
                              NTA_BasicType fromType, size_t count) {
@@ -690,3 +731,46 @@ void BasicType::convertArray(void *ptr1, NTA_BasicType toType, const void *ptr2,
               << " to " << BasicType::getName(toType) << " " << e.what();
   }
 }
+
+void BasicType::convertSparseArray(void *ptr1, NTA_BasicType toType, const UInt *indices,
+                                   size_t numIndices, size_t count) {
+  if (count == 0)
+    return;
+  NTA_CHECK(ptr1 != nullptr);
+  switch (toType) {
+  case NTA_BasicType_Byte:
+  case NTA_BasicType_SDR:
+    scatterOnes<Byte>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Int16:
+    scatterOnes<Int16>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_UInt16:
+    scatterOnes<UInt16>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Int32:
+    scatterOnes<Int32>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_UInt32:
+    scatterOnes<UInt32>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Int64:
+    scatterOnes<Int64>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_UInt64:
+    scatterOnes<UInt64>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Real32:
+    scatterOnes<Real32>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Real64:
+    scatterOnes<Real64>(ptr1, indices, numIndices, count);
+    break;
+  case NTA_BasicType_Bool:
+    scatterOnes<bool>(ptr1, indices, numIndices, count);
+    break;
+  default:
+    NTA_THROW << "Could not perform sparse array conversion to "
+              << BasicType::getName(toType);
+  }
+}
@@ -35,6 +35,7 @@ namespace nupic {
 // - getSize()
 // - parse()
 // - convertArray()
+// - convertSparseArray()
 //
 class BasicType {
 public:
@@ -76,6 +77,13 @@ public:
   static void convertArray(void *toPtr, NTA_BasicType toType, const void *fromPtr,
                       NTA_BasicType fromType, size_t count);
 
+  // convert a sparse array of indices into count elements of the specified type.
+  // The elements are zeroed once and only the elements at the indices are set to 1,
+  // so the cost is in the number of indices rather than converting a dense array.
+  // All indices must be less than count.
+  static void convertSparseArray(void *toPtr, NTA_BasicType toType, const UInt *indices,
+                      size_t numIndices, size_t count);
+
 
 private:
   BasicType();
@@ -117,8 +117,10 @@ void Concatenation::initialize(const vector<SDR*> inputs, const UInt axis)
         NTA_CHECK(inp != nullptr);
         // When input SDR is assigned to, invalidate this SDR.  This SDR
         // will be recalculated next time it is accessed.
-        callback_handles_.push_back( inp->addCallback( [&] ()
-            { clear(); }));
+        callback_handles_.push_back( inp->addCallback( [&] () {
+            clear();
+            do_callbacks();
+        }));
         // This SDR can't survive without all of its input SDRs.
         destroyCallback_handles_.push_back( inp->addDestroyCallback( [&] ()
             { deconstruct(); }));
@@ -171,6 +173,22 @@ SDR_dense_t& Concatenation::getDense() const {
     return dense_;
 }
 
+SDR_sparse_t& Concatenation::getSparse() const {
+    if( !sparse_valid && axis == 0u ) {
+        // Along the first axis each input is one contiguous block, so its
+        // sparse indices only need to be offset by the preceding sizes.
+        sparse_.clear();
+        UInt offset = 0u;
+        for(const auto &sdr : inputs) {
+            for(const auto idx : sdr->getSparse())
+                sparse_.push_back( idx + offset );
+            offset += sdr->size;
+        }
+        sparse_valid = true;
+    }
+    return SDR::getSparse();
+}
+
 void Concatenation::deconstruct() {
     // Unlink everything at death.
     for(auto i = 0u; i < inputs_.size(); i++) {
@@ -135,6 +135,9 @@ protected:
  * An Concatenation is valid for as long as all of its input SDRs are alive.
  * Using it after any of it's inputs are destroyed is undefined.
  *
+ * When concatenating along axis 0 the sparse indices are computed directly
+ * from the inputs' sparse indices, without building the dense array.
+ *
  * Example Usage:
  *      SDR           A({ 100 });
  *      SDR           B({ 100 });
@@ -168,6 +171,8 @@ public:
 
     SDR_dense_t& getDense() const override;
 
+    SDR_sparse_t& getSparse() const override;
+
     ~Concatenation()
         { deconstruct(); }
 
@@ -0,0 +1,166 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of ThreadPool
+ */
+
+#include <nupic/utils/ThreadPool.hpp>
+#include <nupic/utils/Log.hpp>
+
+using namespace nupic;
+
+namespace {
+// The pool whose task the current thread is running, and its thread index.
+thread_local const ThreadPool *currentPool_   = nullptr;
+thread_local UInt              currentThread_ = 0u;
+
+/**
+ * Marks the current thread as running a task of a pool, and restores the
+ * previous marks when the task returns or throws.  A task of one pool may
+ * run another pool's parallelFor, and must still be inside the first pool
+ * afterwards.
+ */
+class CurrentPoolGuard {
+public:
+  CurrentPoolGuard(const ThreadPool *pool, UInt thread)
+    : pool_(currentPool_), thread_(currentThread_) {
+    currentPool_   = pool;
+    currentThread_ = thread;
+  }
+  ~CurrentPoolGuard() {
+    currentPool_   = pool_;
+    currentThread_ = thread_;
+  }
+  CurrentPoolGuard(const CurrentPoolGuard &) = delete;
+  CurrentPoolGuard &operator=(const CurrentPoolGuard &) = delete;
+private:
+  const ThreadPool *pool_;
+  UInt              thread_;
+};
+} // end anonymous namespace
+
+ThreadPool::ThreadPool(UInt numThreads) {
+  if( numThreads == 0u ) {
+    numThreads = std::thread::hardware_concurrency();
+    if( numThreads == 0u ) // Unknown.
+      numThreads = 1u;
+  }
+  workers_.reserve( numThreads - 1u );
+  for(UInt thread = 1u; thread < numThreads; thread++) {
+    workers_.emplace_back( &ThreadPool::workerLoop_, this, thread );
+  }
+}
+
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    shutdown_ = true;
+  }
+  start_.notify_all();
+  for( auto &worker : workers_ )
+    worker.join();
+}
+
+
+void ThreadPool::runChunk_(UInt thread) {
+  const UInt64 size  = end_ - begin_;
+  const UInt   T     = numThreads();
+  const UInt   begin = begin_ + (UInt)(size * thread / T);
+  const UInt   end   = begin_ + (UInt)(size * (thread + 1u) / T);
+  if( begin == end )
+    return;
+  CurrentPoolGuard guard( this, thread );
+  try {
+    (*task_)( begin, end, thread );
+  }
+  catch(...) {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    if( !error_ )
+      error_ = std::current_exception();
+  }
+}
+
+
+void ThreadPool::workerLoop_(UInt thread) {
+  UInt64 seen = 0u;
+  while( true ) {
+    {
+      std::unique_lock<std::mutex> lock( mutex_ );
+      start_.wait( lock, [&]() { return shutdown_ || generation_ != seen; });
+      if( shutdown_ )
+        return;
+      seen = generation_;
+    }
+
+    runChunk_( thread );
+
+    {
+      std::lock_guard<std::mutex> lock( mutex_ );
+      if( --pending_ == 0u )
+        done_.notify_one();
+    }
+  }
+}
+
+
+void ThreadPool::parallelFor(UInt begin, UInt end, const Task &task) {
+  NTA_CHECK( begin <= end );
+  if( begin == end )
+    return;
+
+  if( workers_.empty() ) {
+    task( begin, end, 0u );
+    return;
+  }
+
+  if( currentPool_ == this ) { // Nested call from one of our tasks.
+    task( begin, end, currentThread_ );
+    return;
+  }
+
+  // task_, begin_ and end_ describe a single call, hold them until it ends.
+  std::lock_guard<std::mutex> call( callMutex_ );
+  {
+    std::lock_guard<std::mutex> lock( mutex_ );
+    task_    = &task;
+    begin_   = begin;
+    end_     = end;
+    error_   = nullptr;
+    pending_ = (UInt)workers_.size();
+    generation_++;
+  }
+  start_.notify_all();
+
+  runChunk_( 0u );
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock( mutex_ );
+    done_.wait( lock, [&]() { return pending_ == 0u; });
+    task_ = nullptr;
+    std::swap( error, error_ );
+  }
+  if( error )
+    std::rethrow_exception( error );
+}
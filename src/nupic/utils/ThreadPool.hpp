@@ -0,0 +1,127 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the ThreadPool class
+ */
+
+#ifndef NTA_THREAD_POOL_HPP
+#define NTA_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+/**
+ * A fixed size pool of worker threads for data parallel loops.
+ *
+ * @b Description
+ * The pool splits an index range into one contiguous chunk per thread and
+ * runs a function on every chunk.  The chunk boundaries depend only on the
+ * size of the range and on the number of threads, never on timing, so an
+ * algorithm which writes the results for index `i` only from the chunk that
+ * contains `i` produces the same output as a serial loop.
+ *
+ * The calling thread executes the first chunk itself, so a pool with N
+ * threads starts N-1 workers.  A pool with a single thread runs everything
+ * on the caller.
+ *
+ * Example usage:
+ *
+ *     ThreadPool pool( 4 );
+ *     pool.parallelFor( 0, data.size(), [&](UInt begin, UInt end, UInt thread) {
+ *       for(UInt i = begin; i < end; i++)
+ *         data[i] = f( i );
+ *     });
+ */
+class ThreadPool {
+public:
+  /**
+   * Function called on each chunk of the range: (begin, end, threadIndex).
+   * The threadIndex is in [0, numThreads) and is unique within one call to
+   * parallelFor, so it can be used to select per-thread scratch buffers.
+   */
+  typedef std::function<void(UInt, UInt, UInt)> Task;
+
+  /**
+   * @param numThreads Total number of threads, including the caller.
+   *                   Zero selects std::thread::hardware_concurrency().
+   */
+  explicit ThreadPool(UInt numThreads = 0u);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @retval Total number of threads, including the caller.
+   */
+  UInt numThreads() const { return (UInt)workers_.size() + 1u; }
+
+  /**
+   * Run the task on every chunk of [begin, end) and wait for all of them to
+   * finish.  If a task throws, the first exception is rethrown here after
+   * all chunks have finished.
+   *
+   * Chunk `t` is [begin + n*t/T, begin + n*(t+1)/T) where n = end - begin
+   * and T = numThreads().  Empty chunks are not run.
+   *
+   * A task may call parallelFor on the same pool again.  The nested call
+   * runs its whole range inline, on the calling thread and with that
+   * thread's index, so per-thread scratch buffers stay private.
+   *
+   * Calls from several external threads are serialized: each one waits
+   * until the previous call has finished before it hands out its chunks.
+   */
+  void parallelFor(UInt begin, UInt end, const Task &task);
+
+private:
+  void workerLoop_(UInt thread);
+  void runChunk_(UInt thread);
+
+  std::vector<std::thread> workers_;
+
+  std::mutex              callMutex_; // Serializes external parallelFor calls.
+  std::mutex              mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  UInt64                  generation_ = 0u;
+  UInt                    pending_    = 0u;
+  bool                    shutdown_   = false;
+
+  const Task        *task_  = nullptr;
+  UInt               begin_ = 0u;
+  UInt               end_   = 0u;
+  std::exception_ptr error_;
+};
+
+} // end namespace nupic
+
+#endif // NTA_THREAD_POOL_HPP
@@ -0,0 +1,182 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for ConnectionsCheckpoint
+ */
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <vector>
+
+#include <nupic/algorithms/ConnectionsCheckpoint.hpp>
+#include <nupic/os/Directory.hpp>
+#include <nupic/os/Path.hpp>
+#include <nupic/types/Sdr.hpp>
+#include <nupic/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+using nupic::sdr::SDR;
+
+static const string checkpointDir = "TestOutputDir/checkpoint";
+
+static void createRandomSegments(Connections &connections, Random &rng,
+                                 UInt numSegments) {
+  for (UInt i = 0; i < numSegments; i++) {
+    const Segment segment =
+        connections.createSegment(rng.getUInt32(connections.numCells()));
+    for (UInt j = 0; j < 20u; j++) {
+      connections.createSynapse(segment, rng.getUInt32(connections.numCells()),
+                                (Permanence)rng.getReal64());
+    }
+  }
+}
+
+static string readFile(const string &path) {
+  ifstream in(path, ios::binary);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void writeFile(const string &path, const string &data) {
+  ofstream out(path, ios::binary);
+  out.write(data.data(), (streamsize)data.size());
+}
+
+static Connections restored() {
+  Connections connections;
+  ConnectionsCheckpoint::restore(checkpointDir, connections);
+  return connections;
+}
+
+TEST(ConnectionsCheckpointTest, DeltasReplayOverSnapshot) {
+  Directory::removeTree("TestOutputDir", true);
+  Random rng(1);
+  Connections connections(2000u);
+  createRandomSegments(connections, rng, 1000u);
+  ConnectionsCheckpoint checkpoint(connections, checkpointDir);
+  checkpoint.save();
+  ASSERT_EQ(0u, checkpoint.numDeltas());
+  ASSERT_EQ(connections, restored());
+
+  // Every kind of change.
+  SDR input({2000u});
+  input.randomize(0.2f, rng);
+  const Segment adapted = connections.segmentsForCell(
+      connections.cellForSegment(3u))[0];
+  connections.adaptSegment(adapted, input, 0.01f, 0.01f);
+  const Synapse updated = connections.synapsesForSegment(adapted)[1];
+  connections.updateSynapsePermanence(
+      updated, connections.dataForSynapse(updated).permanence + 0.001f);
+  connections.destroySynapse(connections.synapsesForSegment(adapted)[0]);
+  connections.destroySegment(5u);
+  createRandomSegments(connections, rng, 3u);
+  ASSERT_FALSE(checkpoint.changedCells().empty());
+  ASSERT_LT(checkpoint.changedCells().size(), 10u);
+
+  checkpoint.save();
+  ASSERT_EQ(1u, checkpoint.numDeltas());
+  ASSERT_TRUE(checkpoint.changedCells().empty());
+  ASSERT_EQ(connections, restored());
+  // The delta scales with the changes.
+  ASSERT_LT(Path::getFileSize(ConnectionsCheckpoint::deltaPath(checkpointDir, 1u)) * 50u,
+            Path::getFileSize(ConnectionsCheckpoint::snapshotPath(checkpointDir)));
+
+  // A delta without changes.
+  checkpoint.save();
+  ASSERT_EQ(2u, checkpoint.numDeltas());
+  ASSERT_EQ(connections, restored());
+
+  // Corrupt deltas are detected.
+  const string path = ConnectionsCheckpoint::deltaPath(checkpointDir, 1u);
+  string data = readFile(path);
+  data[data.size() - 1] ^= 0x10;
+  writeFile(path, data);
+  Connections corrupt;
+  EXPECT_ANY_THROW(ConnectionsCheckpoint::restore(checkpointDir, corrupt));
+
+  Directory::removeTree("TestOutputDir");
+}
+
+TEST(ConnectionsCheckpointTest, Compaction) {
+  Directory::removeTree("TestOutputDir", true);
+  Random rng(2);
+  Connections connections(500u);
+  createRandomSegments(connections, rng, 100u);
+  {
+    ConnectionsCheckpoint checkpoint(connections, checkpointDir, 2u);
+    for (UInt i = 0; i < 5u; i++) {
+      createRandomSegments(connections, rng, 5u);
+      checkpoint.save();
+      ASSERT_EQ(connections, restored());
+    }
+    // snapshot, delta, delta, snapshot, delta
+    ASSERT_EQ(1u, checkpoint.numDeltas());
+    ASSERT_FALSE(Path::exists(ConnectionsCheckpoint::deltaPath(checkpointDir, 2u)));
+  }
+
+  // A stale delta from before the last snapshot is ignored.
+  const string delta1 = readFile(ConnectionsCheckpoint::deltaPath(checkpointDir, 1u));
+  createRandomSegments(connections, rng, 5u);
+  {
+    ConnectionsCheckpoint checkpoint(connections, checkpointDir, 2u);
+    checkpoint.save();
+  }
+  writeFile(ConnectionsCheckpoint::deltaPath(checkpointDir, 1u), delta1);
+  ASSERT_EQ(connections, restored());
+
+  Directory::removeTree("TestOutputDir");
+}
+
+TEST(ConnectionsCheckpointTest, ReplayKeepsSegmentNumbers) {
+  Directory::removeTree("TestOutputDir", true);
+  // One segment per cell, like the SpatialPooler.
+  Random rng(3);
+  Connections connections(100u);
+  for (CellIdx cell = 0; cell < 100u; cell++) {
+    const Segment segment = connections.createSegment(cell);
+    for (UInt j = 0; j < 10u; j++)
+      connections.createSynapse(segment, rng.getUInt32(100u), (Permanence)rng.getReal64());
+  }
+  ConnectionsCheckpoint checkpoint(connections, checkpointDir);
+  checkpoint.save();
+  SDR input({100u});
+  for (CellIdx cell = 0; cell < 100u; cell += 7u) {
+    input.randomize(0.3f, rng);
+    connections.adaptSegment(cell, input, 0.05f, 0.02f);
+  }
+  checkpoint.save();
+
+  const Connections loaded = restored();
+  ASSERT_EQ(connections, loaded);
+  for (CellIdx cell = 0; cell < 100u; cell++) {
+    ASSERT_EQ(vector<Segment>({cell}), loaded.segmentsForCell(cell));
+  }
+
+  Directory::removeTree("TestOutputDir");
+}
+
+} // end namespace testing
@@ -0,0 +1,214 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for the Connections permanence kernels
+ */
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include <nupic/algorithms/ConnectionsKernels.hpp>
+#include <nupic/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+
+TEST(ConnectionsKernelsTest, ScalarClipsAndFindsCrossings) {
+  vector<Real32> permanences = {0.0f, 0.45f, 0.55f, 0.95f, 0.5f};
+  vector<Real32> deltas      = {-0.1f, 0.1f, -0.1f, 0.1f, 0.0f};
+  vector<UInt32> crossings;
+  addPermanences(permanences.data(), (UInt32)permanences.size(),
+                 deltas.data(), 0.0f, 0.5f, crossings, SimdLevel::Scalar);
+
+  ASSERT_EQ(0.0f, permanences[0]);
+  ASSERT_EQ(0.45f + 0.1f, permanences[1]);
+  ASSERT_EQ(0.55f - 0.1f, permanences[2]);
+  ASSERT_EQ(1.0f, permanences[3]);
+  ASSERT_EQ(0.5f, permanences[4]);
+  ASSERT_EQ(vector<UInt32>({1u, 2u}), crossings);
+}
+
+TEST(ConnectionsKernelsTest, AllLevelsMatchScalar) {
+  Random rng(42);
+  const Real32 threshold = 0.5f;
+  for (UInt32 count : {0u, 1u, 3u, 4u, 7u, 8u, 9u, 31u, 100u, 1000u}) {
+    vector<Real32> initial(count), deltas(count);
+    for (UInt32 i = 0; i < count; i++) {
+      initial[i] = (Real32)rng.getReal64();
+      deltas[i]  = (Real32)(rng.getReal64() - 0.5) * 0.4f;
+    }
+    // Some values exactly on the threshold and on the bounds.
+    if (count > 3u) {
+      initial[0] = threshold;
+      initial[1] = 1.0f;
+      initial[2] = 0.0f;
+      deltas[3]  = threshold - initial[3];
+    }
+
+    for (const bool perSynapse : {true, false}) {
+      const Real32 *deltaPtr = perSynapse ? deltas.data() : nullptr;
+      vector<Real32> expected(initial);
+      vector<UInt32> expectedCrossings;
+      addPermanences(expected.data(), count, deltaPtr, 0.07f, threshold,
+                     expectedCrossings, SimdLevel::Scalar);
+
+      for (int level = 0; level <= (int)simdLevel(); level++) {
+        vector<Real32> actual(initial);
+        vector<UInt32> crossings;
+        addPermanences(actual.data(), count, deltaPtr, 0.07f, threshold,
+                       crossings, (SimdLevel)level);
+        ASSERT_EQ(expected, actual) << "level " << level;
+        ASSERT_EQ(expectedCrossings, crossings) << "level " << level;
+      }
+    }
+  }
+}
+
+TEST(ConnectionsKernelsTest, QuantizedThresholdIsExact) {
+  for (const Real32 threshold : {0.0f, 1e-6f, 0.1f, 0.5f - 1e-6f, 0.5f,
+                                 0.3f + 0.5f / 65535.0f, 0.999999f, 1.0f}) {
+    const UInt16 quantized = quantizeThreshold(threshold);
+    ASSERT_GE(dequantizePermanence(quantized), threshold);
+    if (quantized > 0u) {
+      ASSERT_LT(dequantizePermanence((UInt16)(quantized - 1u)), threshold);
+    }
+  }
+  ASSERT_EQ(0u, quantizePermanence(-0.5f));
+  ASSERT_EQ(quantizedPermanenceMax, quantizePermanence(2.0f));
+  ASSERT_EQ(1.0f, dequantizePermanence(quantizedPermanenceMax));
+}
+
+TEST(ConnectionsKernelsTest, QuantizedSaturatesAndFindsCrossings) {
+  const UInt16 threshold = 1000u;
+  vector<UInt16> permanences = {10u, 990u, 1005u, 65530u, 1000u};
+  vector<UInt16> increments  = {0u,  20u,  0u,    100u,   0u};
+  vector<UInt16> decrements  = {50u, 0u,   10u,   0u,     0u};
+  vector<UInt32> crossings;
+  addQuantizedPermanences(permanences.data(), (UInt32)permanences.size(),
+                          increments.data(), 0u, decrements.data(), 0u,
+                          threshold, crossings, SimdLevel::Scalar);
+
+  ASSERT_EQ(vector<UInt16>({0u, 1010u, 995u, 65535u, 1000u}), permanences);
+  ASSERT_EQ(vector<UInt32>({1u, 2u}), crossings);
+}
+
+TEST(ConnectionsKernelsTest, QuantizedAllLevelsMatchScalar) {
+  Random rng(7);
+  const UInt16 threshold = quantizeThreshold(0.5f);
+  for (UInt32 count : {0u, 1u, 7u, 8u, 9u, 15u, 16u, 17u, 33u, 100u, 1000u}) {
+    vector<UInt16> initial(count), increments(count), decrements(count);
+    for (UInt32 i = 0; i < count; i++) {
+      initial[i] = (UInt16)rng.getUInt32(65536u);
+      const UInt16 step = (UInt16)rng.getUInt32(20000u);
+      increments[i] = rng.getUInt32(2u) ? step : 0u;
+      decrements[i] = increments[i] ? 0u : step;
+    }
+    // Some values exactly on the threshold and on the bounds.
+    if (count > 3u) {
+      initial[0] = threshold;
+      initial[1] = quantizedPermanenceMax;
+      initial[2] = 0u;
+      initial[3] = threshold - 1u;
+      increments[3] = 1u;
+      decrements[3] = 0u;
+    }
+
+    for (const bool perSynapse : {true, false}) {
+      const UInt16 *up   = perSynapse ? increments.data() : nullptr;
+      const UInt16 *down = perSynapse ? decrements.data() : nullptr;
+      vector<UInt16> expected(initial);
+      vector<UInt32> expectedCrossings;
+      addQuantizedPermanences(expected.data(), count, up, 3000u, down, 0u,
+                              threshold, expectedCrossings, SimdLevel::Scalar);
+
+      for (int level = 0; level <= (int)simdLevel(); level++) {
+        vector<UInt16> actual(initial);
+        vector<UInt32> crossings;
+        addQuantizedPermanences(actual.data(), count, up, 3000u, down, 0u,
+                                threshold, crossings, (SimdLevel)level);
+        ASSERT_EQ(expected, actual) << "level " << level;
+        ASSERT_EQ(expectedCrossings, crossings) << "level " << level;
+      }
+    }
+  }
+}
+
+TEST(ConnectionsKernelsTest, BitmapOverlaps) {
+  Random rng(3);
+  const UInt32 numWords = 5u, numSegments = 7u;
+  vector<UInt64> masks(numWords * numSegments), input(numWords);
+  for (auto &word : masks)
+    word = ((UInt64)rng.getUInt32() << 32) | rng.getUInt32();
+  for (auto &word : input)
+    word = ((UInt64)rng.getUInt32() << 32) | rng.getUInt32();
+  masks[0] = ~0ull;
+  input[0] = ~0ull;
+
+  vector<UInt32> expected(numSegments, 1u);
+  for (UInt32 segment = 2u; segment < 6u; segment++) {
+    for (UInt32 w = 0; w < numWords; w++) {
+      const UInt64 bits = masks[segment * numWords + w] & input[w];
+      for (UInt32 bit = 0; bit < 64u; bit++)
+        expected[segment] += (bits >> bit) & 1u;
+    }
+  }
+
+  for (int level = 0; level <= (int)simdLevel(); level++) {
+    vector<UInt32> counts(numSegments, 1u);
+    addBitmapOverlaps(masks.data(), numWords, input.data(), 2u, 6u,
+                      counts.data(), (SimdLevel)level);
+    ASSERT_EQ(expected, counts) << "level " << level;
+  }
+}
+
+TEST(ConnectionsKernelsTest, BitmapOverlapsBatch) {
+  Random rng(5);
+  const UInt32 numWords = 3u, numSegments = 6u, numInputs = 4u;
+  vector<UInt64> masks(numWords * numSegments), inputs(numWords * numInputs);
+  for (auto &word : masks)
+    word = ((UInt64)rng.getUInt32() << 32) | rng.getUInt32();
+  for (auto &word : inputs)
+    word = ((UInt64)rng.getUInt32() << 32) | rng.getUInt32();
+
+  // The batch matches one call per input.
+  vector<UInt32> expected(numInputs * numSegments, 0u);
+  for (UInt32 i = 0; i < numInputs; i++) {
+    addBitmapOverlaps(masks.data(), numWords, inputs.data() + i * numWords,
+                      1u, 5u, expected.data() + i * numSegments,
+                      SimdLevel::Scalar);
+  }
+
+  for (int level = 0; level <= (int)simdLevel(); level++) {
+    vector<UInt32> counts(numInputs * numSegments, 0u);
+    addBitmapOverlapsBatch(masks.data(), numWords, inputs.data(), numInputs,
+                           1u, 5u, counts.data(), numSegments,
+                           (SimdLevel)level);
+    ASSERT_EQ(expected, counts) << "level " << level;
+  }
+}
+
+} // end namespace testing
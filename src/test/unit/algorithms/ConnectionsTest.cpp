@@ -27,7 +27,12 @@
 #include "gtest/gtest.h"
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <nupic/algorithms/Connections.hpp>
+#include <nupic/algorithms/ConnectionsKernels.hpp>
+#include <nupic/math/Math.hpp>
+#include <nupic/utils/Random.hpp>
 
 namespace testing {
     
@@ -36,6 +41,7 @@ using namespace nupic;
 using namespace nupic::algorithms::connections;
 using nupic::sdr::SDR;
 using nupic::sdr::SDR_dense_t;
+using nupic::sdr::SDR_sparse_t;
 
 #define EPSILON 0.0000001
 
@@ -289,6 +295,75 @@ TEST(ConnectionsTest, ReuseSegmentWithDestroyedSynapses) {
   EXPECT_EQ(0ul, connections.synapsesForSegment(reincarnated).size());
 }
 
+/**
+ * The packed per segment lists of presynaptic cells and permanences mirror
+ * the synapse data through creates, destroys and permanence updates.
+ */
+TEST(ConnectionsTest, PackedSegmentData) {
+  Connections connections(1024, 0.5f);
+  ASSERT_FALSE(connections.getPackedSegments());
+  connections.setPackedSegments(true);
+  ASSERT_TRUE(connections.getPackedSegments());
+  const auto expectPacked = [&](Segment segment) {
+    const SegmentData &segmentData = connections.dataForSegment(segment);
+    ASSERT_EQ(segmentData.synapses.size(), segmentData.presynapticCells.size());
+    ASSERT_EQ(segmentData.synapses.size(), segmentData.permanences.size());
+    for (UInt i = 0; i < segmentData.synapses.size(); i++) {
+      const SynapseData &synapseData =
+          connections.dataForSynapse(segmentData.synapses[i]);
+      ASSERT_EQ(synapseData.presynapticCell, segmentData.presynapticCells[i]);
+      ASSERT_EQ(synapseData.permanence, segmentData.permanences[i]);
+    }
+  };
+
+  Segment segment = connections.createSegment(10);
+  vector<Synapse> synapses;
+  for (CellIdx presyn = 0; presyn < 10; presyn++) {
+    synapses.push_back(connections.createSynapse(segment, presyn, 0.05f * presyn));
+  }
+  expectPacked(segment);
+
+  connections.destroySynapse(synapses[3]);
+  connections.destroySynapse(synapses[0]);
+  connections.updateSynapsePermanence(synapses[9], 0.1f);
+  connections.createSynapse(segment, 42, 0.7f);
+  expectPacked(segment);
+  ASSERT_EQ(vector<CellIdx>({1, 2, 4, 5, 6, 7, 8, 9, 42}),
+            connections.dataForSegment(segment).presynapticCells);
+
+  SDR inputs({1024});
+  inputs.setSparse(SDR_sparse_t({1, 2, 42}));
+  connections.adaptSegment(segment, inputs, 0.1f, 0.05f);
+  expectPacked(segment);
+  connections.bumpSegment(segment, 0.2f);
+  expectPacked(segment);
+  connections.raisePermanencesToThreshold(segment, 0.5f, 9);
+  expectPacked(segment);
+  ASSERT_EQ(9u, connections.dataForSegment(segment).numConnected);
+
+  // Synapses keep their creation order.
+  ASSERT_EQ(vector<CellIdx>({1, 2, 4, 5, 6, 7, 8, 9, 42}),
+            connections.dataForSegment(segment).presynapticCells);
+
+  // The packed lists are released and rebuilt, and learning without them
+  // gives the same permanences.
+  Connections unpacked = connections;
+  unpacked.setPackedSegments(false);
+  ASSERT_TRUE(unpacked.dataForSegment(segment).presynapticCells.empty());
+  ASSERT_TRUE(unpacked.dataForSegment(segment).permanences.empty());
+  connections.adaptSegment(segment, inputs, 0.1f, 0.05f);
+  unpacked.adaptSegment(segment, inputs, 0.1f, 0.05f);
+  connections.bumpSegment(segment, -0.15f);
+  unpacked.bumpSegment(segment, -0.15f);
+  connections.raisePermanencesToThreshold(segment, 0.5f, 9);
+  unpacked.raisePermanencesToThreshold(segment, 0.5f, 9);
+  ASSERT_EQ(connections, unpacked);
+  ASSERT_EQ(connections.dataForSegment(segment).numConnected,
+            unpacked.dataForSegment(segment).numConnected);
+  unpacked.setPackedSegments(true);
+  expectPacked(segment);
+}
+
 /**
  * Creates a synapse and updates its permanence, and makes sure that its
  * data was correctly updated.
@@ -364,6 +439,169 @@ TEST(ConnectionsTest, testComputeActivity) {
   ASSERT_EQ(3ul, numActivePotentialSynapsesForSegment[segment2_1]);
 }
 
+/**
+ * Repeatedly computes activity without changing the connections, which
+ * switches computeActivity over to the compact presynaptic index, then
+ * modifies the connections and checks that the index is not stale.
+ */
+TEST(ConnectionsTest, testComputeActivityPresynapticIndex) {
+  Connections connections(1024);
+  setupSampleConnections(connections);
+
+  const vector<UInt32> input = {50, 52, 53, 80, 81, 82, 150, 151, 2000};
+  vector<UInt32> numConnected, numPotential;
+  const auto compute = [&]() {
+    numConnected.assign(connections.segmentFlatListLength(), 0);
+    numPotential.assign(connections.segmentFlatListLength(), 0);
+    connections.computeActivity(numConnected, numPotential, input, 0.5f);
+  };
+
+  compute();
+  const auto expectedConnected = numConnected;
+  const auto expectedPotential = numPotential;
+  for(int i = 0; i < 3; i++) {
+    compute();
+    ASSERT_EQ(expectedConnected, numConnected);
+    ASSERT_EQ(expectedPotential, numPotential);
+  }
+
+  // Connect synapse 151 and add a new presynaptic cell.
+  const Segment segment = connections.getSegment(10, 0);
+  const Synapse synapse = connections.synapsesForSegment(segment)[1];
+  connections.updateSynapsePermanence(synapse, 0.85f);
+  connections.createSynapse(segment, 2000, 0.85f);
+  for(int i = 0; i < 3; i++) {
+    compute();
+    ASSERT_EQ(expectedConnected[segment] + 2u, numConnected[segment]);
+    ASSERT_EQ(expectedPotential[segment] + 1u, numPotential[segment]);
+  }
+
+  connections.destroySynapse(synapse);
+  for(int i = 0; i < 3; i++) {
+    compute();
+    ASSERT_EQ(expectedConnected[segment] + 1u, numConnected[segment]);
+    ASSERT_EQ(expectedPotential[segment], numPotential[segment]);
+  }
+}
+
+/**
+ * Threads may call computeActivity on the same connections at once, while
+ * the first calls rebuild its caches.
+ */
+TEST(ConnectionsTest, testComputeActivityConcurrent) {
+  for (const auto engine : {Connections::ActivityEngine::Sparse,
+                            Connections::ActivityEngine::Bitmap}) {
+    // Large enough that the threads overlap with the rebuilds.
+    Random rng(17);
+    Connections connections(2048);
+    for (UInt i = 0; i < 4000u; i++) {
+      const Segment segment = connections.createSegment(rng.getUInt32(2048u));
+      for (UInt j = 0; j < 30u; j++)
+        connections.createSynapse(segment, rng.getUInt32(2048u),
+                                  (Permanence)rng.getReal64());
+    }
+    connections.setActivityEngine(engine);
+    const Connections copy = connections;
+
+    vector<UInt32> input;
+    for (UInt32 cell = 0; cell < 2048u; cell += 20u)
+      input.push_back(cell);
+    vector<UInt32> expectedConnected(copy.segmentFlatListLength(), 0);
+    vector<UInt32> expectedPotential(copy.segmentFlatListLength(), 0);
+    copy.computeActivity(expectedConnected, expectedPotential, input, 0.5f);
+
+    vector<UInt> matches(4u, 1u);
+    vector<std::thread> threads;
+    for (UInt t = 0; t < matches.size(); t++) {
+      threads.emplace_back([&, t]() {
+        for (int i = 0; i < 20; i++) {
+          vector<UInt32> numConnected(connections.segmentFlatListLength(), 0);
+          vector<UInt32> numPotential(connections.segmentFlatListLength(), 0);
+          connections.computeActivity(numConnected, numPotential, input, 0.5f);
+          vector<UInt32> connectedOnly(connections.segmentFlatListLength(), 0);
+          connections.computeActivity(connectedOnly, input);
+          if (numConnected != expectedConnected ||
+              numPotential != expectedPotential ||
+              connectedOnly != expectedConnected)
+            matches[t] = 0u;
+        }
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    ASSERT_EQ(vector<UInt>(4u, 1u), matches);
+  }
+}
+
+/**
+ * The sparse and bitmap activity engines give the same connected synapse
+ * counts, while synapses connect, disconnect, are created and destroyed.
+ */
+TEST(ConnectionsTest, testComputeActivityEngines) {
+  Random rng(11);
+  Connections connections(200, 0.5f);
+  vector<Synapse> synapses;
+  for (CellIdx cell = 0; cell < 200; cell++) {
+    const Segment segment = connections.createSegment(cell);
+    for (CellIdx presyn = 0; presyn < 300; presyn++) {
+      if (rng.getReal64() < 0.3) {
+        synapses.push_back(connections.createSynapse(
+            segment, presyn, (Permanence)rng.getReal64()));
+      }
+    }
+  }
+
+  const auto expectSameActivity = [&](Real64 density) {
+    vector<CellIdx> active;
+    for (CellIdx presyn = 0; presyn < 400; presyn++) {
+      if (rng.getReal64() < density)
+        active.push_back(presyn);
+    }
+    vector<UInt32> expected(connections.segmentFlatListLength(), 0u);
+    connections.setActivityEngine(Connections::ActivityEngine::Sparse);
+    connections.computeActivity(expected, active);
+
+    ThreadPool pool(3u);
+    for (const auto engine : {Connections::ActivityEngine::Bitmap,
+                              Connections::ActivityEngine::Auto}) {
+      connections.setActivityEngine(engine);
+      vector<UInt32> actual(connections.segmentFlatListLength(), 0u);
+      connections.computeActivity(actual, active);
+      ASSERT_EQ(expected, actual);
+
+      vector<UInt32> threaded(connections.segmentFlatListLength(), 0u);
+      connections.computeActivity(threaded, active, pool);
+      ASSERT_EQ(expected, threaded);
+    }
+  };
+
+  for (const Real64 density : {0.01, 0.2, 0.6}) {
+    expectSameActivity(density);
+  }
+
+  // Connect and disconnect synapses, and destroy some.
+  for (UInt i = 0; i < 500; i++) {
+    const Synapse synapse = synapses[rng.getUInt32((UInt32)synapses.size())];
+    connections.updateSynapsePermanence(synapse, (Permanence)rng.getReal64());
+  }
+  for (UInt i = 0; i < 5; i++) {
+    connections.destroySynapse(synapses[i * 100]);
+  }
+  expectSameActivity(0.2);
+
+  // A new segment, and presynaptic cells beyond the old bitmask range.
+  const Segment segment = connections.createSegment(7);
+  connections.createSynapse(segment, 350, 0.9f);
+  connections.createSynapse(segment, 399, 0.9f);
+  connections.createSynapse(segment, 10, 0.9f);
+  expectSameActivity(0.5);
+
+  // Two connected synapses onto the same presynaptic cell count twice, which
+  // the bitmap engine can not represent.
+  connections.createSynapse(segment, 10, 0.9f);
+  expectSameActivity(0.5);
+}
+
 TEST(ConnectionsTest, testAdaptSynapses) {
   UInt numCells = 4;
   // NOTE: One segment per cell.
@@ -559,7 +797,7 @@ public:
   TestConnectionsEventHandler()
       : didCreateSegment(false), didDestroySegment(false),
         didCreateSynapse(false), didDestroySynapse(false),
-        didUpdateSynapsePermanence(false) {}
+        didUpdateSynapsePermanence(false), numUpdateSegmentPermanences(0u) {}
 
   virtual ~TestConnectionsEventHandler() {
     TEST_EVENT_HANDLER_DESTRUCTED = true;
@@ -578,11 +816,16 @@ public:
     didUpdateSynapsePermanence = true;
   }
 
+  virtual void onUpdateSegmentPermanences(Segment segment) {
+    numUpdateSegmentPermanences++;
+  }
+
   bool didCreateSegment;
   bool didDestroySegment;
   bool didCreateSynapse;
   bool didDestroySynapse;
   bool didUpdateSynapsePermanence;
+  UInt numUpdateSegmentPermanences;
 };
 
 /**
@@ -617,6 +860,45 @@ TEST(ConnectionsTest, subscribe) {
   connections.unsubscribe(token);
 }
 
+/**
+ * onUpdateSegmentPermanences fires once per segment level update, and only
+ * when a permanence changes.
+ */
+TEST(ConnectionsTest, updateSegmentPermanencesEvent) {
+  for( const bool quantized : {false, true} ) {
+    Connections connections(1024, 0.5f);
+    connections.setQuantizedPermanences(quantized);
+    TestConnectionsEventHandler *handler = new TestConnectionsEventHandler();
+    auto token = connections.subscribe(handler);
+
+    const Segment segment = connections.createSegment(42);
+    const Synapse synapse = connections.createSynapse(segment, 41, 0.25f);
+    connections.createSynapse(segment, 40, 0.75f);
+    EXPECT_EQ(0u, handler->numUpdateSegmentPermanences);
+
+    connections.updateSynapsePermanence(synapse, 0.25f);
+    EXPECT_EQ(0u, handler->numUpdateSegmentPermanences);
+    connections.updateSynapsePermanence(synapse, 0.30f);
+    EXPECT_EQ(1u, handler->numUpdateSegmentPermanences);
+
+    SDR input({1024u});
+    input.setSparse(SDR_sparse_t{41u});
+    connections.adaptSegment(segment, input, 0.1f, 0.1f);
+    EXPECT_EQ(2u, handler->numUpdateSegmentPermanences);
+    connections.bumpSegment(segment, 0.0f);
+    EXPECT_EQ(2u, handler->numUpdateSegmentPermanences);
+
+    // Clipped at the maximum, nothing changes.
+    connections.bumpSegment(segment, 1.0f);
+    EXPECT_EQ(3u, handler->numUpdateSegmentPermanences);
+    connections.bumpSegment(segment, 1.0f);
+    connections.updateSynapsePermanence(synapse, 2.0f);
+    EXPECT_EQ(3u, handler->numUpdateSegmentPermanences);
+
+    connections.unsubscribe(token);
+  }
+}
+
 /**
  * Make sure the event handler is destructed on unsubscribe.
  */
@@ -677,4 +959,359 @@ TEST(ConnectionsTest, testSaveLoad) {
   ASSERT_EQ(c1, c2);
 }
 
+class RemapEventHandler : public ConnectionsEventHandler {
+public:
+  RemapEventHandler(vector<Segment> &segmentRemap) : segmentRemap(segmentRemap) {}
+  virtual void onCompact(const vector<Segment> &segments,
+                         const vector<Synapse> &synapses) override {
+    segmentRemap = segments;
+  }
+  vector<Segment> &segmentRemap;
+};
+
+TEST(ConnectionsTest, testCompact) {
+  Random rng(17);
+  Connections c(500u), before;
+  // Holes in both flat lists.
+  for (UInt i = 0; i < 400u; i++) {
+    const Segment segment = c.createSegment(rng.getUInt32(500u));
+    for (UInt j = 0; j < 15u; j++)
+      c.createSynapse(segment, rng.getUInt32(500u), (Permanence)rng.getReal64());
+  }
+  for (Segment segment = 0; segment < 400u; segment += 3u)
+    c.destroySegment(segment);
+  for (Segment segment = 1; segment < 400u; segment += 3u)
+    c.destroySynapse(c.synapsesForSegment(segment)[0]);
+  ASSERT_GT(c.fragmentation(), 0.3f);
+  ASSERT_FALSE(c.needsCompaction());
+  c.setCompactionThreshold(0.3f);
+  ASSERT_TRUE(c.needsCompaction());
+
+  const vector<CellIdx> input = {1, 5, 17, 40, 41, 42, 100, 250, 251, 499};
+  c.setActivityEngine(Connections::ActivityEngine::Bitmap);
+  vector<UInt32> connected1(c.segmentFlatListLength()), potential1(c.segmentFlatListLength());
+  c.computeActivity(connected1, potential1, input, 0.5f);
+  stringstream ss;
+  c.save(ss);
+  before.load(ss);
+
+  vector<Segment> notified;
+  c.subscribe(new RemapEventHandler(notified));
+  const vector<Segment> remap = c.compact();
+  ASSERT_EQ(remap, notified);
+  ASSERT_EQ(c.numSegments(), c.segmentFlatListLength());
+  ASSERT_EQ(0.0f, c.fragmentation());
+  ASSERT_FALSE(c.needsCompaction());
+  ASSERT_EQ(before, c);
+
+  // The same activity, renumbered.
+  vector<UInt32> connected2(c.segmentFlatListLength()), potential2(c.segmentFlatListLength());
+  c.computeActivity(connected2, potential2, input, 0.5f);
+  for (Segment segment = 0; segment < remap.size(); segment++) {
+    if (remap[segment] == Connections::INVALID_SEGMENT) {
+      ASSERT_EQ(segment % 3u, 0u);
+      continue;
+    }
+    ASSERT_EQ(connected1[segment], connected2[remap[segment]]);
+    ASSERT_EQ(potential1[segment], potential2[remap[segment]]);
+  }
+  c.setActivityEngine(Connections::ActivityEngine::Sparse);
+  vector<UInt32> connected3(c.segmentFlatListLength()), potential3(c.segmentFlatListLength());
+  c.computeActivity(connected3, potential3, input, 0.5f);
+  ASSERT_EQ(connected2, connected3);
+  ASSERT_EQ(potential2, potential3);
+
+  // Numbered like the binary format.
+  stringstream binary;
+  c.saveBinary(binary);
+  Connections loaded;
+  loaded.load(binary);
+  for (CellIdx cell = 0; cell < 500u; cell++)
+    ASSERT_EQ(loaded.segmentsForCell(cell), c.segmentsForCell(cell));
+
+  // It keeps working.
+  SDR inputSDR({500u});
+  inputSDR.setSparse(SDR_sparse_t(input.begin(), input.end()));
+  c.adaptSegment(c.segmentsForCell(c.cellForSegment(0u))[0], inputSDR, 0.1f, 0.1f);
+  c.destroySegment(1u);
+  const Segment segment = c.createSegment(3u);
+  c.createSynapse(segment, 42u, 0.6f);
+  ASSERT_EQ(1u, segment);
+}
+
+/**
+ * Check that every segment's numConnected agrees with the permanences of its
+ * synapses, and that every permanence is on the quantized grid.
+ */
+void checkQuantized(const Connections &c, Permanence threshold) {
+  for (CellIdx cell = 0; cell < c.numCells(); cell++) {
+    for (const Segment segment : c.segmentsForCell(cell)) {
+      SynapseIdx numConnected = 0u;
+      for (const Synapse synapse : c.synapsesForSegment(segment)) {
+        const Permanence permanence = c.dataForSynapse(synapse).permanence;
+        ASSERT_EQ(permanence, dequantizePermanence(quantizePermanence(permanence)));
+        if (permanence >= threshold - nupic::Epsilon)
+          numConnected++;
+      }
+      ASSERT_EQ(numConnected, c.dataForSegment(segment).numConnected);
+    }
+  }
+}
+
+TEST(ConnectionsTest, testQuantizedPermanences) {
+  Random rng(23);
+  const Permanence threshold = 0.5f;
+  Connections c(100u, threshold), reference(100u, threshold);
+  reference.setPackedSegments(true);
+  for (UInt i = 0; i < 60u; i++) {
+    const CellIdx cell = rng.getUInt32(100u);
+    const Segment segment = c.createSegment(cell);
+    reference.createSegment(cell);
+    for (UInt j = 0; j < 20u; j++) {
+      const CellIdx presynapticCell = rng.getUInt32(100u);
+      // Some permanences right around the connected threshold.
+      const Permanence permanence = j < 4u
+          ? threshold + ((Permanence)j - 2.0f) * 0.25f / 65535.0f
+          : (Permanence)rng.getReal64();
+      c.createSynapse(segment, presynapticCell, permanence);
+      reference.createSynapse(segment, presynapticCell, permanence);
+    }
+  }
+  ASSERT_FALSE(c.getQuantizedPermanences());
+  c.setQuantizedPermanences(true);
+  ASSERT_TRUE(c.getQuantizedPermanences());
+  // Quantized permanences live in the packed segments.
+  ASSERT_TRUE(c.getPackedSegments());
+  EXPECT_ANY_THROW(c.setPackedSegments(false));
+  checkQuantized(c, threshold);
+  // The packed lists hold 16 bit permanences instead of floats.
+  ASSERT_EQ(reference.heapStatistics().flatListBytes, c.heapStatistics().flatListBytes);
+  ASSERT_LT(c.heapStatistics().segmentListBytes,
+            reference.heapStatistics().segmentListBytes);
+
+  // Learning stays close to learning with float permanences.
+  SDR input({100u});
+  Permanence tolerance = 0.5f / 65535.0f + 1e-6f;
+  for (UInt step = 0; step < 30u; step++) {
+    input.randomize(0.3f, rng);
+    const Segment segment = rng.getUInt32((UInt32)c.numSegments());
+    switch (step % 3u) {
+      case 0u:
+        c.adaptSegment(segment, input, 0.1f, 0.05f);
+        reference.adaptSegment(segment, input, 0.1f, 0.05f);
+        break;
+      case 1u:
+        c.bumpSegment(segment, step % 2u ? 0.01f : -0.03f);
+        reference.bumpSegment(segment, step % 2u ? 0.01f : -0.03f);
+        break;
+      default:
+        c.raisePermanencesToThreshold(segment, threshold, 15u);
+        reference.raisePermanencesToThreshold(segment, threshold, 15u);
+        ASSERT_GE(c.dataForSegment(segment).numConnected, 15u);
+        break;
+    }
+    tolerance += 1.5f / 65535.0f;
+    checkQuantized(c, threshold);
+    for (Synapse synapse = 0; synapse < c.numSynapses(); synapse++) {
+      ASSERT_NEAR(reference.dataForSynapse(synapse).permanence,
+                  c.dataForSynapse(synapse).permanence, tolerance);
+    }
+  }
+
+  // Both serializations keep the quantized permanences exactly.
+  stringstream binary, text;
+  c.saveBinary(binary);
+  c.save(text);
+  Connections loaded, loadedText;
+  loaded.setQuantizedPermanences(true);
+  loaded.load(binary);
+  ASSERT_TRUE(loaded.getQuantizedPermanences());
+  ASSERT_EQ(c, loaded);
+  checkQuantized(loaded, threshold);
+  loadedText.load(text);
+  ASSERT_EQ(c, loadedText);
+
+  // Switching back keeps the permanences.
+  c.setQuantizedPermanences(false);
+  ASSERT_EQ(loaded, c);
+  const CellIdx cell = c.dataForSegment(0u).cell;
+  const Segment loadedSegment = loaded.getSegment(cell, 0u);
+  c.adaptSegment(c.getSegment(cell, 0u), input, 0.1f, 0.05f);
+  loaded.adaptSegment(loadedSegment, input, 0.1f, 0.05f);
+  const auto &synapses = c.synapsesForSegment(c.getSegment(cell, 0u));
+  const auto &loadedSynapses = loaded.synapsesForSegment(loadedSegment);
+  for (Size i = 0; i < synapses.size(); i++) {
+    ASSERT_NEAR(loaded.dataForSynapse(loadedSynapses[i]).permanence,
+                c.dataForSynapse(synapses[i]).permanence, 1.0f / 65535.0f);
+  }
+}
+
+TEST(ConnectionsTest, testSegmentCapacity) {
+  // Churn through segments like a TM does, with and without a capacity.
+  auto churn = [](Connections &c, Connections::HeapStatistics &warm) {
+    Random rng(31);
+    vector<Segment> live;
+    for (UInt round = 0; round < 40u; round++) {
+      if (round == 20u)
+        warm = c.heapStatistics();
+      while (live.size() < 100u) {
+        const Segment segment = c.createSegment(rng.getUInt32(200u));
+        const UInt numSynapses = 1u + rng.getUInt32(32u);
+        for (UInt i = 0; i < numSynapses; i++)
+          c.createSynapse(segment, rng.getUInt32(200u), (Permanence)rng.getReal64());
+        live.push_back(segment);
+      }
+      for (UInt i = 0; i < 30u; i++) {
+        const auto victim = live.begin() + rng.getUInt32((UInt32)live.size());
+        c.destroySegment(*victim);
+        live.erase(victim);
+      }
+    }
+  };
+
+  Connections grow(200u), reserved(200u);
+  grow.setPackedSegments(true);
+  reserved.setPackedSegments(true);
+  ASSERT_EQ(0u, grow.getSegmentCapacity());
+  reserved.setSegmentCapacity(32u);
+  ASSERT_EQ(32u, reserved.getSegmentCapacity());
+  Connections::HeapStatistics growWarm, reservedWarm;
+  churn(grow, growWarm);
+  churn(reserved, reservedWarm);
+
+  const auto growStats = grow.heapStatistics();
+  const auto reservedStats = reserved.heapStatistics();
+  ASSERT_GT(growStats.segmentListGrowths, 0u);
+  ASSERT_EQ(0u, reservedStats.segmentListGrowths);
+  ASSERT_EQ(reservedWarm.segmentListBytes, reservedStats.segmentListBytes);
+  ASSERT_EQ(reservedStats.segmentListBytes,
+            reserved.segmentFlatListLength() * 32u *
+                (sizeof(Synapse) + sizeof(CellIdx) + sizeof(Permanence)));
+  ASSERT_LE(reservedStats.segmentListBytesInUse, reservedStats.segmentListBytes);
+  ASSERT_EQ(growStats.segmentListBytesInUse, reservedStats.segmentListBytesInUse);
+  ASSERT_GT(reservedStats.totalBytes(), reservedStats.segmentListBytes);
+
+  // Switching the permanence type and loading the binary format reserve the
+  // capacity too.
+  reserved.setQuantizedPermanences(true);
+  ASSERT_EQ(0u, reserved.heapStatistics().segmentListGrowths);
+  ASSERT_EQ(reservedStats.segmentListBytes - reserved.numSegments() * 32u *
+                (sizeof(Permanence) - sizeof(UInt16)),
+            reserved.heapStatistics().segmentListBytes);
+  reserved.setQuantizedPermanences(false);
+  stringstream binary;
+  reserved.saveBinary(binary);
+  Connections loaded;
+  loaded.setSegmentCapacity(32u);
+  loaded.setPackedSegments(true);
+  loaded.load(binary);
+  ASSERT_EQ(0u, loaded.heapStatistics().segmentListGrowths);
+  ASSERT_EQ(loaded.numSegments() * 32u *
+                (sizeof(Synapse) + sizeof(CellIdx) + sizeof(Permanence)),
+            loaded.heapStatistics().segmentListBytes);
+  loaded.setSegmentCapacity(16u);
+  loaded.setQuantizedPermanences(true);
+  ASSERT_GT(loaded.heapStatistics().segmentListGrowths, 0u);
+
+  // Kept by initialize(), which resets the counter.
+  reserved.initialize(10u);
+  ASSERT_EQ(32u, reserved.getSegmentCapacity());
+  ASSERT_EQ(0u, reserved.heapStatistics().segmentListGrowths);
+}
+
+/**
+ * The binary format loads into the same connections as the text format,
+ * including segments and synapses created over destroyed ones, and the loaded
+ * connections compute the same activity.
+ */
+TEST(ConnectionsTest, testSaveLoadBinary) {
+  Connections c1(1024), c2, c3;
+  setupSampleConnections(c1);
+  auto segment = c1.createSegment(10);
+  c1.createSynapse(segment, 400, 0.5);
+  c1.destroySegment(segment);
+  segment = c1.createSegment(40);
+  c1.createSynapse(segment, 1000, 0.9f);
+  c1.destroySynapse(c1.createSynapse(segment, 3, 0.2f));
+  c1.createSynapse(segment, 52, 0.3f);
+
+  stringstream binary, text;
+  c1.saveBinary(binary);
+  c1.save(text);
+  c2.load(binary);
+  c3.load(text);
+  ASSERT_EQ(c1, c2);
+  ASSERT_EQ(c3, c2);
+  ASSERT_EQ(c1.numSegments(), c2.numSegments());
+  ASSERT_EQ(c1.numSynapses(), c2.numSynapses());
+
+  const vector<CellIdx> input = {3, 50, 52, 53, 80, 81, 82, 150, 151, 1000};
+  for (Connections *c : {&c1, &c2}) {
+    c->setActivityEngine(Connections::ActivityEngine::Sparse);
+  }
+  vector<UInt32> connected1(c1.segmentFlatListLength()), potential1(c1.segmentFlatListLength());
+  vector<UInt32> connected2(c2.segmentFlatListLength()), potential2(c2.segmentFlatListLength());
+  c1.computeActivity(connected1, potential1, input, 0.5f);
+  c2.computeActivity(connected2, potential2, input, 0.5f);
+  for (CellIdx cell : {10u, 20u, 30u, 40u}) {
+    const auto &segments1 = c1.segmentsForCell(cell);
+    const auto &segments2 = c2.segmentsForCell(cell);
+    ASSERT_EQ(segments1.size(), segments2.size());
+    for (Size i = 0; i < segments1.size(); i++) {
+      ASSERT_EQ(connected1[segments1[i]], connected2[segments2[i]]);
+      ASSERT_EQ(potential1[segments1[i]], potential2[segments2[i]]);
+    }
+  }
+
+  // The loaded connections keep learning like the original.
+  c2.adaptSegment(c2.segmentsForCell(20u)[0], SDR({1024u}), 0.1f, 0.1f);
+  c1.adaptSegment(c1.segmentsForCell(20u)[0], SDR({1024u}), 0.1f, 0.1f);
+  ASSERT_EQ(c1, c2);
+
+  // With realistic numbers of synapses the binary format is smaller.
+  Random rng(42);
+  Connections dense(2048u);
+  for (CellIdx cell = 0; cell < 2048u; cell += 8u) {
+    const Segment s = dense.createSegment(cell);
+    for (UInt i = 0; i < 30u; i++)
+      dense.createSynapse(s, rng.getUInt32(2048u), (Permanence)rng.getReal64());
+  }
+  stringstream denseBinary, denseText;
+  dense.saveBinary(denseBinary);
+  dense.save(denseText);
+  ASSERT_LT(denseBinary.str().size() * 2u, denseText.str().size());
+  Connections denseLoaded;
+  denseLoaded.load(denseBinary);
+  ASSERT_EQ(dense, denseLoaded);
+
+  // The presynaptic index for ConnectionsView is optional, and is skipped
+  // when loading.
+  stringstream indexedBinary;
+  dense.saveBinary(indexedBinary, true);
+  ASSERT_GT(indexedBinary.str().size(), denseBinary.str().size());
+  Connections indexedLoaded;
+  indexedLoaded.load(indexedBinary);
+  ASSERT_EQ(dense, indexedLoaded);
+
+  // Corrupt data is detected.
+  string data = binary.str();
+  data[data.size() - 1] ^= 0x10;
+  stringstream corrupt(data);
+  Connections c4;
+  EXPECT_ANY_THROW(c4.load(corrupt));
+  stringstream truncated(binary.str().substr(0, binary.str().size() / 2));
+  EXPECT_ANY_THROW(c4.load(truncated));
+
+  // The header is covered by the checksum, and a synapse count larger than
+  // the stream fails on the truncated data.
+  string header = binary.str();
+  header[16] ^= 0x01; // connectedThreshold
+  stringstream corruptHeader(header);
+  EXPECT_ANY_THROW(c4.load(corruptHeader));
+  string oversized = binary.str();
+  oversized[34] ^= 0x40; // synapseCount
+  stringstream oversizedStream(oversized);
+  EXPECT_ANY_THROW(c4.load(oversizedStream));
+}
+
 } // namespace
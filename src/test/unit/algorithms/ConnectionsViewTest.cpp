@@ -0,0 +1,185 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for ConnectionsView
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <nupic/algorithms/ConnectionsView.hpp>
+#include <nupic/os/Directory.hpp>
+#include <nupic/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::connections;
+
+static const string viewDir  = "TestOutputDir";
+static const string viewPath = "TestOutputDir/connections.bin";
+
+static void saveToFile(const Connections &connections, const string &path) {
+  ofstream out(path, ios::binary);
+  connections.saveBinary(out, true);
+}
+
+static void createRandomConnections(Connections &connections, Random &rng) {
+  for (CellIdx cell = 0; cell < connections.numCells(); cell += 3) {
+    for (UInt i = rng.getUInt32(3); i > 0; i--) {
+      const Segment segment = connections.createSegment(cell);
+      for (UInt j = 0; j < 20u; j++) {
+        connections.createSynapse(segment, rng.getUInt32(connections.numCells()),
+                                  (Permanence)rng.getReal64());
+      }
+    }
+  }
+  // Leave holes in the flat lists.
+  connections.destroySegment(connections.segmentsForCell(0u).empty()
+      ? connections.createSegment(0u) : connections.segmentsForCell(0u)[0]);
+}
+
+TEST(ConnectionsViewTest, MatchesLoadedConnections) {
+  Directory::create(viewDir, false, true);
+  Random rng(11);
+  Connections original(500u, 0.4f);
+  createRandomConnections(original, rng);
+  saveToFile(original, viewPath);
+
+  Connections loaded;
+  {
+    ifstream in(viewPath, ios::binary);
+    loaded.load(in);
+  }
+  const ConnectionsView view(viewPath, true);
+
+  ASSERT_EQ(loaded.numCells(), view.numCells());
+  ASSERT_EQ(loaded.numSegments(), view.numSegments());
+  ASSERT_EQ(loaded.numSynapses(), view.numSynapses());
+  ASSERT_EQ(loaded.segmentFlatListLength(), view.segmentFlatListLength());
+  ASSERT_EQ(0.4f, view.getConnectedThreshold());
+  for (CellIdx cell = 0; cell < view.numCells(); cell++) {
+    ASSERT_EQ(loaded.segmentsForCell(cell), view.segmentsForCell(cell));
+    for (const Segment segment : view.segmentsForCell(cell)) {
+      ASSERT_EQ(cell, view.cellForSegment(segment));
+      const auto &synapses = loaded.synapsesForSegment(segment);
+      ASSERT_EQ(synapses.size(), view.numSynapses(segment));
+      for (Size i = 0; i < synapses.size(); i++) {
+        const SynapseData &data = loaded.dataForSynapse(synapses[i]);
+        ASSERT_EQ(data.presynapticCell, view.presynapticCellsForSegment(segment)[i]);
+        ASSERT_EQ(data.permanence, view.permanencesForSegment(segment)[i]);
+      }
+    }
+  }
+
+  for (int trial = 0; trial < 10; trial++) {
+    vector<CellIdx> input;
+    for (CellIdx cell = 0; cell < 520u; cell++) {
+      if (rng.getReal64() < 0.1)
+        input.push_back(cell);
+    }
+    vector<UInt32> connected1(loaded.segmentFlatListLength());
+    vector<UInt32> potential1(loaded.segmentFlatListLength());
+    vector<UInt32> connected2(view.segmentFlatListLength());
+    vector<UInt32> potential2(view.segmentFlatListLength());
+    loaded.computeActivity(connected1, potential1, input, 0.4f);
+    view.computeActivity(connected2, potential2, input, 0.4f);
+    ASSERT_EQ(connected1, connected2);
+    ASSERT_EQ(potential1, potential2);
+
+    vector<UInt32> connected3(loaded.segmentFlatListLength());
+    vector<UInt32> connected4(view.segmentFlatListLength());
+    loaded.computeActivity(connected3, input);
+    view.computeActivity(connected4, input);
+    ASSERT_EQ(connected3, connected4);
+
+    // The connected permanence must be the one the file was saved with.
+    EXPECT_ANY_THROW(view.computeActivity(connected2, potential2, input, 0.45f));
+    EXPECT_ANY_THROW(loaded.computeActivity(connected1, potential1, input, 0.45f));
+  }
+
+  Directory::removeTree(viewDir);
+}
+
+TEST(ConnectionsViewTest, RejectsBadFiles) {
+  Directory::create(viewDir, false, true);
+  Random rng(12);
+  Connections connections(100u);
+  createRandomConnections(connections, rng);
+  saveToFile(connections, viewPath);
+  string bytes;
+  {
+    ifstream in(viewPath, ios::binary);
+    bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+
+  EXPECT_ANY_THROW(ConnectionsView(viewDir + "/missing.bin"));
+
+  // Not in the binary format.
+  {
+    ofstream out(viewPath, ios::binary);
+    connections.save(out);
+  }
+  EXPECT_ANY_THROW(ConnectionsView view(viewPath));
+
+  // Without the presynaptic maps.
+  {
+    ofstream out(viewPath, ios::binary);
+    connections.saveBinary(out);
+  }
+  EXPECT_ANY_THROW(ConnectionsView view(viewPath));
+
+  // Truncated.
+  {
+    ofstream out(viewPath, ios::binary);
+    out.write(bytes.data(), (streamsize)bytes.size() - 8);
+  }
+  EXPECT_ANY_THROW(ConnectionsView view(viewPath));
+
+  // A segment out of range in the presynaptic maps is found without the
+  // checksum.  The last two words hold the last segment and maybe padding.
+  {
+    string corrupt(bytes);
+    fill(corrupt.end() - 8, corrupt.end(), '\xff');
+    ofstream out(viewPath, ios::binary);
+    out.write(corrupt.data(), (streamsize)corrupt.size());
+  }
+  EXPECT_ANY_THROW(ConnectionsView view(viewPath));
+
+  // A flipped permanence bit is only found by the checksum.
+  {
+    string corrupt(bytes);
+    corrupt[corrupt.size() / 2] ^= 0x10;
+    ofstream out(viewPath, ios::binary);
+    out.write(corrupt.data(), (streamsize)corrupt.size());
+  }
+  EXPECT_ANY_THROW(ConnectionsView view(viewPath, true));
+
+  Directory::removeTree(viewDir);
+}
+
+} // end namespace testing
@@ -0,0 +1,121 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for the SDRClassifier kernels
+ */
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include <nupic/algorithms/SDRClassifierKernels.hpp>
+#include <nupic/utils/Random.hpp>
+
+namespace testing {
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::sdr_classifier;
+
+TEST(SDRClassifierKernelsTest, SumRowsAllLevelsMatchScalar) {
+  Random rng(7);
+  for (UInt32 count : {0u, 1u, 5u, 8u, 31u, 32u, 45u, 100u}) {
+    vector<vector<Real32>> rows(9, vector<Real32>(count));
+    vector<const Real32 *> pointers;
+    for (auto &row : rows) {
+      for (auto &x : row)
+        x = (Real32)(rng.getReal64() - 0.5);
+      pointers.push_back(row.data());
+    }
+    vector<Real32> expected(count, -1.0f);
+    sumRows(pointers.data(), (UInt32)pointers.size(), count, expected.data(),
+            SimdLevel::Scalar);
+    if (count > 0u) {
+      ASSERT_EQ(rows[0][0] + rows[1][0] + rows[2][0] + rows[3][0] +
+                rows[4][0] + rows[5][0] + rows[6][0] + rows[7][0] +
+                rows[8][0], expected[0]);
+    }
+
+    for (int level = 0; level <= (int)simdLevel(); level++) {
+      vector<Real32> sum(count, -1.0f);
+      sumRows(pointers.data(), (UInt32)pointers.size(), count, sum.data(),
+              (SimdLevel)level);
+      ASSERT_EQ(expected, sum) << "level " << level;
+      // No rows at all sum to zero.
+      sumRows(pointers.data(), 0u, count, sum.data(), (SimdLevel)level);
+      ASSERT_EQ(vector<Real32>(count, 0.0f), sum) << "level " << level;
+    }
+  }
+}
+
+TEST(SDRClassifierKernelsTest, AddScaledRowAllLevelsMatchScalar) {
+  Random rng(11);
+  for (UInt32 count : {0u, 3u, 8u, 19u, 64u}) {
+    vector<Real32> initial(count), x(count);
+    for (UInt32 i = 0; i < count; i++) {
+      initial[i] = (Real32)rng.getReal64();
+      x[i]       = (Real32)(rng.getReal64() - 0.5);
+    }
+    vector<Real32> expected(initial);
+    addScaledRow(expected.data(), x.data(), 0.3f, count, SimdLevel::Scalar);
+
+    for (int level = 0; level <= (int)simdLevel(); level++) {
+      vector<Real32> row(initial);
+      addScaledRow(row.data(), x.data(), 0.3f, count, (SimdLevel)level);
+      ASSERT_EQ(expected, row) << "level " << level;
+    }
+  }
+}
+
+TEST(SDRClassifierKernelsTest, SoftmaxAllLevelsNearScalar) {
+  Random rng(13);
+  for (UInt32 count : {1u, 2u, 7u, 8u, 9u, 33u, 1000u}) {
+    vector<Real32> initial(count);
+    for (auto &x : initial)
+      x = (Real32)((rng.getReal64() - 0.5) * 40.0);
+    // A value far below the maximum: the scalar exp() underflows to zero,
+    // while the SIMD exp() clamps its argument at the least normal float and
+    // gives a tiny positive value.  Both are within the absolute tolerance.
+    initial[0] = -1000.0f;
+
+    vector<Real32> expected(initial);
+    softmax(expected.data(), count, SimdLevel::Scalar);
+    Real64 total = 0.0;
+    for (const auto p : expected)
+      total += p;
+    ASSERT_NEAR(1.0, total, 1e-5);
+
+    for (int level = 0; level <= (int)simdLevel(); level++) {
+      vector<Real32> values(initial);
+      softmax(values.data(), count, (SimdLevel)level);
+      for (UInt32 i = 0; i < count; i++) {
+        // The polynomial exp() is accurate to a few ulp.
+        ASSERT_NEAR(expected[i], values[i], 1e-6f * expected[i] + 1e-30f)
+            << "level " << level << ", index " << i;
+      }
+    }
+  }
+}
+
+} // end namespace testing
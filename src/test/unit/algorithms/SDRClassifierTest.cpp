@@ -36,6 +36,7 @@
 
 #include <nupic/algorithms/SDRClassifier.hpp>
 #include <nupic/utils/Log.hpp>
+#include <nupic/utils/Random.hpp>
 
 namespace nupic {
 namespace algorithms {
@@ -310,6 +311,125 @@ TEST_F(SDRClassifierTest, SaveLoad) {
 }
 
 
+TEST_F(SDRClassifierTest, WeightMatrixGrows) {
+  Matrix m;
+  ASSERT_EQ(0u, m.rows());
+  ASSERT_EQ(0.0, m.get(3u, 3u));
+
+  m.grow(2u, 3u);
+  m.row(1u)[2u] = 1.5;
+  // Wider rows re-layout the data, taller ones append zeroed rows.
+  m.grow(1u, 7u);
+  m.grow(40u, 2u);
+  ASSERT_EQ(40u, m.rows());
+  ASSERT_EQ(7u, m.cols());
+  ASSERT_EQ(1.5, m.get(1u, 2u));
+  for (UInt r = 0; r < m.rows(); r++) {
+    for (UInt c = 0; c < m.cols(); c++) {
+      if (r != 1u || c != 2u) {
+        ASSERT_EQ(0.0, m.row(r)[c]) << r << ", " << c;
+      }
+    }
+  }
+  ASSERT_EQ(0.0, m.get(40u, 0u));
+  ASSERT_EQ(0.0, m.get(0u, 7u));
+}
+
+
+TEST_F(SDRClassifierTest, PatternHistoryRing) {
+  PatternHistory history;
+  history.reset(3u);
+  ASSERT_EQ(0u, history.size());
+
+  const vector<vector<UInt>> patterns{
+      {1u}, {2u, 3u}, {}, {4u, 5u, 6u, 7u, 8u}, {9u, 10u}};
+  for (UInt i = 0; i < patterns.size(); i++) {
+    history.push(10u + i, patterns[i].data(), (UInt)patterns[i].size());
+  }
+  // Only the last three remain, oldest first, including the ones which were
+  // moved when the longer pattern enlarged the slots.
+  ASSERT_EQ(3u, history.size());
+  for (UInt i = 0; i < 3u; i++) {
+    const auto &expected = patterns[2u + i];
+    ASSERT_EQ(12u + i, history.recordNum(i));
+    ASSERT_EQ(vector<UInt>(expected),
+              vector<UInt>(history.pattern(i),
+                           history.pattern(i) + history.patternSize(i)));
+  }
+
+  PatternHistory other;
+  other.reset(3u);
+  for (UInt i = 2u; i < patterns.size(); i++) {
+    other.push(10u + i, patterns[i].data(), (UInt)patterns[i].size());
+  }
+  ASSERT_TRUE(history == other);
+  other.push(15u, patterns[0].data(), 1u);
+  ASSERT_FALSE(history == other);
+}
+
+
+/**
+ * The single precision mode is not bit identical to the double precision
+ * one.  Its error budget: after a few hundred learning steps with thousands
+ * of active bit x bucket weights, every likelihood is within 1e-5 of the
+ * double precision likelihood, and so the most likely bucket agrees whenever
+ * the top two double precision likelihoods are further apart than that.
+ */
+TEST_F(SDRClassifierTest, SinglePrecisionMatchesDouble) {
+  const Real64 tolerance = 1e-5;
+  SDRClassifier c64({1u, 3u}, 0.1, 0.3, 0u);
+  SDRClassifier c32({1u, 3u}, 0.1, 0.3, 0u);
+  c32.setSinglePrecision(true);
+  ASSERT_TRUE(c32.getSinglePrecision());
+
+  Random rng(17);
+  vector<UInt> input(25);
+  for (UInt recordNum = 0; recordNum < 300; recordNum++) {
+    for (auto &bit : input)
+      bit = rng.getUInt32(400);
+    const vector<UInt> bucketIdx{ (recordNum * 7u) % 67u };
+    const vector<Real64> actValue{ (Real64)bucketIdx[0] };
+    ClassifierResult r64, r32;
+    c64.compute(recordNum, input, bucketIdx, actValue, false, true, true, r64);
+    c32.compute(recordNum, input, bucketIdx, actValue, false, true, true, r32);
+
+    map<Int, const vector<Real64> *> likelihoods32(r32.begin(), r32.end());
+    for (auto it = r64.begin(); it != r64.end(); it++) {
+      const Int step = it->first;
+      if (step < 0)
+        continue; // actual values
+      const auto &l64 = *it->second;
+      const auto &l32 = *likelihoods32.at(step);
+      ASSERT_EQ(l64.size(), l32.size());
+      for (UInt i = 0; i < l64.size(); i++) {
+        ASSERT_NEAR(l64[i], l32[i], tolerance)
+            << "record " << recordNum << ", step " << step << ", bucket " << i;
+      }
+      vector<Real64> sorted(l64);
+      sort(sorted.rbegin(), sorted.rend());
+      if (sorted.size() > 1u && sorted[0] - sorted[1] > 2.0 * tolerance) {
+        ASSERT_EQ(max_element(l64.begin(), l64.end()) - l64.begin(),
+                  max_element(l32.begin(), l32.end()) - l32.begin());
+      }
+    }
+  }
+
+  // The mode is saved.
+  stringstream ss;
+  c32.save(ss);
+  SDRClassifier loaded;
+  loaded.load(ss);
+  ASSERT_TRUE(loaded.getSinglePrecision());
+
+  // Converting the weights to double precision and back keeps them.
+  SDRClassifier converted = c32;
+  converted.setSinglePrecision(false);
+  ASSERT_FALSE(converted == c32);
+  converted.setSinglePrecision(true);
+  ASSERT_EQ(c32, converted);
+}
+
+
 TEST_F(SDRClassifierTest, testSoftmaxOverflow) {
   SDRClassifier c = SDRClassifier({1u}, 0.5f, 0.5f, 0u);
   std::vector<Real64> values = {numeric_limits<Real64>::max()};
@@ -1391,6 +1391,58 @@ TEST(SpatialPoolerTest, testInhibitColumnsLocal) {
   }
 }
 
+TEST(SpatialPoolerTest, testInhibitColumnsLocalRanked) {
+  // The rank counting engine must select exactly the same columns as the
+  // neighborhood iteration, including the arbitration of ties.
+  Random rng(42);
+  const vector<vector<UInt>> topologies = {{1}, {7}, {100}, {1, 13}, {9, 1},
+                                           {10, 10}, {12, 30}};
+  for (const auto &columnDimensions : topologies) {
+    for (const bool wrapAround : {false, true}) {
+      SpatialPooler sp(
+          /*inputDimensions*/ columnDimensions,
+          /*columnDimensions*/ columnDimensions,
+          /*potentialRadius*/ 3,
+          /*potentialPct*/ 0.5f,
+          /*globalInhibition*/ false,
+          /*localAreaDensity*/ 0.1f,
+          /*numActiveColumnsPerInhArea*/ -1,
+          /*stimulusThreshold*/ 2,
+          /*synPermInactiveDec*/ 0.008f,
+          /*synPermActiveInc*/ 0.05f,
+          /*synPermConnected*/ 0.1f,
+          /*minPctOverlapDutyCycles*/ 0.001f,
+          /*dutyCyclePeriod*/ 1000,
+          /*boostStrength*/ 0.0f,
+          /*seed*/ 1,
+          /*spVerbosity*/ 0,
+          /*wrapAround*/ wrapAround);
+      const UInt numColumns = sp.getNumColumns();
+
+      for (const UInt radius : {0u, 1u, 2u, 4u, 7u, 15u, 40u}) {
+        sp.setInhibitionRadius(radius);
+        for (const Real density : {0.02f, 0.1f, 0.3f, 0.5f}) {
+          // Few distinct values, so that there are many ties.
+          vector<Real> overlaps(numColumns);
+          for (auto &overlap : overlaps) {
+            overlap = (Real) rng.getUInt32(6u);
+          }
+          // And some which are not integers.
+          overlaps[rng.getUInt32(numColumns)] += 0.5f;
+
+          vector<UInt> expected, actual;
+          sp.inhibitColumnsLocalNeighborhood_(overlaps, density, expected);
+          sp.inhibitColumnsLocalRanked_(overlaps, density, actual);
+          ASSERT_EQ(expected, actual);
+
+          sp.inhibitColumnsLocal_(overlaps, density, actual);
+          ASSERT_EQ(expected, actual);
+        }
+      }
+    }
+  }
+}
+
 TEST(SpatialPoolerTest, testIsUpdateRound) {
   SpatialPooler sp;
   sp.setUpdatePeriod(50);
@@ -1874,6 +1926,46 @@ TEST(SpatialPoolerTest, testSaveLoad) {
 }
 
 
+TEST(SpatialPoolerTest, testSaveLoadBinary) {
+  Random random(10);
+  const UInt inputSize = 400;
+  const UInt numColumns = 300;
+  SpatialPooler sp1({inputSize}, {numColumns});
+  vector<UInt> input(inputSize, 0), output1(numColumns), output2(numColumns);
+  std::fill(input.begin(), input.begin() + 40, 1u);
+  for (UInt i = 0; i < 200; ++i) {
+    random.shuffle(input.begin(), input.end());
+    sp1.compute(input.data(), true, output1.data());
+  }
+
+  stringstream binary, text;
+  sp1.saveBinary(binary);
+  sp1.save(text);
+  ASSERT_LT(binary.str().size(), text.str().size());
+
+  SpatialPooler sp2, sp3;
+  sp2.load(binary);
+  sp3.load(text);
+  check_spatial_eq(sp1, sp2);
+  ASSERT_TRUE(sp1 == sp2);
+  ASSERT_TRUE(sp3 == sp2);
+
+  // The loaded spatial pooler keeps learning like the original.
+  for (UInt i = 0; i < 50; ++i) {
+    random.shuffle(input.begin(), input.end());
+    sp1.compute(input.data(), true, output1.data());
+    sp2.compute(input.data(), true, output2.data());
+    ASSERT_EQ(output1, output2);
+  }
+  ASSERT_TRUE(sp1 == sp2);
+
+  // Truncated data is detected.
+  stringstream truncated(binary.str().substr(0, binary.str().size() - 4));
+  SpatialPooler sp4;
+  EXPECT_ANY_THROW(sp4.load(truncated));
+}
+
+
 TEST(SpatialPoolerTest, testSerialization2) {
   Random random(10);
 
@@ -2050,4 +2142,97 @@ TEST(SpatialPoolerTest, ExactOutput) {
   ASSERT_TRUE( columns == gold_sdr );
 }
 
+
+TEST(SpatialPoolerTest, MultithreadedMatchesSerial) {
+  for(const bool global : {true, false}) {
+    SDR inputs({ 20, 20 });
+    SDR serialColumns({ 16, 16 });
+    SDR threadedColumns({ 16, 16 });
+    SpatialPooler serial({inputs.dimensions}, {serialColumns.dimensions},
+                         /*potentialRadius*/ 5,
+                         /*potentialPct*/ 0.5f,
+                         /*globalInhibition*/ global,
+                         /*localAreaDensity*/ 0.1f,
+                         /*numActiveColumnsPerInhArea*/ -1,
+                         /*stimulusThreshold*/ 1u,
+                         /*synPermInactiveDec*/ 0.008f,
+                         /*synPermActiveInc*/ 0.05f,
+                         /*synPermConnected*/ 0.1f,
+                         /*minPctOverlapDutyCycles*/ 0.001f,
+                         /*dutyCyclePeriod*/ 100,
+                         /*boostStrength*/ 3.0f,
+                         /*seed*/ 42,
+                         /*spVerbosity*/ 0,
+                         /*wrapAround*/ global);
+    serial.setUpdatePeriod( 10u );
+    SpatialPooler threaded = serial;
+    threaded.setNumThreads( 4u );
+    ASSERT_EQ( 4u, threaded.getNumThreads() );
+    ASSERT_EQ( 1u, serial.getNumThreads() );
+
+    Random rng( 7 );
+    for(UInt i = 0; i < 100; i++) {
+      inputs.randomize( 0.15f, rng );
+      serial.compute(inputs, true, serialColumns);
+      threaded.compute(inputs, true, threadedColumns);
+      ASSERT_EQ( serialColumns, threadedColumns ) << "iteration " << i;
+      ASSERT_EQ( serial.getBoostedOverlaps(), threaded.getBoostedOverlaps() );
+    }
+    ASSERT_EQ( serial, threaded );
+  }
+}
+
+TEST(SpatialPoolerTest, ComputeBatchMatchesCompute) {
+  for(const bool global : {true, false}) {
+    SpatialPooler sp({ 20u, 20u }, { 16u, 16u },
+                     /*potentialRadius*/ 5,
+                     /*potentialPct*/ 0.5f,
+                     /*globalInhibition*/ global,
+                     /*localAreaDensity*/ 0.1f,
+                     /*numActiveColumnsPerInhArea*/ -1,
+                     /*stimulusThreshold*/ 1u,
+                     /*synPermInactiveDec*/ 0.008f,
+                     /*synPermActiveInc*/ 0.05f,
+                     /*synPermConnected*/ 0.1f,
+                     /*minPctOverlapDutyCycles*/ 0.001f,
+                     /*dutyCyclePeriod*/ 100,
+                     /*boostStrength*/ 3.0f,
+                     /*seed*/ 42,
+                     /*spVerbosity*/ 0,
+                     /*wrapAround*/ global);
+    // Learn a little first, so that the boost factors are not all equal.
+    Random rng( 11 );
+    SDR input({ 20u, 20u });
+    SDR columns({ 16u, 16u });
+    for(UInt i = 0; i < 50; i++) {
+      input.randomize( 0.15f, rng );
+      sp.compute( input, true, columns );
+    }
+
+    // More inputs than one block, so that blocks and threads are both split.
+    vector<SDR> inputs( 150u, SDR({ 20u, 20u }));
+    for(auto &sample : inputs)
+      sample.randomize( 0.15f, rng );
+
+    SpatialPooler serial = sp;
+    vector<SDR> expected;
+    for(const auto &sample : inputs) {
+      serial.compute( sample, false, columns );
+      expected.push_back( columns );
+    }
+
+    for(const UInt numThreads : {1u, 3u}) {
+      SpatialPooler batched = sp;
+      batched.setNumThreads( numThreads );
+      vector<SDR> actives;
+      batched.computeBatch( inputs, actives );
+      ASSERT_EQ( inputs.size(), actives.size() );
+      for(UInt i = 0; i < inputs.size(); i++)
+        ASSERT_EQ( expected[i], actives[i] ) << "input " << i;
+      ASSERT_EQ( serial.getIterationNum(), batched.getIterationNum() );
+      ASSERT_EQ( serial.getIterationLearnNum(), batched.getIterationLearnNum() );
+    }
+  }
+}
+
 } // end anonymous namespace
@@ -1532,6 +1532,150 @@ TEST(TemporalMemoryTest, testSaveLoad) {
   serializationTestVerify(tm2);
 }
 
+TEST(TemporalMemoryTest, testSaveLoadBinary) {
+  TemporalMemory tm1(
+      /*columnDimensions*/ {32},
+      /*cellsPerColumn*/ 4,
+      /*activationThreshold*/ 3,
+      /*initialPermanence*/ 0.21f,
+      /*connectedPermanence*/ 0.50f,
+      /*minThreshold*/ 2,
+      /*maxNewSynapseCount*/ 3,
+      /*permanenceIncrement*/ 0.10f,
+      /*permanenceDecrement*/ 0.10f,
+      /*predictedSegmentDecrement*/ 0.0f,
+      /*seed*/ 42);
+
+  serializationTestPrepare(tm1);
+
+  stringstream ss;
+  tm1.saveBinary(ss);
+
+  TemporalMemory tm2;
+  tm2.load(ss);
+
+  ASSERT_TRUE(tm1 == tm2);
+
+  serializationTestVerify(tm2);
+}
+
+TEST(TemporalMemoryTest, testSaveLoadBinaryKeepsSegmentState) {
+  SDR columns({100});
+  vector<SDR> pattern( 30, columns.dimensions );
+  Random rng( 7 );
+  for(auto &sdr : pattern) {
+    sdr.randomize( 0.08f, rng );
+    auto &data = sdr.getSparse();
+    std::sort(data.begin(), data.end());
+  }
+
+  // Few segments, so that the least recently used ones get destroyed.
+  TemporalMemory tm1(columns.dimensions,
+    /* cellsPerColumn */               2,
+    /* activationThreshold */          5,
+    /* initialPermanence */            0.21f,
+    /* connectedPermanence */          0.50f,
+    /* minThreshold */                 3,
+    /* maxNewSynapseCount */           8,
+    /* permanenceIncrement */          0.10f,
+    /* permanenceDecrement */          0.10f,
+    /* predictedSegmentDecrement */    0.02f,
+    /* seed */                         42,
+    /* maxSegmentsPerCell */           2,
+    /* maxSynapsesPerSegment */        10);
+  for(UInt trial = 0; trial < 3; trial++) {
+    for(auto &x : pattern) {
+      tm1.compute(x.getSparse().size(), x.getSparse().data(), true);
+    }
+  }
+  // Leave holes in the segment numbering.
+  tm1.connections.destroySegment(tm1.connections.segmentsForCell(
+      tm1.connections.cellForSegment(0u))[0]);
+
+  stringstream binary, text;
+  tm1.saveBinary(binary);
+  tm1.save(text);
+  ASSERT_LT(binary.str().size(), text.str().size());
+  TemporalMemory tm2;
+  tm2.load(binary);
+  ASSERT_TRUE(tm1 == tm2);
+
+  // The loaded temporal memory keeps learning like the original, including
+  // which segments it destroys to make room.
+  for(UInt trial = 0; trial < 3; trial++) {
+    for(auto &x : pattern) {
+      tm1.compute(x.getSparse().size(), x.getSparse().data(), true);
+      tm2.compute(x.getSparse().size(), x.getSparse().data(), true);
+      ASSERT_EQ( tm1.getActiveCells(), tm2.getActiveCells() );
+      ASSERT_EQ( tm1.getWinnerCells(), tm2.getWinnerCells() );
+    }
+  }
+  ASSERT_TRUE(tm1 == tm2);
+
+  // Truncated data is detected.
+  stringstream truncated(binary.str().substr(0, binary.str().size() / 2));
+  TemporalMemory tm3;
+  EXPECT_ANY_THROW(tm3.load(truncated));
+}
+
+TEST(TemporalMemoryTest, CompactionKeepsResults) {
+  SDR columns({100});
+  vector<SDR> pattern( 40, columns.dimensions );
+  Random rng( 29 );
+  for(auto &sdr : pattern) {
+    sdr.randomize( 0.08f, rng );
+    auto &data = sdr.getSparse();
+    std::sort(data.begin(), data.end());
+  }
+
+  // Few segments and synapses, so that both get destroyed to make room.
+  const auto makeTM = [&]() {
+    return TemporalMemory(columns.dimensions,
+      /* cellsPerColumn */               2,
+      /* activationThreshold */          5,
+      /* initialPermanence */            0.21f,
+      /* connectedPermanence */          0.50f,
+      /* minThreshold */                 3,
+      /* maxNewSynapseCount */           8,
+      /* permanenceIncrement */          0.10f,
+      /* permanenceDecrement */          0.10f,
+      /* predictedSegmentDecrement */    0.02f,
+      /* seed */                         42,
+      /* maxSegmentsPerCell */           2,
+      /* maxSynapsesPerSegment */        10);
+  };
+  TemporalMemory plain     = makeTM();
+  TemporalMemory compacted = makeTM();
+  compacted.connections.setCompactionThreshold( 0.05f );
+
+  for(UInt trial = 0; trial < 10; trial++) {
+    for(auto &x : pattern) {
+      const auto &sparse = x.getSparse();
+      plain.compute(sparse.size(), sparse.data(), true);
+      compacted.compute(sparse.size(), sparse.data(), true);
+      if( trial == 5 && &x == &pattern[0] ) {
+        // Leave holes, as when the input statistics change.
+        for(TemporalMemory *tm : {&plain, &compacted}) {
+          for(CellIdx cell = 0; cell < tm->numberOfCells(); cell += 2) {
+            if( tm->connections.numSegments(cell) > 0 )
+              tm->connections.destroySegment(tm->connections.segmentsForCell(cell)[0]);
+          }
+        }
+      }
+      ASSERT_EQ( plain.getActiveCells(), compacted.getActiveCells() );
+      ASSERT_EQ( plain.getWinnerCells(), compacted.getWinnerCells() );
+      plain.activateDendrites(true);
+      compacted.activateDendrites(true);
+      ASSERT_EQ( plain.getPredictiveCells(), compacted.getPredictiveCells() );
+      if( trial == 5 && &x == &pattern[0] ) {
+        ASSERT_GT( plain.connections.fragmentation(), 0.05f );
+        ASSERT_EQ( 0.0f, compacted.connections.fragmentation() );
+      }
+    }
+  }
+  ASSERT_TRUE( plain == compacted );
+}
+
 /*
  * Test compute( extraActive, extraWinners )
  *
@@ -1611,6 +1755,122 @@ TEST(TemporalMemoryTest, testExtraActive) {
   }
 }
 
+TEST(TemporalMemoryTest, MultithreadedMatchesSerial) {
+  SDR columns({200});
+  vector<SDR> pattern( 20, columns.dimensions );
+  Random rng( 17 );
+  for(auto &sdr : pattern) {
+    sdr.randomize( 0.05f, rng );
+    auto &data = sdr.getSparse();
+    std::sort(data.begin(), data.end());
+  }
+
+  const auto makeTM = [&]() {
+    return TemporalMemory(columns.dimensions,
+      /* cellsPerColumn */               8,
+      /* activationThreshold */          6,
+      /* initialPermanence */            0.21f,
+      /* connectedPermanence */          0.50f,
+      /* minThreshold */                 4,
+      /* maxNewSynapseCount */           12,
+      /* permanenceIncrement */          0.10f,
+      /* permanenceDecrement */          0.05f,
+      /* predictedSegmentDecrement */    0.01f,
+      /* seed */                         42);
+  };
+  TemporalMemory serial   = makeTM();
+  TemporalMemory threaded = makeTM();
+  threaded.setNumThreads( 3u );
+  ASSERT_EQ( 3u, threaded.getNumThreads() );
+  ASSERT_EQ( 1u, serial.getNumThreads() );
+
+  for(UInt trial = 0; trial < 10; trial++) {
+    for(auto &x : pattern) {
+      serial.activateDendrites();
+      threaded.activateDendrites();
+      ASSERT_EQ( serial.getActiveSegments(),   threaded.getActiveSegments() );
+      ASSERT_EQ( serial.getMatchingSegments(), threaded.getMatchingSegments() );
+
+      const auto &sparse = x.getSparse();
+      serial.compute(sparse.size(), sparse.data(), true);
+      threaded.compute(sparse.size(), sparse.data(), true);
+      ASSERT_EQ( serial.getActiveCells(),      threaded.getActiveCells() );
+      ASSERT_EQ( serial.getWinnerCells(),      threaded.getWinnerCells() );
+    }
+  }
+  // The sequence was learned, so the comparisons above saw active segments.
+  serial.activateDendrites();
+  threaded.activateDendrites();
+  ASSERT_FALSE( serial.getActiveSegments().empty() );
+  ASSERT_EQ( serial.getActiveSegments(), threaded.getActiveSegments() );
+  ASSERT_TRUE( serial == threaded );
+}
+
+TEST(TemporalMemoryTest, ColumnRandomStreams) {
+  SDR columns({100});
+  vector<SDR> pattern( 40, columns.dimensions );
+  Random rng( 23 );
+  for(auto &sdr : pattern) {
+    sdr.randomize( 0.08f, rng );
+    auto &data = sdr.getSparse();
+    std::sort(data.begin(), data.end());
+  }
+
+  // Few segments and synapses, so that both get destroyed to make room.
+  const auto makeTM = [&](UInt numThreads) {
+    TemporalMemory tm(columns.dimensions,
+      /* cellsPerColumn */               2,
+      /* activationThreshold */          5,
+      /* initialPermanence */            0.21f,
+      /* connectedPermanence */          0.50f,
+      /* minThreshold */                 3,
+      /* maxNewSynapseCount */           8,
+      /* permanenceIncrement */          0.10f,
+      /* permanenceDecrement */          0.10f,
+      /* predictedSegmentDecrement */    0.02f,
+      /* seed */                         42,
+      /* maxSegmentsPerCell */           2,
+      /* maxSynapsesPerSegment */        10);
+    tm.setColumnRandomStreams( true );
+    tm.setNumThreads( numThreads );
+    return tm;
+  };
+  TemporalMemory serial   = makeTM( 1u );
+  TemporalMemory threaded = makeTM( 4u );
+  ASSERT_TRUE( serial.getColumnRandomStreams() );
+
+  Real anom = 1.0f;
+  for(UInt trial = 0; trial < 20; trial++) {
+    for(auto &x : pattern) {
+      const auto &sparse = x.getSparse();
+      serial.activateDendrites();
+      auto predictedColumns = serial.getPredictiveCells();
+      for(auto &cell : predictedColumns)
+        cell /= serial.getCellsPerColumn();
+      predictedColumns.erase( std::unique( predictedColumns.begin(),
+                                           predictedColumns.end() ),
+                              predictedColumns.end() );
+      anom = algorithms::anomaly::computeRawAnomalyScore( sparse, predictedColumns );
+
+      serial.compute(sparse.size(), sparse.data(), true);
+      threaded.compute(sparse.size(), sparse.data(), true);
+      ASSERT_EQ( serial.getActiveCells(), threaded.getActiveCells() );
+      ASSERT_EQ( serial.getWinnerCells(), threaded.getWinnerCells() );
+    }
+    ASSERT_TRUE( serial == threaded ) << "trial " << trial;
+  }
+  // It still learns most of the sequence.
+  ASSERT_LT( anom, 0.5f );
+
+  // The setting is saved.
+  stringstream ss;
+  serial.save( ss );
+  TemporalMemory loaded;
+  loaded.load( ss );
+  ASSERT_TRUE( loaded.getColumnRandomStreams() );
+  ASSERT_TRUE( serial == loaded );
+}
+
 // Uncomment these tests individually to save/load from a file.
 // This is useful for ad-hoc testing of backwards-compatibility.
 
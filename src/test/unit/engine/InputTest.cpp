@@ -355,4 +355,42 @@ TEST(InputTest, LinkTwoRegionsOneInputFlatten) {
   ASSERT_EQ(expectedData.size(), pa->getCount());
   ASSERT_EQ(expectedData, pa->asVector<Real64>());
 }
-}
\ No newline at end of file
+
+TEST(InputTest, SDRFanInIsAView) {
+  Network net;
+  std::shared_ptr<Region> region1 = net.addRegion("region1", "ScalarSensor",
+                                  "{n: 50, w: 5, minValue: 0, maxValue: 10}");
+  std::shared_ptr<Region> region2 = net.addRegion("region2", "ScalarSensor",
+                                  "{n: 30, w: 3, minValue: 0, maxValue: 10}");
+  std::shared_ptr<Region> region3 = net.addRegion("region3", "SPRegion",
+                                  "{columnCount: 20}");
+  net.link("region1", "region3", "", "", "encoded", "bottomUpIn");
+  net.link("region2", "region3", "", "", "encoded", "bottomUpIn");
+  net.initialize();
+
+  Input *in3 = region3->getInput("bottomUpIn");
+  EXPECT_EQ(Dimensions({80}), in3->getDimensions());
+
+  const sdr::SDR &sdr1 = region1->getOutput("encoded")->getData().getSDR();
+  const sdr::SDR &sdr2 = region2->getOutput("encoded")->getData().getSDR();
+  for (const Real64 value : {2.0, 7.5}) {
+    region1->setParameterReal64("sensedValue", value);
+    region2->setParameterReal64("sensedValue", 10.0 - value);
+    net.run(1);
+
+    std::vector<UInt> expected(sdr1.getSparse());
+    for (const auto idx : sdr2.getSparse())
+      expected.push_back(idx + 50u);
+    ASSERT_EQ(8u, expected.size());
+    ASSERT_EQ(expected, in3->getData().getSDR().getSparse());
+  }
+
+  // The input follows its sources without being prepared.
+  region1->setParameterReal64("sensedValue", 5.0);
+  region1->compute();
+  ASSERT_EQ(sdr1.getSparse()[0], in3->getData().getSDR().getSparse()[0]);
+  std::vector<Byte> dense(sdr1.getDense());
+  dense.insert(dense.end(), sdr2.getDense().begin(), sdr2.getDense().end());
+  ASSERT_EQ(dense, in3->getData().getSDR().getDense());
+}
+} // namespace testing
@@ -26,6 +26,7 @@
 
 #include <sstream>
 #include <iostream>
+#include <set>
 
 #include "gtest/gtest.h"
 #include <nupic/engine/Input.hpp>
@@ -247,6 +248,43 @@ TEST(LinkTest, DelayedLink) {
 
 
 
+TEST(LinkTest, DelayedLinkReusesBuffers) {
+  Network net;
+  std::shared_ptr<Region> region1 = net.addRegion("region1", "TestNode", "");
+  std::shared_ptr<Region> region2 = net.addRegion("region2", "TestNode", "");
+  Dimensions d1 = {8, 4};
+  region1->setDimensions(d1);
+  region2->setDimensions(d1);
+  const size_t delay = 3;
+  net.link("region1", "region2", "", "", "", "", delay);
+  net.initialize();
+
+  Output *out1 = region1->getOutput("bottomUpOut");
+  Input *in2   = region2->getInput("bottomUpIn");
+
+  // The destination input shares the buffers of the ring, which are reused,
+  // and sees the source output from `delay` iterations earlier.
+  std::vector<Array> history;
+  std::set<const void *> buffers;
+  for (size_t i = 0; i < 12u; i++) {
+    net.run(1);
+    history.push_back(out1->getData().copy());
+    buffers.insert(in2->getData().getBuffer());
+    if (i >= delay) {
+      ASSERT_TRUE(in2->getData() == history[i - delay]) << "iteration " << i;
+    }
+  }
+  ASSERT_EQ(delay + 1, buffers.size());
+  ASSERT_EQ(0u, buffers.count(out1->getData().getBuffer()));
+
+  // A destination which does not compute keeps its input.
+  const Array before = in2->getData().copy();
+  net.setMaxEnabledPhase(0);
+  net.run((int)delay + 2);
+  ASSERT_TRUE(in2->getData() == before);
+}
+
+
 TEST(LinkTest, DelayedLinkSerialization) {
   // serialization test of delayed link.
 
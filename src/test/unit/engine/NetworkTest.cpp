@@ -26,11 +26,18 @@
 
 #include "gtest/gtest.h"
 
+#include <fstream>
+#include <sstream>
+
+#include <nupic/engine/Input.hpp>
+#include <nupic/engine/Link.hpp>
 #include <nupic/engine/Network.hpp>
 #include <nupic/engine/NuPIC.hpp>
 #include <nupic/engine/Region.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
+#include <nupic/os/Directory.hpp>
 #include <nupic/utils/Log.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace testing {
     
@@ -515,9 +522,131 @@ TEST(NetworkTest, Callback) {
   EXPECT_STREQ("level3", mydata[5].c_str());
 }
 
+/**
+ * A small hotgym style network: a sensor feeding an SP and TM, and a second
+ * SP on a delayed link from the sensor.
+ */
+static void addParallelTestRegions(Network &net) {
+  const std::string inputFile = "TestOutputDir/NetworkTestParallelInput.csv";
+  if (!Directory::exists("TestOutputDir"))
+    Directory::create("TestOutputDir", false, true);
+  std::ofstream f(inputFile.c_str());
+  for (size_t i = 0; i < 7u; i++) {
+    for (size_t j = 0; j < 30u; j++)
+      f << (((j * 3u + i) % 7u) < 2u ? "1.0," : "0.0,");
+    f << std::endl;
+  }
+  f.close();
+
+  auto sensor = net.addRegion("sensor", "VectorFileSensor", "{activeOutputCount: 30}");
+  net.addRegion("sp1", "SPRegion", "{dim: [2,10]}");
+  net.addRegion("sp2", "SPRegion", "{dim: [2,10]}");
+  net.addRegion("tm", "TMRegion", "{activationThreshold: 3, minThreshold: 2, cellsPerColumn: 4}");
+  net.link("sensor", "sp1", "", "", "dataOut", "bottomUpIn");
+  net.link("sensor", "sp2", "", "", "dataOut", "bottomUpIn", 2);
+  net.link("sp1", "tm", "", "", "bottomUpOut", "bottomUpIn");
+  sensor->executeCommand({"loadFile", inputFile});
+  net.initialize();
+}
+
+// Link serialization does not support delayed links into SDR inputs, so
+// compare every output instead of the saved networks.
+static void expectSameOutputs(const Network &expected, const Network &actual) {
+  for (const auto &name : {"sensor", "sp1", "sp2", "tm"}) {
+    const auto &outputs = expected.getRegion(name)->getOutputs();
+    for (const auto &output : outputs) {
+      EXPECT_TRUE(expected.getRegion(name)->getOutputData(output.first) ==
+                  actual.getRegion(name)->getOutputData(output.first))
+          << name << "." << output.first;
+    }
+  }
+}
+
+static void countIterations(Network *net, UInt64 iteration, void *data) {
+  auto iterations = static_cast<std::vector<UInt64> *>(data);
+  iterations->push_back(iteration);
+}
+
+TEST(NetworkTest, ParallelRunMatchesSequential) {
+  Network sequential, parallel;
+  addParallelTestRegions(sequential);
+  addParallelTestRegions(parallel);
+  ThreadPool pool(4);
+
+  for (int i = 0; i < 5; i++) {
+    sequential.run(5);
+    parallel.run(5, &pool);
+    expectSameOutputs(sequential, parallel);
+  }
+
+  // Callbacks run between the iterations, in order.
+  std::vector<UInt64> sequentialIterations, parallelIterations;
+  sequential.getCallbacks().add("count",
+      Network::callbackItem(countIterations, &sequentialIterations));
+  parallel.getCallbacks().add("count",
+      Network::callbackItem(countIterations, &parallelIterations));
+  sequential.run(10);
+  parallel.run(10, &pool);
+  ASSERT_EQ(sequentialIterations, parallelIterations);
+  ASSERT_EQ(26u, parallelIterations.front());
+  expectSameOutputs(sequential, parallel);
+}
+
 /**
  * Test operator '=='
  */
+TEST(NetworkTest, Profiling) {
+  Network net;
+  addParallelTestRegions(net);
+  net.enableProfiling(true);
+  net.run(10);
+
+  const RegionProfile &sp1 = net.getRegion("sp1")->getProfile();
+  ASSERT_EQ(10u, sp1.prepare.getCount());
+  ASSERT_EQ(10u, sp1.compute.getCount());
+  ASSERT_LE(sp1.compute.getPercentile(50.0), sp1.compute.getPercentile(99.0));
+  ASSERT_LE(sp1.compute.getPercentile(99.0), sp1.compute.getMax());
+  ASSERT_EQ(20u, sp1.trace.size());
+
+  // The sensor's 30 values are converted into the SDR input of sp1, and
+  // the delayed link to sp2 also copies them into its ring.
+  Input *in1 = net.getRegion("sp1")->getInput("bottomUpIn");
+  const LinkProfile &link1 = in1->getLinks()[0]->getProfile();
+  ASSERT_EQ(10u, link1.compute.getCount());
+  ASSERT_EQ(0u, link1.shift.getCount());
+  ASSERT_EQ(10u * 30u, link1.bytesCopied);
+  Input *in2 = net.getRegion("sp2")->getInput("bottomUpIn");
+  const LinkProfile &link2 = in2->getLinks()[0]->getProfile();
+  ASSERT_EQ(10u, link2.shift.getCount());
+  ASSERT_EQ(10u * 30u + 10u * 30u * sizeof(Real32), link2.bytesCopied);
+
+  // Once running, the delayed link does not allocate.
+  net.resetProfiling();
+  net.run(5);
+  ASSERT_EQ(5u, link2.compute.getCount());
+  ASSERT_EQ(0u, link2.allocations);
+
+  std::stringstream json;
+  net.saveProfile(json);
+  EXPECT_NE(std::string::npos, json.str().find("{\"name\": \"sp1\", \"type\": \"SPRegion\""));
+  EXPECT_NE(std::string::npos, json.str().find("\"sensor.dataOut-->sp2.bottomUpIn\", \"propagationDelay\": 2"));
+
+  std::stringstream trace;
+  net.saveProfileTrace(trace);
+  const std::string events = trace.str();
+  size_t count = 0;
+  for (size_t pos = events.find("\"ph\": \"X\""); pos != std::string::npos;
+       pos = events.find("\"ph\": \"X\"", pos + 1))
+    count++;
+  // prepare and compute of 4 regions, compute of 3 links and one shift.
+  ASSERT_EQ(5u * (4u * 2u + 3u + 1u), count);
+  EXPECT_NE(std::string::npos, events.find("\"name\": \"tm.compute\", \"cat\": \"region\""));
+
+  net.disableProfiling();
+  net.run(1);
+  ASSERT_EQ(5u, sp1.compute.getCount());
+}
+
 TEST(NetworkTest, testEqualsOperator) {
   Network n1;
   Network n2;
@@ -0,0 +1,75 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for the profiling records
+ */
+
+#include "gtest/gtest.h"
+
+#include <nupic/engine/Profile.hpp>
+
+namespace testing {
+
+using namespace nupic;
+
+TEST(ProfileTest, EmptyHistogram) {
+  LatencyHistogram h;
+  ASSERT_EQ(0u, h.getCount());
+  ASSERT_EQ(0u, h.getPercentile(50.0));
+  ASSERT_EQ(0u, h.getMax());
+}
+
+TEST(ProfileTest, HistogramPercentiles) {
+  LatencyHistogram h;
+  // 98 fast samples and 2 slow ones.
+  for (UInt64 i = 0; i < 98u; i++)
+    h.add(1000u + i);
+  h.add(1000000u);
+  h.add(5000000u);
+
+  ASSERT_EQ(100u, h.getCount());
+  ASSERT_EQ(5000000u, h.getMax());
+  const UInt64 p50 = h.getPercentile(50.0);
+  ASSERT_GE(p50, 1049u);
+  ASSERT_LE(p50, 1049u + 1049u / 8u);
+  const UInt64 p99 = h.getPercentile(99.0);
+  ASSERT_GE(p99, 1000000u);
+  ASSERT_LE(p99, 1000000u + 1000000u / 8u);
+  ASSERT_EQ(5000000u, h.getPercentile(100.0));
+
+  // Small latencies are exact.
+  LatencyHistogram small;
+  small.add(3u);
+  ASSERT_EQ(3u, small.getPercentile(50.0));
+
+  h.reset();
+  ASSERT_EQ(0u, h.getCount());
+  ASSERT_EQ(0u, h.getTotal());
+}
+
+TEST(ProfileTest, QuoteJSON) {
+  ASSERT_EQ("\"a.b-->c\"", profile::quoteJSON("a.b-->c"));
+  ASSERT_EQ("\"q\\\"\\\\\\n\\u0001\"", profile::quoteJSON("q\"\\\n\x01"));
+}
+
+} // namespace testing
@@ -26,6 +26,7 @@
 
 #include "gtest/gtest.h"
 #include <nupic/math/Topology.hpp>
+#include <nupic/utils/Random.hpp>
 
 namespace testing {
 
@@ -376,4 +377,51 @@ TEST(TopologyTest, WrappingNeighborhoodDimensionOne) {
       /*radius*/ 1,
       /*expected*/ {{4, 0, 0}, {5, 0, 0}, {6, 0, 0}});
 }
+
+TEST(TopologyTest, NeighborhoodMaxAndMean) {
+  Random rng(7);
+  const vector<vector<UInt>> topologies = {{1}, {2}, {9}, {10, 1}, {6, 9},
+                                           {4, 5, 3}};
+  for (const auto &dimensions : topologies) {
+    UInt numPoints = 1u;
+    for (const UInt dim : dimensions) {
+      numPoints *= dim;
+    }
+    vector<Real> data(numPoints);
+    for (auto &value : data) {
+      value = (Real)rng.getReal64();
+    }
+
+    for (const bool wrapAround : {false, true}) {
+      for (UInt radius = 0u; radius < 12u; radius++) {
+        const vector<Real> max =
+            neighborhoodMax(data, radius, dimensions, wrapAround);
+        const vector<Real> mean =
+            neighborhoodMean(data, radius, dimensions, wrapAround);
+        ASSERT_EQ(numPoints, max.size());
+        ASSERT_EQ(numPoints, mean.size());
+
+        for (UInt point = 0u; point < numPoints; point++) {
+          Real expectedMax = 0.0f;
+          Real64 sum = 0.0;
+          UInt count = 0u;
+          const auto visit = [&](UInt neighbor) {
+            expectedMax = std::max(expectedMax, data[neighbor]);
+            sum += data[neighbor];
+            count++;
+          };
+          if (wrapAround) {
+            for (UInt neighbor : WrappingNeighborhood(point, radius, dimensions))
+              visit(neighbor);
+          } else {
+            for (UInt neighbor : Neighborhood(point, radius, dimensions))
+              visit(neighbor);
+          }
+          ASSERT_EQ(expectedMax, max[point]);
+          ASSERT_NEAR(sum / count, mean[point], 1e-6);
+        }
+      }
+    }
+  }
+}
 } // namespace
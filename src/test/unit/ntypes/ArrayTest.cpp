@@ -464,6 +464,29 @@ TEST_F(ArrayTest, testBufferRelease) {
   }
 }
 
+TEST_F(ArrayTest, testSparseConversion) {
+  sdr::SDR sdr({10u});
+  sdr.setSparse(sdr::SDR_sparse_t({1u, 4u, 9u}));
+  const Array a(sdr);
+
+  // Into a wider numeric buffer at an offset, as done by a Fan-In.
+  Array b(NTA_BasicType_Real32);
+  b.allocateBuffer(13);
+  std::vector<Real32> expected(13, 5.0f);
+  for (size_t i = 0; i < 13; i++)
+    ((Real32 *)b.getBuffer())[i] = 5.0f;
+  for (size_t i = 2; i < 12; i++)
+    expected[i] = (i == 3 || i == 6 || i == 11) ? 1.0f : 0.0f;
+  a.convertInto(b, 2, 13);
+  ASSERT_EQ(expected, b.asVector<Real32>());
+
+  // And back again.
+  Array c(NTA_BasicType_SDR);
+  c.allocateBuffer(std::vector<UInt>({13u}));
+  b.convertInto(c);
+  ASSERT_EQ(sdr::SDR_sparse_t({0u, 1u, 3u, 6u, 11u, 12u}), c.getSDR().getSparse());
+}
+
 TEST_F(ArrayTest, testArrayTyping) {
   setupArrayTests();
 
@@ -581,6 +604,13 @@ TEST_F(ArrayTest, testArrayBasefunctions) {
       EXPECT_TRUE(m.getSDR() == sdr);
       EXPECT_EQ(m.getCount(), 100u);
 
+      // getSDR() refreshes a wrapped SDR after writes to the dense buffer.
+      sdr::SDR wrapped({100u});
+      Array w(NTA_BasicType_SDR);
+      w.setBuffer(wrapped);
+      ((Byte *)w.getBuffer())[5] = 1u;
+      EXPECT_EQ(w.getSDR().getSparse(), sdr::SDR_sparse_t({5u}));
+
       std::vector<Byte> row = a.asVector<Byte>();
       const sdr::SDR_sparse_t& v = a.getSDR().getSparse();
 
@@ -587,4 +587,37 @@ TEST(BasicTypeTest, convertArray) {
                           NTA_BasicType_Bool, 8);
   ASSERT_TRUE(ca.checkArrayBool<bool>(ca.dest)) << "bool to bool conversion";
 }
-}
\ No newline at end of file
+
+TEST(BasicTypeTest, convertSparseArray) {
+  const UInt indices[] = {0u, 3u, 6u};
+  Real32 real32[7];
+  BasicType::convertSparseArray(real32, NTA_BasicType_Real32, indices, 3, 7);
+  for (UInt i = 0; i < 7; i++)
+    ASSERT_EQ(i % 3u == 0u ? 1.0f : 0.0f, real32[i]) << "index " << i;
+
+  Int64 int64[5] = {9, 9, 9, 9, 9};
+  BasicType::convertSparseArray(int64, NTA_BasicType_Int64, indices, 0, 5);
+  for (UInt i = 0; i < 5; i++)
+    ASSERT_EQ(0, int64[i]);
+
+  Byte dense[7];
+  BasicType::convertSparseArray(dense, NTA_BasicType_SDR, indices, 3, 7);
+  ASSERT_EQ(std::vector<Byte>({1, 0, 0, 1, 0, 0, 1}),
+            std::vector<Byte>(dense, dense + 7));
+}
+
+TEST(BasicTypeTest, convertReal32ToSDR) {
+  // Long enough for the blocked scan and a remainder.
+  std::vector<Real32> values(37, 0.0f);
+  values[1]  = 0.5f;
+  values[15] = -2.0f;
+  values[16] = std::numeric_limits<Real32>::quiet_NaN();
+  values[20] = -0.0f;
+  values[36] = 1.0f;
+  std::vector<Byte> dense(values.size(), 7);
+  BasicType::convertArray(dense.data(), NTA_BasicType_SDR, values.data(),
+                          NTA_BasicType_Real32, values.size());
+  for (size_t i = 0; i < values.size(); i++)
+    ASSERT_EQ(values[i] != 0.0f ? 1 : 0, dense[i]) << "index " << i;
+}
+}
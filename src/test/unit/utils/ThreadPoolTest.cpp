@@ -0,0 +1,158 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2019, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of unit tests for ThreadPool
+ */
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <nupic/utils/ThreadPool.hpp>
+
+namespace testing {
+
+using namespace std;
+using nupic::ThreadPool;
+using nupic::UInt;
+
+TEST(ThreadPoolTest, NumThreads) {
+  ThreadPool serial( 1u );
+  ASSERT_EQ( 1u, serial.numThreads() );
+
+  ThreadPool pool( 4u );
+  ASSERT_EQ( 4u, pool.numThreads() );
+
+  ThreadPool hardware;
+  ASSERT_GE( hardware.numThreads(), 1u );
+}
+
+TEST(ThreadPoolTest, ParallelForCoversRange) {
+  ThreadPool pool( 3u );
+  for(UInt size : {0u, 1u, 2u, 3u, 10u, 1000u}) {
+    vector<UInt> visits( size + 5u, 0u );
+    vector<UInt> owner( size + 5u, 99u );
+    for(int repeat = 0; repeat < 10; repeat++) {
+      pool.parallelFor(5u, size + 5u, [&](UInt begin, UInt end, UInt thread) {
+        ASSERT_LT( thread, 3u );
+        for(UInt i = begin; i < end; i++) {
+          visits[i]++;
+          owner[i] = thread;
+        }
+      });
+    }
+    for(UInt i = 0; i < 5u; i++)
+      ASSERT_EQ( 0u, visits[i] );
+    for(UInt i = 5u; i < size + 5u; i++) {
+      ASSERT_EQ( 10u, visits[i] );
+      // Chunks are contiguous and in thread order.
+      const UInt thread = owner[i];
+      ASSERT_GE( i - 5u, size * thread / 3u );
+      ASSERT_LT( i - 5u, size * (thread + 1u) / 3u );
+    }
+  }
+}
+
+TEST(ThreadPoolTest, ParallelForRethrows) {
+  ThreadPool pool( 4u );
+  ASSERT_THROW(
+    pool.parallelFor(0u, 100u, [](UInt begin, UInt end, UInt thread) {
+      if( thread == 2u )
+        throw runtime_error("task failed");
+    }),
+    runtime_error );
+
+  // The pool is still usable afterwards.
+  vector<UInt> data( 100u, 0u );
+  pool.parallelFor(0u, 100u, [&](UInt begin, UInt end, UInt) {
+    for(UInt i = begin; i < end; i++)
+      data[i] = i;
+  });
+  for(UInt i = 0; i < 100u; i++)
+    ASSERT_EQ( i, data[i] );
+}
+
+TEST(ThreadPoolTest, NestedParallelForRunsInline) {
+  ThreadPool pool( 4u );
+  vector<UInt> visits( 40u, 0u );
+  pool.parallelFor(0u, 4u, [&](UInt outerBegin, UInt outerEnd, UInt outer) {
+    for(UInt i = outerBegin; i < outerEnd; i++) {
+      pool.parallelFor(i * 10u, i * 10u + 10u, [&](UInt begin, UInt end, UInt inner) {
+        // The whole inner range runs on the same thread.
+        ASSERT_EQ( outer, inner );
+        ASSERT_EQ( i * 10u, begin );
+        ASSERT_EQ( i * 10u + 10u, end );
+        for(UInt j = begin; j < end; j++)
+          visits[j]++;
+      });
+    }
+  });
+  for(UInt i = 0; i < 40u; i++)
+    ASSERT_EQ( 1u, visits[i] );
+}
+
+TEST(ThreadPoolTest, NestedOtherPoolKeepsOuterPool) {
+  ThreadPool outer( 2u ), inner( 2u );
+  vector<UInt> visits( 20u, 0u );
+  outer.parallelFor(0u, 2u, [&](UInt outerBegin, UInt outerEnd, UInt thread) {
+    for(UInt i = outerBegin; i < outerEnd; i++) {
+      // Running another pool's loop here must not forget that this thread
+      // is inside the outer pool, so the nested call below runs inline.
+      inner.parallelFor(0u, 4u, [](UInt, UInt, UInt) {});
+      outer.parallelFor(i * 10u, i * 10u + 10u, [&](UInt begin, UInt end, UInt nested) {
+        ASSERT_EQ( thread, nested );
+        for(UInt j = begin; j < end; j++)
+          visits[j]++;
+      });
+    }
+  });
+  for(UInt i = 0; i < 20u; i++)
+    ASSERT_EQ( 1u, visits[i] );
+}
+
+TEST(ThreadPoolTest, ConcurrentCallersAreSerialized) {
+  ThreadPool pool( 4u );
+  const UInt numCallers = 4u;
+  const UInt size       = 1000u;
+  vector<vector<UInt>> data( numCallers, vector<UInt>( size, 0u ));
+  vector<std::thread> callers;
+  for(UInt c = 0; c < numCallers; c++) {
+    callers.emplace_back([&, c]() {
+      for(UInt rep = 0; rep < 50u; rep++) {
+        pool.parallelFor(0u, size, [&](UInt begin, UInt end, UInt) {
+          for(UInt i = begin; i < end; i++)
+            data[c][i]++;
+        });
+      }
+    });
+  }
+  for( auto &caller : callers )
+    caller.join();
+  for(UInt c = 0; c < numCallers; c++)
+    for(UInt i = 0; i < size; i++)
+      ASSERT_EQ( 50u, data[c][i] );
+}
+
+} // end namespace testing